@@ -0,0 +1,161 @@
+#ifndef INCLUDE_FW_COLL_ENV_ACTORPOOL_H_
+#define INCLUDE_FW_COLL_ENV_ACTORPOOL_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/EncounterGenerator.h>
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/MpmcRing.h>
+#include <fw-coll-env/Uhat.h>
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace fw_coll_env {
+
+// one step of one environment
+struct Transition {
+  // FwState.asarray layout before and after the step
+  double x[8];
+  double x_next[8];
+  // FwActionIndex indices of the joint action from the policy and Uhat
+  // and of the executed one (different only when the shield overrides)
+  int32_t action_idx;
+  int32_t executed_idx;
+  uint8_t overridden;
+  uint8_t done;
+  uint8_t collided;
+  // env id (actor * envs_per_actor + env of actor)
+  uint32_t env;
+  // importance weight of the episode's initial state
+  double weight;
+  double t;
+};
+
+// Native actor threads for data collection. Each actor owns
+// envs_per_actor copies of env where vehicle 2 follows Uhat to goal2 and
+// steps them round robin without the GIL, optionally through a shield.
+// Transitions are pushed into a bounded lock-free ring that drain empties
+// into numpy arrays; actors wait while the ring is full. Environments
+// that are done or collided are reset from the actor's copy of generator.
+//
+// The vehicle 1 policy is one of
+//   random: uniform over the avail actions (the default)
+//   callback: a native function int policy(const double *x, void *user_data)
+//     returning the avail action index for a state in the FwState.asarray
+//     layout, e.g. a numba cfunc address. It is called concurrently from
+//     all actors.
+//   table: an (nx, ny, nth) table of avail action indices over the
+//     position of vehicle 2 in vehicle 1's frame and the relative heading,
+//     binned uniformly in lims (2, 3) and clamped. set_policy_table may be
+//     called while running; actors pick up a new table on their next round.
+class ActorPool {
+ public:
+  ActorPool(
+      const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+      const EncounterGenerator &generator, size_t num_actors, size_t envs_per_actor,
+      size_t queue_capacity, uint64_t seed);
+  ~ActorPool();
+
+  ActorPool(const ActorPool &) = delete;
+  ActorPool &operator=(const ActorPool &) = delete;
+
+  void start();
+  // waits for the actors to finish their current step. Transitions
+  // already in the ring stay there.
+  void stop();
+  bool is_running() const {return !threads_.empty();}
+
+  // the policy and shield can only be changed while stopped, except
+  // set_policy_table which may also replace a running table
+  void set_policy_random();
+  void set_policy_callback(uintptr_t fn, uintptr_t user_data);
+  void set_policy_table(pybind11::array_t<int> table, pybind11::array_t<double> lims);
+  void set_shield(const BarrierGammaTurn &barrier);
+  void clear_shield();
+  bool has_shield() const {return shield_ != nullptr;}
+
+  // pops up to max_items transitions. Returns a dict of arrays x and
+  // x_next (n, 8), action_idx, executed_idx, overridden, done, collided,
+  // env, weight and t (n,). Rethrows the first error of an actor.
+  pybind11::dict drain(size_t max_items);
+
+  size_t get_num_actors() const {return num_actors_;}
+  size_t get_envs_per_actor() const {return envs_per_actor_;}
+  size_t get_queue_capacity() const {return ring_.capacity();}
+  size_t get_queue_size() const {return ring_.size_approx();}
+  uint64_t get_num_steps() const {return num_steps_.load();}
+  uint64_t get_num_episodes() const {return num_episodes_.load();}
+  // pushes that found the ring full
+  uint64_t get_num_full_waits() const {return num_full_waits_.load();}
+  uint64_t get_table_version() const {return table_version_.load();}
+  std::string to_string() const;
+
+ protected:
+  enum class PolicyKind {random, callback, table};
+  using PolicyFn = int (*)(const double *, void *);
+
+  struct PolicyTable {
+    std::vector<int> actions;
+    size_t dims[3];
+    double low[3];
+    double high[3];
+
+    int lookup(const double *x) const;
+  };
+
+  struct Actor {
+    std::vector<FwCollisionEnv> envs;
+    std::vector<double> weights;
+    EncounterGenerator generator;
+    std::mt19937_64 rng;
+  };
+
+  void check_stopped(const char *what) const;
+  void actor_loop(size_t actor);
+  void reset_env(Actor &actor, size_t i);
+  int policy_action(Actor &actor, const PolicyTable *table, const double *x);
+  void fail(std::exception_ptr error);
+
+  size_t num_actors_;
+  size_t envs_per_actor_;
+  FwAvailActions avail_actions_;
+  Uhat uhat2_;
+  std::vector<Actor> actors_;
+  // shared by all actors
+  std::shared_ptr<const BarrierGammaTurn> shield_;
+
+  // set_policy_table stores it while actors read it
+  std::atomic<PolicyKind> policy_kind_ {PolicyKind::random};
+  PolicyFn policy_fn_ = nullptr;
+  void *policy_user_data_ = nullptr;
+  // replaced atomically while running
+  std::shared_ptr<const PolicyTable> table_;
+  std::atomic<uint64_t> table_version_ {0};
+
+  MpmcRing<Transition> ring_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> stop_ {false};
+
+  std::atomic<uint64_t> num_steps_ {0};
+  std::atomic<uint64_t> num_episodes_ {0};
+  std::atomic<uint64_t> num_full_waits_ {0};
+  // yields on a full ring before an actor starts sleeping
+  const size_t max_full_spins_ = 64;
+
+  std::mutex error_mtx_;
+  std::exception_ptr error_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_ACTORPOOL_H_
@@ -0,0 +1,87 @@
+#ifndef INCLUDE_FW_COLL_ENV_BARRIERCOMPOSITE_H_
+#define INCLUDE_FW_COLL_ENV_BARRIERCOMPOSITE_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/BarrierGammaTurn.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Barrier over several evasive maneuvers: both vehicles turning at each
+// of w_deg_per_sec (one revolution) and, with straight, flying straight
+// (as BarrierGammaStraight). A state is safe when any maneuver is, so h
+// is the max over the maneuvers' h and choose_u uses that combined h.
+//
+// All maneuvers are propagated in one pass. They share the heading trig
+// of the start state and turn by rotating (cos, sin) with the constant
+// per-step rotation of their turn rate, so a rollout step costs a few
+// multiply-adds instead of a cos/sin per vehicle. Per-maneuver values
+// match the standalone barriers up to rounding.
+class BarrierComposite : public BarrierGammaTurn {
+ public:
+  BarrierComposite(
+      double dt, double max_val, double v, const std::vector<double> &w_deg_per_sec,
+      bool straight, double safety_dist, const FwAvailActions &avail_actions);
+
+  std::shared_ptr<BarrierGammaTurn> clone() const override;
+  std::string to_string() const override;
+
+  // h of every maneuver, in w_deg_per_sec order with straight last
+  std::vector<double> calc_h_maneuvers(const FwState &x0) const;
+
+  // for (N, 8) states returns the (N, num_maneuvers) per-maneuver h and
+  // the (N,) combined h
+  std::pair<pybind11::array_t<double>, pybind11::array_t<double>> calc_h_batch(
+      pybind11::array_t<double> x) const;
+
+  const std::vector<double> &get_w_deg_per_sec() const {return w_deg_per_sec_;}
+  bool get_straight() const {return straight_;}
+  size_t num_maneuvers() const {return maneuvers_.size();}
+
+ protected:
+  struct Maneuver {
+    double w_rad_per_sec;
+    // rotation of the heading over one step
+    double cos_step;
+    double sin_step;
+    size_t num_steps;
+    bool straight;
+  };
+
+  void check_params(const BarrierParams &p) const override;
+  BarrierParams hetero_params(
+      double max_val, double v, double w_rad_per_sec, double safety_dist,
+      double lmbda) const override;
+  double closest_future_dist(
+      const FwState &x, const BarrierParams &p, PruneCounts &counts) const override;
+  // the maneuvers one after another with maneuver_dist, the shared
+  // heading trig gains little in float
+  float closest_future_dist(
+      const FwStateT<float> &x, const BarrierParams &p, PruneCounts &counts) const override;
+  double rollout_horizon() const override;
+  // the closest state of the maneuver with the largest closest distance
+  double closest_future_state(
+      const FwState &x0, const BarrierParams &p, FwState &x_closest,
+      PruneCounts &counts) const override;
+  // closest distance of every maneuver and optionally the states where
+  // they are reached
+  std::vector<double> maneuver_dists(
+      const FwState &x0, const BarrierParams &p, PruneCounts &counts,
+      std::vector<FwState> *x_closest = nullptr) const;
+  std::vector<double> calc_h_maneuvers(
+      const FwState &x0, const BarrierParams &p, PruneCounts &counts) const;
+
+  std::vector<double> w_deg_per_sec_;
+  bool straight_;
+  std::vector<Maneuver> maneuvers_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_BARRIERCOMPOSITE_H_
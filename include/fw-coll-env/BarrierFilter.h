@@ -0,0 +1,71 @@
+#ifndef INCLUDE_FW_COLL_ENV_BARRIERFILTER_H_
+#define INCLUDE_FW_COLL_ENV_BARRIERFILTER_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Stateful per-environment wrapper around a BarrierGammaTurn.
+// calc_h simulates one revolution of the evasive orbit. When both vehicles
+// then apply the evasive action, the next state is the first step of that
+// orbit and the next rollout covers the same revolution shifted by one
+// step. The filter keeps each environment's distance profile in a
+// monotone deque, so that case costs a single extra orbit step instead of
+// a full rollout. Any other state falls back to a full rollout. h values
+// are identical to BarrierGammaTurn::calc_h.
+class BarrierFilter {
+ public:
+  BarrierFilter(const BarrierGammaTurn &barrier, size_t num_envs);
+
+  double calc_h(size_t env, const FwState &x0);
+
+  // row i of x and uhat_idx belongs to environment i
+  pybind11::array_t<int> choose_u(
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx);
+
+  void reset(size_t env);
+  void reset_all();
+
+  size_t size() const {return windows_.size();}
+  size_t get_cache_hits() const {return cache_hits_;}
+  size_t get_cache_misses() const {return cache_misses_;}
+  const BarrierGammaTurn &get_barrier() const {return barrier_;}
+  std::string to_string() const;
+
+ protected:
+  struct OrbitWindow {
+    bool valid = false;
+    // orbit step of the current window start, its successor (the
+    // state expected next) and the last step simulated
+    size_t first = 0;
+    FwState next;
+    FwState last;
+    // (orbit step, distance) with increasing distances
+    std::deque<std::pair<size_t, double>> min_dists;
+  };
+
+  OrbitWindow &window(size_t env);
+  double window_h(const OrbitWindow &w) const;
+  void advance(OrbitWindow &w);
+  void rollout(OrbitWindow &w, const FwState &x0);
+  FwAction evasive_action() const;
+
+  BarrierGammaTurn barrier_;
+  FwSingleAction evasive_;
+  size_t n_;
+  std::vector<OrbitWindow> windows_;
+
+  size_t cache_hits_ = 0;
+  size_t cache_misses_ = 0;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_BARRIERFILTER_H_
@@ -4,22 +4,32 @@
 #include <fw-coll-env/FwAvailActions.h>
 #include <fw-coll-env/BarrierGammaTurn.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <tuple>
 
 namespace fw_coll_env {
 
+// seconds the straight evasive rollout integrates at most, which matches
+// the max_sim_time the env is usually run with
+constexpr double straight_rollout_time = 30;
+
 class BarrierGammaStraight : public BarrierGammaTurn {
  public:
   BarrierGammaStraight(
       double dt, double max_val, double v, double safety_dist,
       const FwAvailActions &avail_actions);
 
+  std::shared_ptr<BarrierGammaTurn> clone() const override;
   std::string to_string() const override;
 
  protected:
-  double closest_future_dist(const FwState &x) override;
+  void check_params(const BarrierParams &p) const override;
+  BarrierParams hetero_params(
+      double max_val, double v, double w_rad_per_sec, double safety_dist,
+      double lmbda) const override;
+  EvasiveManeuver evasive_maneuver(const BarrierParams &p) const override;
 };
 
 } // namespace fw_coll_env
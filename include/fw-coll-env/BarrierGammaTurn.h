@@ -8,21 +8,169 @@
 #include <fw-coll-env/FwAvailActions.h>
 #include <fw-coll-env/FwActionIndex.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <memory>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 namespace fw_coll_env {
 
+class BarrierFilter;
+class Uhat;
+
+// rollout steps and choose_u candidates a call pruned because the
+// distance bound showed they could not change the result. Every call
+// counts into its own struct, so one barrier can be shared by threads.
+struct PruneCounts {
+  size_t skipped_steps = 0;
+  size_t skipped_candidates = 0;
+};
+
+// barrier parameters the rollout and the choose_u search read, so rows
+// can be evaluated with parameters other than the barrier's own
+struct BarrierParams {
+  double max_val;
+  double v;
+  double w_rad_per_sec;
+  double safety_dist;
+  double lambda;
+
+  bool operator==(const BarrierParams &p) const;
+  // h of a closest future distance and the barrier function value, in
+  // the scalar type T of the rollout
+  template <typename T>
+  T h(T dist) const {return std::min<T>(max_val, dist - static_cast<T>(safety_dist));}
+  template <typename T>
+  T bf_value(T h, T hnext) const {return (hnext - h) + static_cast<T>(lambda) * h;}
+};
+
+// by-products of choose_u_single for one state
+struct ChooseUInfo {
+  double h;
+  double uhat_bf_val;
+  double chosen_bf_val;
+  // actions whose bf_constraint was evaluated with a rollout, uhat included
+  int num_candidates;
+};
+
+// evasive maneuver both vehicles fly in the rollout of calc_h
+struct EvasiveManeuver {
+  double w_rad_per_sec;
+  size_t num_steps;
+  // stops at the closest point instead of flying all num_steps
+  bool straight;
+};
+
 class BarrierGammaTurn {
+  friend class BarrierFilter;
+  friend class MultiBarrierFilter;
+
  public:
   BarrierGammaTurn(
       double dt, double max_val, double v, double w_deg_per_sec, double safety_dist,
       const FwAvailActions &avail_actions);
+  virtual ~BarrierGammaTurn() = default;
+
+  // copy that keeps the dynamic type, so a shield can own either barrier
+  virtual std::shared_ptr<BarrierGammaTurn> clone() const;
+
+  double calc_h(const FwState &x0) const;
+  double calc_dh(const FwState &x0, const FwAction &ac) const;
 
-  double calc_h(const FwState &x0);
-  double calc_dh(const FwState &x0, const FwAction &ac);
+  // h and dh/dx0 in the FwState.asarray layout. h is the distance at the
+  // closest step of the evasive rollout, so the gradient goes through that
+  // step only (it is 0 where h saturates at max_val). Rolling out
+  // fw_dynamics, the position at step k moves one for one with the start
+  // position, and its derivative in the start heading is the turn of the
+  // displacement so far: d(x_k, y_k)/d th_0 = (-(y_k - y_0), x_k - x_0).
+  std::pair<double, std::array<double, 8>> calc_h_grad(const FwState &x0) const;
+
+  // batched calc_h_grad, returns the (N,) h and (N, 8) gradients
+  std::pair<pybind11::array_t<double>, pybind11::array_t<double>> calc_h_grad_batch(
+      pybind11::array_t<double> x) const;
+
+  // central finite differences of calc_h with step eps, for checking
+  // calc_h_grad_batch
+  pybind11::array_t<double> calc_h_grad_fd(pybind11::array_t<double> x, double eps) const;
   pybind11::array_t<int> choose_u(
-      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx);
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) const;
+
+  // which vehicle 1 actions keep bf_constraint >= 0 while vehicle 2 flies
+  // the FwAvailActions index a2_idx (or the action uhat2 gives for its
+  // state). Returns an (N, |A|) bool mask in FwAvailActions order or, with
+  // packed, the (N, ceil(|A| / 8)) uint8 mask of np.packbits(mask, axis=1).
+  // h(x0), the step of vehicle 2 and the heading trig of vehicle 1 are
+  // shared by the |A| candidates of a row, and candidates whose distance
+  // bound is already unsafe skip the rollout, so a mask costs about as
+  // much as choose_u does for an unsafe uhat.
+  pybind11::array safe_action_mask(
+      pybind11::array_t<double> x, pybind11::array_t<int> a2_idx, bool packed) const;
+  pybind11::array safe_action_mask(
+      pybind11::array_t<double> x, const Uhat &uhat2, bool packed) const;
+
+  // deadline aware choose_u. Candidates are evaluated in order of their
+  // distance to uhat, so the search can stop at the first safe one. It
+  // also stops once budget_s seconds (for the whole call, or for every row
+  // with per_row) have passed and then returns the least unsafe action
+  // found so far, uhat if none was better. Rows reached after the budget
+  // of the call ran out return uhat without evaluating it. The budget is
+  // checked before every candidate, so a row can overrun it by the
+  // rollouts of h(x0), of uhat and of one candidate. Returns the actions
+  // and whether the search of each row was complete, in which case its
+  // action is the one choose_u picks.
+  std::pair<pybind11::array_t<int>, pybind11::array_t<bool>> choose_u_anytime(
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+      double budget_s, bool per_row) const;
+
+  // calc_h and choose_u for float32 states. The rollouts and the search
+  // are the double ones instantiated for float, which halves their memory
+  // traffic; positions within a few kilometers keep h within a few
+  // centimeters of the double path.
+  pybind11::array_t<float> calc_h_f32(pybind11::array_t<float> x) const;
+  pybind11::array_t<int> choose_u_f32(
+      pybind11::array_t<float> x, pybind11::array_t<int> uhat_idx) const;
+  // choose_u_f32 for a single state, returns the FwActionIndex idx
+  int filter_action_f32(const FwStateT<float> &x0, int uhat_idx) const;
+
+  // choose_u that also returns per row h(x0), bf_constraint for uhat and
+  // for the chosen action, whether uhat was overridden and the number of
+  // candidates evaluated, so they need not be recomputed
+  std::tuple<pybind11::array_t<int>, pybind11::array_t<double>,
+             pybind11::array_t<double>, pybind11::array_t<double>,
+             pybind11::array_t<bool>, pybind11::array_t<int>>
+  choose_u_diagnostics(pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) const;
+
+  // choose_u for a single state, optionally with its diagnostics
+  FwAction filter_action(
+      const FwState &x0, const FwAction &uhat, ChooseUInfo *info = nullptr) const;
+
+  // choose_u where every row carries its own barrier parameters. Each
+  // row is filtered with a BarrierParams of its own (checked like the
+  // constructor does, once per run of equal rows), so the barrier itself
+  // is not modified.
+  pybind11::array_t<int> choose_u_hetero(
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+      pybind11::array_t<double> safety_dist, pybind11::array_t<double> max_val,
+      pybind11::array_t<double> v, pybind11::array_t<double> w_deg_per_sec,
+      pybind11::array_t<double> lmbda) const;
+
+  // continuous action filter. uhat is (N, 6) with rows
+  // [v1, w1, dz1, v2, w2, dz2] (w in rad/s) and rows where it is safe are
+  // returned unchanged. Instead of searching the
+  // FwAvailActions grid, bf_constraint is linearized around the current
+  // action with finite differences and the closest action in the
+  // FwAvailActions bounding box that satisfies the linearization is
+  // taken, then checked with a full calc_h. With grid_fallback, rows
+  // where that fails are searched on the grid like choose_u. Returns the
+  // (N, 6) actions and whether each satisfies bf_constraint >= 0.
+  std::pair<pybind11::array_t<double>, pybind11::array_t<bool>> choose_u_continuous(
+      pybind11::array_t<double> x, pybind11::array_t<double> uhat,
+      bool grid_fallback) const;
 
   virtual std::string to_string() const;
 
@@ -31,13 +179,110 @@ class BarrierGammaTurn {
   double get_v() const {return v_;}
   double get_w_rad_per_sec() const {return w_rad_per_sec_;}
   double get_safety_dist() const {return safety_dist_;}
+  double get_lambda() const {return lambda_;}
+  BarrierParams get_params() const {
+    return {max_val_, v_, w_rad_per_sec_, safety_dist_, lambda_};
+  }
   const FwAvailActions get_avail_actions() const {return avail_actions_;}
+  const FwActionIndex &get_action_index() const {return action_index_;}
+
+  // PruneCounts summed over all calls since the last reset
+  size_t get_skipped_steps() const {return skipped_.steps.load(std::memory_order_relaxed);}
+  size_t get_skipped_candidates() const {
+    return skipped_.candidates.load(std::memory_order_relaxed);
+  }
+  void reset_skipped_counts();
 
  protected:
-  size_t steps_per_revolution() const;
-  virtual double closest_future_dist(const FwState &x);
-  double bf_constraint(double h, const FwState &x0, const FwAction &_ac);
-  FwAction choose_u_single(const FwState &x0, const FwAction &uhat);
+  // throws if the evasive maneuvers of p are not avail actions
+  virtual void check_params(const BarrierParams &p) const;
+  // the parameters this barrier evaluates a choose_u_hetero row with
+  virtual BarrierParams hetero_params(
+      double max_val, double v, double w_rad_per_sec, double safety_dist,
+      double lmbda) const;
+  size_t steps_per_revolution() const {return steps_per_revolution(w_rad_per_sec_);}
+  size_t steps_per_revolution(double w_rad_per_sec) const;
+  // the maneuver the rollout of closest_future_dist flies
+  virtual EvasiveManeuver evasive_maneuver(const BarrierParams &p) const;
+  // time covered by the evasive rollout of calc_h
+  virtual double rollout_horizon() const {
+    return evasive_maneuver(get_params()).num_steps * dt_;
+  }
+  // the rollouts and the search below evaluate the barrier with
+  // parameters p, usually get_params(). The templates are instantiated
+  // for float and double in BarrierGammaTurn.cpp.
+  template <typename T>
+  size_t steps_out_of_reach(
+      const BarrierParams &p, T dist, T closest_dist, size_t max_steps) const;
+  // closest distance while both vehicles fly maneuver man, and optionally
+  // the rollout state where it is reached
+  template <typename T>
+  T maneuver_dist(
+      const FwStateT<T> &x0, const BarrierParams &p, const EvasiveManeuver &man,
+      PruneCounts &counts, FwStateT<T> *x_closest = nullptr) const;
+  virtual double closest_future_dist(
+      const FwState &x, const BarrierParams &p, PruneCounts &counts) const;
+  virtual float closest_future_dist(
+      const FwStateT<float> &x, const BarrierParams &p, PruneCounts &counts) const;
+  // closest_future_dist that also returns the rollout state at which the
+  // distance is smallest
+  virtual double closest_future_state(
+      const FwState &x0, const BarrierParams &p, FwState &x_closest,
+      PruneCounts &counts) const;
+  template <typename T>
+  T calc_h(const FwStateT<T> &x0, const BarrierParams &p, PruneCounts &counts) const;
+  std::pair<double, std::array<double, 8>> calc_h_grad(
+      const FwState &x0, const BarrierParams &p, PruneCounts &counts) const;
+  template <typename T>
+  T bf_constraint(
+      const BarrierParams &p, T h, const FwStateT<T> &x0, const FwActionT<T> &_ac,
+      PruneCounts &counts) const;
+  // the choose_u search given h = calc_h(x0) and orig_bf_val =
+  // bf_constraint(h, x0, uhat). Returns the FwActionIndex idx of the
+  // chosen action, or -1 when uhat is kept.
+  //
+  // MultiBarrierFilter searches from its current joint action instead of
+  // uhat (orig_bf_val is then the value of that action, which -1 keeps),
+  // can fix a vehicle to the FwAvailActions index fixed1 or fixed2, and
+  // passes bf_cache, the bf_constraint per FwActionIndex idx with NaN for
+  // those not computed yet, which the search reads and fills in.
+  template <typename T>
+  int choose_u_search(
+      const FwStateT<T> &x0, const FwActionT<T> &uhat, T h, T orig_bf_val,
+      const BarrierParams &p, PruneCounts &counts, ChooseUInfo *info = nullptr,
+      int fixed1 = -1, int fixed2 = -1, T *bf_cache = nullptr) const;
+  FwAction choose_u_single(
+      const FwState &x0, const FwAction &uhat, const BarrierParams &p,
+      PruneCounts &counts, ChooseUInfo *info = nullptr) const;
+  // h = calc_h(x0) and orig_bf_val = bf_constraint(h, x0, uhat) given
+  FwAction choose_u_single(
+      const FwState &x0, const FwAction &uhat, double h, double orig_bf_val,
+      const BarrierParams &p, PruneCounts &counts, ChooseUInfo *info = nullptr) const;
+  int choose_u_f32_single(
+      const FwStateT<float> &x0, int uhat_idx, const BarrierParams &p,
+      PruneCounts &counts) const;
+  // safe[a1] = bf_constraint(h(x0), x0, (a1, a2)) >= 0 for every a1
+  void safe_actions_single(
+      const FwState &x0, const FwSingleAction &a2, bool *safe, const BarrierParams &p,
+      PruneCounts &counts) const;
+  // choose_u over the rows of x, also filling the ChooseUInfo of every
+  // row when info is given. name is the caller, for the shape error.
+  pybind11::array_t<int> choose_u_rows(
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+      std::vector<ChooseUInfo> *info, const char *name) const;
+  // safe_action_mask given the vehicle 2 action of every row
+  pybind11::array safe_action_mask(
+      pybind11::array_t<double> x, const std::vector<FwSingleAction> &a2,
+      bool packed) const;
+  int choose_u_anytime_single(
+      const FwState &x0, int uhat_idx,
+      std::chrono::steady_clock::time_point deadline, bool &complete,
+      const BarrierParams &p, PruneCounts &counts) const;
+  FwAction choose_u_continuous_single(
+      const FwState &x0, const FwAction &uhat, bool grid_fallback, bool &verified,
+      const BarrierParams &p, PruneCounts &counts) const;
+  // adds the counts of a finished call to the totals
+  void add_counts(const PruneCounts &counts) const;
 
   double dt_;
   double max_val_;
@@ -48,6 +293,28 @@ class BarrierGammaTurn {
   FwActionIndex action_index_;
 
   const double lambda_ = 0.99;
+
+  // linearization passes and finite difference step (as a fraction of
+  // each action range) used by choose_u_continuous
+  const int continuous_max_iters_ = 5;
+  const double continuous_fd_step_ = 1e-3;
+
+  // PruneCounts totals, which concurrent calls add to. Copies start
+  // from the totals of the source.
+  struct SkippedTotals {
+    SkippedTotals() = default;
+    SkippedTotals(const SkippedTotals &t) :
+        steps(t.steps.load(std::memory_order_relaxed)),
+        candidates(t.candidates.load(std::memory_order_relaxed)) {}
+    SkippedTotals &operator=(const SkippedTotals &t) {
+      steps.store(t.steps.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      candidates.store(t.candidates.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return *this;
+    }
+    std::atomic<size_t> steps {0};
+    std::atomic<size_t> candidates {0};
+  };
+  mutable SkippedTotals skipped_;
 };
 
 } // namespace fw_coll_env
@@ -0,0 +1,91 @@
+#ifndef INCLUDE_FW_COLL_ENV_ENCOUNTERGENERATOR_H_
+#define INCLUDE_FW_COLL_ENV_ENCOUNTERGENERATOR_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace fw_coll_env {
+
+// Importance sampler for initial states. The nominal distribution is the
+// one of FwCollisionGymEnv.reset: both poses uniform in (2, 4) [low; high]
+// boxes in the FwSingleState layout [x, y, th, z].
+//
+// With probability conflict_frac vehicle 2 is instead placed on a
+// conflict: its heading relative to vehicle 1 comes from a head-on,
+// crossing (either side) or overtaking window (head-on most likely), and its position follows
+// from a time to closest approach tau ~ U(0, horizon) and a miss distance
+// m ~ U(-max_miss, max_miss) under straight flight at speeds v1 and v2
+// (the map (tau, m) -> relative position has Jacobian |v_rel|).
+// Vehicle 1 and the altitude of vehicle 2 are drawn as in the nominal.
+//
+// Each sample carries the likelihood ratio p / (alpha p + (1 - alpha) q)
+// with alpha = 1 - conflict_frac, so weighted averages are unbiased
+// estimates under the nominal distribution. Samples outside the nominal
+// boxes get weight 0.
+class EncounterGenerator {
+ public:
+  EncounterGenerator(
+      pybind11::array_t<double> veh1_lims, pybind11::array_t<double> veh2_lims,
+      double v1, double v2, double horizon, double max_miss,
+      double conflict_frac, uint64_t seed);
+
+  // returns the (n, 8) states in the FwState.asarray layout and weights
+  std::pair<pybind11::array_t<double>, pybind11::array_t<double>> sample(size_t n);
+
+  // fills one state in the FwState.asarray layout and returns its weight
+  double sample_row(double *x);
+
+  // likelihood ratios for given (n, 8) states
+  pybind11::array_t<double> weights(pybind11::array_t<double> x) const;
+
+  void seed(uint64_t seed) {rng_.seed(seed);}
+
+  double get_conflict_frac() const {return conflict_frac_;}
+  double get_horizon() const {return horizon_;}
+  double get_max_miss() const {return max_miss_;}
+  std::string to_string() const;
+
+ protected:
+  using Box = std::array<std::array<double, 4>, 2>;
+  using Row = std::array<double, 8>;
+
+  Box read_box(const pybind11::array_t<double> &lims, const char *name) const;
+  double sample_dim(const Box &box, size_t dim);
+  void sample_nominal(Row &x);
+  void sample_conflict(Row &x);
+
+  // densities of vehicle 2's [x, y, th] given vehicle 1
+  double nominal_density(const Row &x) const;
+  double conflict_density(const Row &x) const;
+  double weight(const Row &x) const;
+
+  Box veh1_lims_;
+  Box veh2_lims_;
+  double v1_;
+  double v2_;
+  double horizon_;
+  double max_miss_;
+  double conflict_frac_;
+
+  // relative heading windows: head-on, crossing from either side and
+  // overtaking. They tile the circle, so every heading stays reachable
+  // and the variance of the weights stays bounded.
+  const std::array<double, 4> rel_heading_centers_ {
+    3.14159265358979323846, 1.57079632679489661923,
+    -1.57079632679489661923, 0.0};
+  const std::array<double, 4> rel_heading_probs_ {0.4, 0.25, 0.25, 0.1};
+  const double rel_heading_half_width_ = 3.14159265358979323846 / 4;
+  // vehicles slower than this relative to each other never conflict
+  const double min_rel_speed_ = 1e-6;
+
+  std::mt19937_64 rng_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_ENCOUNTERGENERATOR_H_
@@ -9,8 +9,8 @@ namespace fw_coll_env {
 class FwActionIndex {
  public:
   explicit FwActionIndex(const FwAvailActions &avail_actions);
-  int action_to_idx(const FwAction &ac);
-  FwAction idx_to_action(int idx);
+  int action_to_idx(const FwAction &ac) const;
+  FwAction idx_to_action(int idx) const;
 
  protected:
   FwAvailActions avail_actions_;
@@ -22,7 +22,7 @@ class FwAvailActions {
   }
 
   size_t action_to_idx(const FwSingleAction &ac) const;
-  FwSingleAction idx_to_action(size_t idx);
+  FwSingleAction idx_to_action(size_t idx) const;
   std::string to_string() const {return repr_;}
 
   const std::vector<double> &get_v() const {return v_;}
@@ -1,15 +1,20 @@
 #ifndef INCLUDE_FW_COLL_ENV_FWCOLLISIONENV_H_
 #define INCLUDE_FW_COLL_ENV_FWCOLLISIONENV_H_
 
+#include <fw-coll-env/TrajectoryRecorder.h>
 #include <fw-coll-env/Utils.h>
 
 #include <vector>
 #include <limits>
+#include <memory>
 #include <string>
+#include <tuple>
 #include <chrono>  // NOLINT
 
 namespace fw_coll_env {
 
+class BarrierGammaTurn;
+
 struct FwEnvStats {
   bool done_time = false;
   bool done_goal = false;
@@ -19,6 +24,11 @@ struct FwEnvStats {
   double dist_to_goal2 = std::numeric_limits<double>::quiet_NaN();
   double dist_to_veh = std::numeric_limits<double>::quiet_NaN();
 
+  // closest approach of the two vehicles over the last step interval
+  // (each vehicle moves along a straight segment during a step)
+  double t_closest_approach = std::numeric_limits<double>::quiet_NaN();
+  double dist_closest_approach = std::numeric_limits<double>::quiet_NaN();
+
   std::string to_string() const;
 };
 
@@ -30,12 +40,47 @@ class FwCollisionEnv {
     double safety_dist,
     const Point &goal1,
     const Point &goal2,
-    double time_warp);
+    double time_warp,
+    bool continuous_collision = false);
 
   bool step(const FwSingleAction &a1, const FwSingleAction &a2);
+  // like step, recording the FwActionIndex indices of a shielded step
+  bool step(
+      const FwSingleAction &a1, const FwSingleAction &a2,
+      int requested_idx, int executed_idx);
+
+  // applies a1 and a2 for up to k steps, stopping after the first step
+  // that is done or collided. Returns (stopped on done or collision,
+  // steps taken, minimum separation over the steps taken). The minimum is
+  // the swept closest approach when continuous_collision is set.
+  // Straight actions find the stopping step in closed form and skip the
+  // per-step trig and goal distances, with the same result as looping.
+  std::tuple<bool, int, double> step_n(
+      const FwSingleAction &a1, const FwSingleAction &a2, int k);
   void reset(const FwSingleState &x1, const FwSingleState &x2, double t);
   std::string to_string() const;
 
+  // shielded mode. The env owns a clone of barrier, which must have the
+  // env's dt (C++ copies of the env share it, the Python copies and
+  // pickles clone it), and step_shielded filters action_idx, a
+  // FwActionIndex index into the barrier's avail actions, with it before
+  // stepping. Returns (done, requested idx, executed idx, overridden).
+  void set_shield(const BarrierGammaTurn &barrier);
+  void clear_shield() {shield_.reset();}
+  bool has_shield() const {return shield_ != nullptr;}
+  std::shared_ptr<const BarrierGammaTurn> get_shield() const {return shield_;}
+  std::tuple<bool, int, int, bool> step_shielded(int action_idx);
+
+  // recording. Every reset and step appends a TrajectoryRow to stream of
+  // recorder (a new stream when none is given) and reset ends the
+  // episode. Copies of the env are not attached.
+  void set_recorder(std::shared_ptr<TrajectoryRecorder> recorder);
+  void set_recorder(std::shared_ptr<TrajectoryRecorder> recorder, size_t stream);
+  // ends the open episode and detaches
+  void clear_recorder();
+  bool has_recorder() const {return recorder_.recorder != nullptr;}
+  std::shared_ptr<TrajectoryRecorder> get_recorder() const {return recorder_.recorder;}
+
   const FwSingleState& get_x1() const {return x1_;}
   const FwSingleState& get_x2() const {return x2_;}
   double get_dt() const {return dt_;}
@@ -46,6 +91,8 @@ class FwCollisionEnv {
   double get_done_dist() const {return done_dist_;}
   double get_max_sim_time() const {return max_sim_time_;}
   double get_time_warp() const {return time_warp_;}
+  bool get_continuous_collision() const {return continuous_collision_;}
+  void set_continuous_collision(bool val) {continuous_collision_ = val;}
 
   bool get_done() const {return stats.done_time || stats.done_goal;}
 
@@ -55,6 +102,17 @@ class FwCollisionEnv {
 
  protected:
   void update_stats();
+  // dist_to_veh and the closest approach over the last step
+  void update_separation();
+  void pace();
+  void record(
+      const FwSingleAction *a1, const FwSingleAction *a2,
+      int requested_idx, int executed_idx);
+  double step_separation() const {
+    return continuous_collision_ ? stats.dist_closest_approach : stats.dist_to_veh;
+  }
+  int advance_straight(
+      const FwSingleAction &a1, const FwSingleAction &a2, int k, double &min_dist);
 
   double dt_;
   double max_sim_time_;
@@ -64,11 +122,25 @@ class FwCollisionEnv {
   Point goal2_;
 
   double time_warp_;
-  std::chrono::high_resolution_clock::time_point last_update_time_;
+  // detect collisions from the swept closest approach rather than
+  // only at the end of each step
+  bool continuous_collision_ = false;
+  // deadline of the last paced step
+  std::chrono::steady_clock::time_point step_deadline_;
+  // whether a step was paced since the last reset
+  bool paced_since_reset_ = false;
   double t_;
+  double t_prev_;
 
   FwSingleState x1_;
   FwSingleState x2_;
+
+  // states at the start of the last step
+  FwSingleState x1_prev_;
+  FwSingleState x2_prev_;
+
+  std::shared_ptr<const BarrierGammaTurn> shield_;
+  RecorderLink recorder_;
 };
 
 } // namespace fw_coll_env
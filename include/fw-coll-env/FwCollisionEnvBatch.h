@@ -0,0 +1,106 @@
+#ifndef INCLUDE_FW_COLL_ENV_FWCOLLISIONENVBATCH_H_
+#define INCLUDE_FW_COLL_ENV_FWCOLLISIONENVBATCH_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/ThreadPool.h>
+#include <fw-coll-env/Uhat.h>
+
+#include <memory>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace fw_coll_env {
+
+// A batch of FwCollisionEnv copies where vehicle 2 follows Uhat to goal2.
+// The batch is split into contiguous shards of shard_size environments
+// that are stepped by a persistent thread pool with the GIL released.
+// Every environment only depends on its own row, so results are the same
+// for any number of threads. A shield set on env (or with set_shield) is
+// cloned once and the clone is shared by all shards for step_shielded,
+// since barriers are reentrant. With a recorder set on env (or with
+// set_recorder) every environment records to its own stream.
+class FwCollisionEnvBatch {
+ public:
+  FwCollisionEnvBatch(
+    const FwCollisionEnv &env, size_t num_envs,
+    const FwAvailActions &avail_actions,
+    size_t num_threads, size_t shard_size);
+
+  // x is (num_envs, 8) in the FwState.asarray layout
+  void reset(pybind11::array_t<double> x, double t);
+
+  // a1_idx holds FwAvailActions indices for vehicle 1. An episode ends
+  // when an env is done or collided, as in step_n. When reset_x is given,
+  // environments whose episode ended with this step are reset to the
+  // matching row (and time 0) before returning. Returns the episode end
+  // flags from before any reset.
+  pybind11::array_t<bool> step(
+    pybind11::array_t<int> a1_idx,
+    std::optional<pybind11::array_t<double>> reset_x);
+
+  // like step but each env holds its vehicle 1 action for up to k steps
+  // (see FwCollisionEnv::step_n) and stops at its first done or collision.
+  // Returns the per env (done, steps taken, minimum separation).
+  std::tuple<pybind11::array_t<bool>, pybind11::array_t<int>, pybind11::array_t<double>>
+  step_n(
+    pybind11::array_t<int> a1_idx, int k,
+    std::optional<pybind11::array_t<double>> reset_x);
+
+  // like step but the joint action (a1_idx, Uhat for vehicle 2) is
+  // filtered by the shield first. Returns the per env (episode ended,
+  // requested FwActionIndex idx, executed FwActionIndex idx, overridden).
+  std::tuple<pybind11::array_t<bool>, pybind11::array_t<int>,
+             pybind11::array_t<int>, pybind11::array_t<bool>>
+  step_shielded(
+    pybind11::array_t<int> a1_idx,
+    std::optional<pybind11::array_t<double>> reset_x);
+
+  // barrier must use the same avail actions as the batch. With
+  // single_precision step_shielded filters with filter_action_f32.
+  void set_shield(const BarrierGammaTurn &barrier, bool single_precision = false);
+  void clear_shield() {shield_.reset(); single_precision_ = false;}
+  bool has_shield() const {return shield_ != nullptr;}
+  bool has_single_precision_shield() const {return shield_ && single_precision_;}
+
+  void set_recorder(std::shared_ptr<TrajectoryRecorder> recorder);
+  void clear_recorder();
+
+  pybind11::array_t<double> get_states() const;
+  pybind11::array_t<double> get_t() const;
+  pybind11::array_t<bool> get_done() const;
+  pybind11::array_t<bool> get_collided() const;
+  pybind11::array_t<double> get_dist_to_veh() const;
+  pybind11::array_t<double> get_dist_to_goal1() const;
+  pybind11::array_t<double> get_dist_to_goal2() const;
+
+  const FwCollisionEnv &get_env(size_t i) const;
+  size_t size() const {return envs_.size();}
+  size_t get_num_threads() const {return pool_->get_num_threads();}
+  size_t get_shard_size() const {return shard_size_;}
+  std::string to_string() const;
+
+ protected:
+  size_t num_shards() const {return (envs_.size() + shard_size_ - 1) / shard_size_;}
+  void check_rows(const pybind11::array_t<double> &x, const char *name) const;
+  void check_actions(const pybind11::array_t<int> &a1_idx) const;
+
+  std::vector<FwCollisionEnv> envs_;
+  FwAvailActions avail_actions_;
+  Uhat uhat2_;
+  size_t shard_size_;
+  std::unique_ptr<ThreadPool> pool_;
+
+  // shared by all shards
+  std::shared_ptr<const BarrierGammaTurn> shield_;
+  bool single_precision_ = false;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_FWCOLLISIONENVBATCH_H_
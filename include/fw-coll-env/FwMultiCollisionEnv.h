@@ -0,0 +1,99 @@
+#ifndef INCLUDE_FW_COLL_ENV_FWMULTICOLLISIONENV_H_
+#define INCLUDE_FW_COLL_ENV_FWMULTICOLLISIONENV_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/UniformGrid.h>
+#include <fw-coll-env/Utils.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// FwCollisionEnv for any number of aircraft, each with its own goal.
+// An aircraft is done when it reaches its goal (within done_dist) or
+// comes within safety_dist of another active aircraft. Done aircraft hold
+// their state and are ignored by the others. The episode is done at
+// max_sim_time or when every aircraft is done.
+//
+// Collisions and nearest intruders come from a UniformGrid rebuilt every
+// step with cells of safety_dist, so a step costs about O(N)
+// for bounded densities instead of checking all O(N^2) pairs.
+class FwMultiCollisionEnv {
+ public:
+  FwMultiCollisionEnv(
+      double dt, double max_sim_time, double done_dist, double safety_dist,
+      const FwAvailActions &avail_actions);
+
+  void reset(const std::vector<FwSingleState> &x, const std::vector<Point> &goals, double t);
+  // x is (N, 4) in the FwSingleState.asarray layout and goals (N, 3)
+  void reset(pybind11::array_t<double> x, pybind11::array_t<double> goals, double t);
+
+  // one action per aircraft (ignored for done aircraft), returns get_done
+  bool step(const std::vector<FwSingleAction> &actions);
+  // a_idx holds FwAvailActions indices
+  bool step(pybind11::array_t<int> a_idx);
+
+  // pairs (i, j), i < j, of active aircraft within radius, as (K, 2)
+  pybind11::array_t<int> pairs_within(double radius) const;
+
+  bool get_done() const {return t_ >= max_sim_time_ || num_active_ == 0;}
+  size_t size() const {return x_.size();}
+  size_t get_num_active() const {return num_active_;}
+  size_t get_num_collided() const;
+  double get_t() const {return t_;}
+  double get_dt() const {return dt_;}
+  double get_max_sim_time() const {return max_sim_time_;}
+  double get_done_dist() const {return done_dist_;}
+  double get_safety_dist() const {return safety_dist_;}
+  const FwAvailActions &get_avail_actions() const {return avail_actions_;}
+  const std::vector<FwSingleState> &get_x() const {return x_;}
+  const std::vector<Point> &get_goals() const {return goals_;}
+  const std::vector<bool> &get_active() const {return active_;}
+  const UniformGrid &get_grid() const {return grid_;}
+
+  // numpy views of the per aircraft state: (N, 4) states, done flags,
+  // distance to goal, nearest active intruder (-1 if none) and its
+  // distance, and the minimum separation from any intruder so far
+  pybind11::array_t<double> get_states() const;
+  pybind11::array_t<bool> get_goal_reached() const;
+  pybind11::array_t<bool> get_collided() const;
+  pybind11::array_t<double> get_dist_to_goal() const;
+  pybind11::array_t<int> get_nearest() const;
+  pybind11::array_t<double> get_dist_nearest() const;
+  pybind11::array_t<double> get_min_sep() const;
+  std::string to_string() const;
+
+ protected:
+  void update_stats();
+
+  double dt_;
+  double max_sim_time_;
+  double done_dist_;
+  double safety_dist_;
+  FwAvailActions avail_actions_;
+  double t_ = 0;
+
+  std::vector<FwSingleState> x_;
+  std::vector<Point> goals_;
+  std::vector<bool> active_;
+  std::vector<bool> goal_reached_;
+  std::vector<bool> collided_;
+  std::vector<double> dist_to_goal_;
+  std::vector<int> nearest_;
+  std::vector<double> dist_nearest_;
+  std::vector<double> min_sep_;
+  size_t num_active_ = 0;
+
+  UniformGrid grid_;
+  // scratch for the grid positions and collision pairs
+  std::vector<Point> points_;
+  std::vector<std::pair<int, int>> pairs_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_FWMULTICOLLISIONENV_H_
@@ -0,0 +1,39 @@
+#ifndef INCLUDE_FW_COLL_ENV_MAPPEDFILE_H_
+#define INCLUDE_FW_COLL_ENV_MAPPEDFILE_H_
+
+#include <string>
+
+namespace fw_coll_env {
+
+// read-only or read-write shared mapping of a whole file
+class MappedFile {
+ public:
+  // size is only used when creating the file for writing
+  MappedFile(const std::string &path, bool write, size_t size);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  // madvise on the pages covering [begin, end) bytes
+  void advise(size_t begin, size_t end, int advice) const;
+  // msync on the pages covering [begin, end) bytes
+  void sync(size_t begin, size_t end, int flags) const;
+
+  template <typename T>
+  T *data() const {return static_cast<T *>(data_);}
+  size_t size() const {return size_;}
+  const std::string &get_path() const {return path_;}
+
+ private:
+  static size_t page_start(size_t offset);
+  [[noreturn]] void fail(const char *what);
+
+  std::string path_;
+  int fd_ = -1;
+  void *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_MAPPEDFILE_H_
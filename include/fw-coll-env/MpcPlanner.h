@@ -0,0 +1,148 @@
+#ifndef INCLUDE_FW_COLL_ENV_MPCPLANNER_H_
+#define INCLUDE_FW_COLL_ENV_MPCPLANNER_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/ThreadPool.h>
+#include <fw-coll-env/Uhat.h>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fw_coll_env {
+
+struct MpcConfig {
+  // "mppi" weights every sample by exp(-cost / temperature), "cem" refits
+  // the sampling distribution to the elite_frac cheapest samples
+  std::string method = "mppi";
+  size_t num_samples = 256;
+  size_t horizon = 30;
+  // sample, roll out and refit this many times per plan
+  size_t num_iters = 3;
+  // sample continuous actions within the FwAvailActions bounds instead
+  // of the avail actions themselves
+  bool continuous = false;
+
+  // in units of the cost, see below
+  double temperature = 1;
+  double elite_frac = 0.1;
+  // spread of the samples at the start of a plan: the std of continuous
+  // samples as a fraction of each action range, or the weight of the
+  // uniform distribution mixed into the discrete probabilities
+  double noise_frac = 0.5;
+  // weight of the previous distribution when refitting the discrete
+  // action probabilities
+  double smoothing = 0.5;
+
+  // the cost of a sample is goal_weight times the mean distance of
+  // vehicle 1 to goal1, plus collision_cost for every step closer than
+  // safety_dist (Rho < 0), plus barrier_weight times max(0, -h) of the
+  // final state when a barrier is set
+  double goal_weight = 1;
+  double collision_cost = 1e4;
+  double barrier_weight = 100;
+
+  std::string to_string() const;
+};
+
+// Sampling MPC for vehicle 1 while vehicle 2 follows Uhat to goal2.
+// Every plan samples num_samples vehicle 1 action sequences over the
+// horizon, rolls them out on the env dynamics and refits the sampling
+// distribution (MPPI or CEM). Sample 0 is always the current plan.
+//
+// Uhat of vehicle 2 does not depend on vehicle 1, so its trajectory is
+// integrated once per plan and the rollouts only integrate vehicle 1.
+// Samples and rollout states are kept in SoA form and the rollouts are
+// split into shards run on a thread pool with the GIL released. Sampling
+// is done on the calling thread, so plans do not depend on the number of
+// threads. The distribution is warm started: the next plan starts from
+// this one shifted by one step, the first plan from Uhat to goal1.
+//
+// A mutex serializes the planner: plan waits for the calls of other
+// threads, and calls made while a plan runs without the GIL wait for it.
+class MpcPlanner {
+ public:
+  MpcPlanner(
+      const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+      const MpcConfig &config, size_t num_threads, uint64_t seed);
+
+  // scores the final state of every rollout with h of barrier
+  void set_barrier(const BarrierGammaTurn &barrier);
+  void clear_barrier();
+  bool has_barrier() const;
+
+  // returns the first action of the plan for vehicle 1
+  FwSingleAction plan(const FwSingleState &x1, const FwSingleState &x2);
+  // plan rounded to the closest avail action, as an FwAvailActions index
+  int plan_idx(const FwSingleState &x1, const FwSingleState &x2);
+  // forgets the warm start
+  void reset();
+
+  // (horizon, 3) planned [v, w, dz] of every step
+  pybind11::array_t<double> get_plan() const;
+  // (horizon, num avail actions) discrete sampling probabilities
+  pybind11::array_t<double> get_probs() const;
+  // (num_samples,) costs of the last rollouts
+  pybind11::array_t<double> get_costs() const;
+
+  const MpcConfig &get_config() const {return config_;}
+  size_t get_num_threads() const {return pool_->get_num_threads();}
+  std::string to_string() const;
+
+ protected:
+  void init_distribution(const FwSingleState &x1);
+  void shift_distribution();
+  void sample();
+  void rollout_shard(size_t shard, const FwSingleState &x1);
+  void refit();
+  // the planned action of step t
+  FwSingleAction planned(size_t t) const;
+  size_t num_shards() const {return (config_.num_samples + shard_size_ - 1) / shard_size_;}
+
+  MpcConfig config_;
+  bool cem_;
+  double dt_;
+  double safety_dist_;
+  Uhat uhat1_;
+  Uhat uhat2_;
+  std::vector<FwSingleAction> all_actions_;
+  // bounds of v, w and dz
+  double lo_[3];
+  double hi_[3];
+  std::shared_ptr<const BarrierGammaTurn> barrier_;
+
+  std::unique_ptr<ThreadPool> pool_;
+  std::mt19937_64 rng_;
+  bool warm_ = false;
+
+  // sampling distribution over the horizon, entry t * 3 + d for the
+  // continuous mean and std, t * num actions + a for the probabilities
+  std::vector<double> mean_;
+  std::vector<double> std_;
+  std::vector<double> probs_;
+
+  // samples and rollout states in SoA form, entry t * num_samples + k
+  std::vector<double> v_;
+  std::vector<double> w_;
+  std::vector<double> dz_;
+  std::vector<int> idx_;
+  std::vector<double> costs_;
+  std::vector<double> x1_, y1_, th1_, z1_;
+  // vehicle 2 over the horizon, entry t is the state after t steps
+  std::vector<FwSingleState> traj2_;
+
+  const size_t shard_size_ = 32;
+  // guards the barrier, the warm start, the distribution and the rollouts
+  mutable std::mutex mutex_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_MPCPLANNER_H_
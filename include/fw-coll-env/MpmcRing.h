@@ -0,0 +1,104 @@
+#ifndef INCLUDE_FW_COLL_ENV_MPMCRING_H_
+#define INCLUDE_FW_COLL_ENV_MPMCRING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+// Bounded lock-free multi-producer multi-consumer queue (Vyukov). Every
+// cell carries a sequence number: a cell at position pos is free for a
+// producer when seq == pos and holds an item for a consumer when
+// seq == pos + 1, so producers and consumers only contend on their own
+// cursor and never block each other. The capacity is rounded up to a
+// power of two.
+template <typename T>
+class MpmcRing {
+ public:
+  explicit MpmcRing(size_t capacity) {
+    if (capacity == 0) {
+      throw std::runtime_error("MpmcRing capacity must be positive");
+    }
+    size_t size = 1;
+    while (size < capacity) {
+      size *= 2;
+    }
+    mask_ = size - 1;
+    cells_.reset(new Cell[size]);
+    for (size_t i = 0; i < size; i++) {
+      cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpmcRing(const MpmcRing &) = delete;
+  MpmcRing &operator=(const MpmcRing &) = delete;
+
+  // false when the queue is full
+  bool try_push(const T &item) {
+    size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells_[pos & mask_];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          cell.data = item;
+          cell.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // false when the queue is empty
+  bool try_pop(T &item) {
+    size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell &cell = cells_[pos & mask_];
+      const size_t seq = cell.seq.load(std::memory_order_acquire);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          item = cell.data;
+          cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  size_t capacity() const {return mask_ + 1;}
+
+  // only exact when no push or pop is in flight
+  size_t size_approx() const {
+    const size_t tail = enqueue_pos_.load(std::memory_order_relaxed);
+    const size_t head = dequeue_pos_.load(std::memory_order_relaxed);
+    return tail > head ? tail - head : 0;
+  }
+
+ protected:
+  struct alignas(64) Cell {
+    std::atomic<size_t> seq;
+    T data;
+  };
+
+  std::unique_ptr<Cell[]> cells_;
+  size_t mask_ = 0;
+
+  // on separate cache lines so producers and consumers do not false share
+  alignas(64) std::atomic<size_t> enqueue_pos_ {0};
+  alignas(64) std::atomic<size_t> dequeue_pos_ {0};
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_MPMCRING_H_
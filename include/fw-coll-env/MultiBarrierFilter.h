@@ -0,0 +1,105 @@
+#ifndef INCLUDE_FW_COLL_ENV_MULTIBARRIERFILTER_H_
+#define INCLUDE_FW_COLL_ENV_MULTIBARRIERFILTER_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/FwMultiCollisionEnv.h>
+#include <fw-coll-env/UniformGrid.h>
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Safety filter for N aircraft built from the pairwise barrier. Instead of
+// searching the |A|^N joint actions, every pair (i, j) gets the
+// constraint bf_constraint(x_ij, a_i, a_j) >= 0 of barrier.
+//
+// Pairs farther apart than get_cull_dist cannot violate it: within one
+// step and one evasive rollout they cannot close in to where h drops
+// below max_val, so h and hnext are both max_val. The remaining pairs come
+// from a UniformGrid and their constraint values are computed lazily and
+// cached per call, so the cost scales with the pairs near a conflict.
+//
+// Starting from uhat, violated pairs are taken most urgent (lowest h)
+// first and their two aircraft are chosen jointly as choose_u does for
+// two aircraft (aircraft already chosen for an earlier pair stay fixed).
+// Then up to max_sweeps rounds of coordinate descent move each aircraft
+// of a still violated pair to the action with the smallest total
+// violation over its pairs, ties broken by the distance to its uhat.
+// For two aircraft this is exactly BarrierGammaTurn::choose_u.
+class MultiBarrierFilter {
+ public:
+  MultiBarrierFilter(const BarrierGammaTurn &barrier, size_t max_sweeps);
+
+  // FwAvailActions indices for every aircraft, inactive ones keep uhat
+  std::vector<int> filter(
+      const std::vector<FwSingleState> &x, const std::vector<int> &uhat_idx,
+      const std::vector<bool> &active);
+
+  // x is (N, 4) in the FwSingleState.asarray layout
+  pybind11::array_t<int> choose_u(
+      pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx);
+  // for the active aircraft of env
+  pybind11::array_t<int> choose_u_env(
+      const FwMultiCollisionEnv &env, pybind11::array_t<int> uhat_idx);
+
+  double get_cull_dist() const {return cull_dist_;}
+  size_t get_max_sweeps() const {return max_sweeps_;}
+  const BarrierGammaTurn &get_barrier() const {return *barrier_;}
+
+  // statistics of the last call: pairs within the cull distance, pairs
+  // violated by uhat, constraint evaluations, sweeps run and pairs left
+  // violated
+  size_t get_num_pairs() const {return num_pairs_;}
+  size_t get_num_violated() const {return num_violated_;}
+  size_t get_num_evals() const {return num_evals_;}
+  size_t get_num_sweeps() const {return num_sweeps_;}
+  size_t get_num_unresolved() const {return num_unresolved_;}
+  std::string to_string() const;
+
+ protected:
+  struct Pair {
+    int i;
+    int j;
+    FwState x;
+    double h;
+    // bf_constraint per joint action a_i * |A| + a_j, NaN until computed
+    std::vector<double> bf;
+  };
+
+  double calc_cull_dist() const;
+  double pair_bf(Pair &p, int a_i, int a_j);
+  double violation(Pair &p, const std::vector<int> &a);
+  void solve_pair(
+      Pair &p, const std::vector<int> &uhat_idx, const std::vector<bool> &fixed,
+      std::vector<int> &a);
+  bool descend(
+      int i, const std::vector<int> &uhat_idx,
+      const std::vector<std::vector<size_t>> &pairs_of, std::vector<int> &a);
+  pybind11::array_t<int> choose_u(
+      const std::vector<FwSingleState> &x, pybind11::array_t<int> uhat_idx,
+      const std::vector<bool> &active);
+
+  std::shared_ptr<const BarrierGammaTurn> barrier_;
+  BarrierParams params_;
+  size_t max_sweeps_;
+  double cull_dist_;
+  UniformGrid grid_;
+  std::vector<Pair> pairs_;
+  // pruning counts of the running call, added to the barrier at its end
+  PruneCounts counts_;
+
+  size_t num_pairs_ = 0;
+  size_t num_violated_ = 0;
+  size_t num_evals_ = 0;
+  size_t num_sweeps_ = 0;
+  size_t num_unresolved_ = 0;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_MULTIBARRIERFILTER_H_
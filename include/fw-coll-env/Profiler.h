@@ -0,0 +1,140 @@
+#ifndef INCLUDE_FW_COLL_ENV_PROFILER_H_
+#define INCLUDE_FW_COLL_ENV_PROFILER_H_
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <cstdint>
+#include <string>
+
+// Instrumentation of the barrier, env and Uhat hot paths. Counters and
+// latency histograms are kept per thread (only the owning thread writes
+// them) and summed by snapshot. Recording is off until set_enabled, which
+// leaves one relaxed load per instrumented site. Building with
+// FW_COLL_ENV_NO_PROFILING removes the sites altogether.
+//
+// With tracing on, timed scopes are also kept as Chrome trace events
+// (chrome://tracing or Perfetto) that write_trace saves as JSON.
+
+namespace fw_coll_env {
+namespace profiler {
+
+enum class Counter : size_t {
+  // rows given to choose_u and rows whose uhat it replaced
+  choose_u_rows,
+  choose_u_overrides,
+  // choose_u_single calls with an unsafe uhat and the candidates they evaluated
+  choose_u_searches,
+  choose_u_candidates,
+  // choose_u_anytime rows whose budget ran out before the search finished
+  choose_u_incomplete,
+  // states given to safe_action_mask
+  safe_mask_rows,
+  // evasive maneuver rollouts and the steps they integrated
+  rollouts,
+  rollout_steps,
+  env_steps,
+  uhat_calls,
+  // MpcPlanner sample rollouts and the steps they integrated
+  mpc_rollouts,
+  mpc_rollout_steps,
+  num_counters
+};
+
+enum class Timer : size_t {
+  choose_u,
+  choose_u_search,
+  safe_action_mask,
+  closest_future_dist,
+  env_step,
+  env_batch_step,
+  time_warp_sleep,
+  mpc_plan,
+  num_timers
+};
+
+constexpr size_t num_counters = static_cast<size_t>(Counter::num_counters);
+constexpr size_t num_timers = static_cast<size_t>(Timer::num_timers);
+// bucket b counts latencies in [2^(b - 1), 2^b) ns, bucket 0 is 0 ns
+constexpr size_t num_buckets = 48;
+
+const char *counter_name(Counter counter);
+const char *timer_name(Timer timer);
+
+inline std::atomic<bool> &enabled_flag() {
+  static std::atomic<bool> flag {false};
+  return flag;
+}
+
+inline bool enabled() {return enabled_flag().load(std::memory_order_relaxed);}
+void set_enabled(bool enabled);
+bool tracing();
+// max_events bounds the events kept per thread, later ones are dropped
+void set_tracing(bool tracing, size_t max_events);
+
+void add(Counter counter, uint64_t n);
+// start_ns is relative to the profiler epoch
+void record(Timer timer, uint64_t start_ns, uint64_t duration_ns);
+uint64_t now_ns();
+
+struct TimerSnapshot {
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+  uint64_t max_ns = 0;
+  uint64_t buckets[num_buckets] = {};
+};
+
+struct Snapshot {
+  uint64_t counters[num_counters] = {};
+  TimerSnapshot timers[num_timers];
+  uint64_t trace_events = 0;
+  uint64_t trace_dropped = 0;
+};
+
+// sums over all threads, including finished ones
+Snapshot snapshot();
+// clears counters, histograms and trace events. Threads recording
+// meanwhile may keep part of what they recorded.
+void reset();
+void write_trace(const std::string &path);
+
+class ScopedTimer {
+ public:
+  explicit ScopedTimer(Timer timer) :
+      timer_(timer), active_(enabled()), start_ns_(active_ ? now_ns() : 0) {}
+  ~ScopedTimer() {
+    if (active_) {
+      record(timer_, start_ns_, now_ns() - start_ns_);
+    }
+  }
+
+  ScopedTimer(const ScopedTimer &) = delete;
+  ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+ private:
+  Timer timer_;
+  bool active_;
+  uint64_t start_ns_;
+};
+
+} // namespace profiler
+} // namespace fw_coll_env
+
+#define FW_PROFILE_CONCAT_(a, b) a##b
+#define FW_PROFILE_CONCAT(a, b) FW_PROFILE_CONCAT_(a, b)
+
+#ifdef FW_COLL_ENV_NO_PROFILING
+#define FW_PROFILE_COUNT(counter, n) do {(void)(n);} while (0)
+#define FW_PROFILE_SCOPE(timer) do {} while (0)
+#else
+#define FW_PROFILE_COUNT(counter, n) \
+  do { \
+    if (::fw_coll_env::profiler::enabled()) { \
+      ::fw_coll_env::profiler::add(::fw_coll_env::profiler::Counter::counter, n); \
+    } \
+  } while (0)
+#define FW_PROFILE_SCOPE(timer) \
+  ::fw_coll_env::profiler::ScopedTimer FW_PROFILE_CONCAT(fw_profile_scope_, __LINE__)( \
+      ::fw_coll_env::profiler::Timer::timer)
+#endif
+
+#endif // INCLUDE_FW_COLL_ENV_PROFILER_H_
@@ -0,0 +1,133 @@
+#ifndef INCLUDE_FW_COLL_ENV_REALTIMESIM_H_
+#define INCLUDE_FW_COLL_ENV_REALTIMESIM_H_
+
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/SeqLock.h>
+#include <fw-coll-env/Uhat.h>
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <exception>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+
+namespace fw_coll_env {
+
+// state published after every step of a RealtimeSim
+struct RealtimeSnapshot {
+  // steps since start, 0 for the state start was called with
+  uint64_t step = 0;
+  double t = 0;
+  // FwState.asarray layout
+  double x[8] = {};
+  // executed a1 (v, w, dz) then a2 (v, w, dz), NaN before the first step
+  double action[6] = {};
+  bool overridden = false;
+  bool done = false;
+  bool collided = false;
+  double dist_to_veh = 0;
+  // seconds the step started after its deadline
+  double lateness = 0;
+};
+
+// timing of a RealtimeSim since start
+struct RealtimeStats {
+  uint64_t num_steps = 0;
+  // steps that finished after the next deadline
+  uint64_t num_overruns = 0;
+  // deadlines dropped instead of caught up
+  uint64_t num_skipped = 0;
+  // steps without a new action, which hold the previous one
+  uint64_t num_stale = 0;
+  // lateness in seconds
+  double mean_lateness = 0;
+  double rms_lateness = 0;
+  double max_lateness = 0;
+};
+
+// Steps a copy of env on a native thread in real time (scaled by
+// time_warp) until it is done, collides or is stopped. Step k starts at
+// the absolute deadline start + k * dt / time_warp. When the thread falls
+// behind, up to max_catch_up missed steps run back to back and the
+// deadlines beyond that are dropped.
+//
+// Actions are FwAvailActions indices posted to a lock-free mailbox, the
+// latest one wins and is held until replaced. -1 (and the time before
+// the first action) lets the vehicle follow Uhat to its goal. A shield on
+// env filters every step. The state and the statistics are published
+// through seqlocks, so readers never block the sim thread. An exception
+// on the sim thread ends the run and is rethrown by the stop, wait or
+// start that joins the thread.
+class RealtimeSim {
+ public:
+  RealtimeSim(
+      const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+      double time_warp, size_t max_catch_up);
+  ~RealtimeSim();
+
+  RealtimeSim(const RealtimeSim &) = delete;
+  RealtimeSim &operator=(const RealtimeSim &) = delete;
+
+  void start();
+  void stop();
+  // waits up to timeout seconds for the sim thread to finish, true if it did
+  bool wait(double timeout);
+  bool is_running() const {return running_;}
+
+  // only while stopped
+  void reset(const FwSingleState &x1, const FwSingleState &x2, double t);
+  const FwCollisionEnv &get_env() const;
+
+  void post_action(int a1_idx, int a2_idx);
+  RealtimeSnapshot snapshot() const {return snapshot_.load();}
+  RealtimeStats stats() const {return stats_.load();}
+
+  double get_time_warp() const {return time_warp_;}
+  size_t get_max_catch_up() const {return max_catch_up_;}
+  std::string to_string() const;
+
+ protected:
+  using Clock = std::chrono::steady_clock;
+
+  void run();
+  // joins the sim thread and rethrows its exception, if any
+  void join();
+  // steps with the latest actions and publishes the snapshot
+  void step_once(double lateness);
+  RealtimeSnapshot make_snapshot() const;
+
+  FwCollisionEnv env_;
+  FwAvailActions avail_actions_;
+  Uhat uhat1_;
+  Uhat uhat2_;
+  double time_warp_;
+  size_t max_catch_up_;
+
+  // posted_bit | (a1_idx + 1) << 32 | (a2_idx + 1), 0 when no new action
+  // was posted. The bit tells a post of (-1, -1) apart from no post.
+  static constexpr uint64_t posted_bit = uint64_t(1) << 63;
+  std::atomic<uint64_t> mailbox_ {0};
+  int a1_idx_ = -1;
+  int a2_idx_ = -1;
+
+  SeqLock<RealtimeSnapshot> snapshot_;
+  SeqLock<RealtimeStats> stats_;
+  RealtimeStats local_stats_;
+  double sum_lateness_ = 0;
+  double sum_sq_lateness_ = 0;
+
+  std::atomic<bool> running_ {false};
+  bool stop_requested_ = false;
+  // exception of the sim thread, guarded by mutex_
+  std::exception_ptr error_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread thread_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_REALTIMESIM_H_
@@ -0,0 +1,132 @@
+#ifndef INCLUDE_FW_COLL_ENV_REPLAYBUFFER_H_
+#define INCLUDE_FW_COLL_ENV_REPLAYBUFFER_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/FwAvailActions.h>
+#include <fw-coll-env/Utils.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Ring buffer of (state, obs, joint action idx, override flag) transitions.
+// States and observations are stored as int16 relative to [low; high]
+// bounds (values outside are clamped), actions as uint16 and the flag as
+// uint8, about 4x smaller than float64 rows.
+//
+// insert is lock-free and may be called from several threads: each
+// insert claims a slot with an atomic cursor and publishes it through a
+// per-slot sequence number, so samplers skip slots that are being
+// written. Priorities live in a sum tree whose nodes are updated with
+// atomic adds. Sampling uses one rng and must not run concurrently with
+// other sampling.
+class ReplayBuffer {
+ public:
+  // state_lims is (2, 8) and obs_lims (2, obs_dim)
+  ReplayBuffer(
+      size_t capacity, const FwAvailActions &avail_actions,
+      pybind11::array_t<double> state_lims, pybind11::array_t<double> obs_lims,
+      uint64_t seed);
+
+  // x is the FwState.asarray layout and obs has obs_dim values. New
+  // transitions get the largest priority seen so far.
+  void insert(const double *x, const double *obs, int action_idx, bool overridden);
+  void insert(
+      const double *x, const double *obs, int action_idx, bool overridden,
+      double priority);
+
+  // batched insert of (N, 8) states, (N, obs_dim) obs and (N,) actions,
+  // flags and optionally priorities (already raised to any exponent)
+  void add(
+      pybind11::array_t<double> x, pybind11::array_t<double> obs,
+      pybind11::array_t<int> action_idx, pybind11::array_t<bool> overridden,
+      std::optional<pybind11::array_t<double>> priorities);
+
+  // outputs are written in place, so they are bound with noconvert: an
+  // array of another dtype or layout is rejected instead of filling a
+  // temporary converted copy
+  template <typename T>
+  using OutArray = pybind11::array_t<T, pybind11::array::c_style>;
+
+  // fill the preallocated outputs with a batch of their length. The
+  // prioritized version samples one transition per equal priority
+  // stratum and writes each sampling probability to prob_out.
+  void sample(
+      OutArray<double> x_out, OutArray<double> obs_out,
+      OutArray<int> action_out, OutArray<bool> overridden_out,
+      OutArray<int64_t> idx_out);
+  void sample_prioritized(
+      OutArray<double> x_out, OutArray<double> obs_out,
+      OutArray<int> action_out, OutArray<bool> overridden_out,
+      OutArray<int64_t> idx_out, OutArray<double> prob_out);
+
+  void update_priorities(pybind11::array_t<int64_t> idx, pybind11::array_t<double> priorities);
+
+  size_t size() const;
+  size_t get_capacity() const {return capacity_;}
+  size_t get_obs_dim() const {return obs_dim_;}
+  size_t get_num_inserted() const {return cursor_.load();}
+  double get_total_priority() const {return tree_[1].load();}
+  double get_max_priority() const {return max_priority_.load();}
+  // bytes used by the transition storage
+  size_t get_nbytes() const;
+  std::string to_string() const;
+
+ protected:
+  struct Quantizer {
+    std::vector<double> low;
+    std::vector<double> scale;
+
+    int16_t encode(size_t dim, double val) const;
+    double decode(size_t dim, int16_t val) const;
+  };
+
+  Quantizer read_lims(
+      const pybind11::array_t<double> &lims, size_t dim, const char *name) const;
+  void set_priority(size_t slot, double priority);
+  size_t find_prefix_sum(double u) const;
+  void check_outputs(
+      const OutArray<double> &x_out, const OutArray<double> &obs_out,
+      const OutArray<int> &action_out, const OutArray<bool> &overridden_out,
+      const OutArray<int64_t> &idx_out) const;
+  // copies a published slot, false when it is unset or being written
+  bool read_slot(
+      size_t slot, double *x, double *obs, int &action_idx, bool &overridden) const;
+
+  size_t capacity_;
+  size_t obs_dim_;
+  size_t num_actions_;
+  Quantizer state_q_;
+  Quantizer obs_q_;
+
+  std::vector<int16_t> states_;
+  std::vector<int16_t> obs_;
+  std::vector<uint16_t> actions_;
+  std::vector<uint8_t> overridden_;
+
+  // 0 for never written, odd while being written and
+  // 2 * (insert number + 1) once published
+  std::unique_ptr<std::atomic<uint64_t>[]> seq_;
+  std::atomic<uint64_t> cursor_ {0};
+
+  // sum tree with leaves at tree_leaves_ + slot
+  size_t tree_leaves_;
+  std::unique_ptr<std::atomic<double>[]> tree_;
+  std::atomic<double> max_priority_ {1.0};
+
+  // retries before giving up on a slot that keeps being overwritten
+  const int max_read_retries_ = 16;
+
+  std::mt19937_64 rng_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_REPLAYBUFFER_H_
@@ -0,0 +1,69 @@
+#ifndef INCLUDE_FW_COLL_ENV_SEQLOCK_H_
+#define INCLUDE_FW_COLL_ENV_SEQLOCK_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace fw_coll_env {
+
+// Single writer, many reader sequence lock for a trivially copyable T.
+// The writer never waits: it makes the sequence odd, stores the value and
+// makes it even again. Readers copy the value and retry when the sequence
+// was odd or changed meanwhile. The value is kept in relaxed atomic words
+// so a torn copy is never a data race, only a retry.
+template <typename T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable T");
+
+ public:
+  SeqLock() : SeqLock(T{}) {}
+  explicit SeqLock(const T &val) {store(val);}
+
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  void store(const T &val) {
+    uint64_t buf[num_words] = {};
+    std::memcpy(buf, &val, sizeof(T));
+
+    const uint64_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < num_words; i++) {
+      words_[i].store(buf[i], std::memory_order_relaxed);
+    }
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    uint64_t buf[num_words];
+    for (;;) {
+      const uint64_t seq = seq_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        continue;
+      }
+      for (size_t i = 0; i < num_words; i++) {
+        buf[i] = words_[i].load(std::memory_order_relaxed);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq) {
+        break;
+      }
+    }
+
+    T val;
+    std::memcpy(&val, buf, sizeof(T));
+    return val;
+  }
+
+ protected:
+  static constexpr size_t num_words = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  alignas(64) std::atomic<uint64_t> seq_ {0};
+  std::atomic<uint64_t> words_[num_words];
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_SEQLOCK_H_
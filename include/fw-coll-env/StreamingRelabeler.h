@@ -0,0 +1,45 @@
+#ifndef INCLUDE_FW_COLL_ENV_STREAMINGRELABELER_H_
+#define INCLUDE_FW_COLL_ENV_STREAMINGRELABELER_H_
+
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/ThreadPool.h>
+
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Relabels datasets too large for memory. The inputs are raw files of
+// (N, 8) float64 states in the FwState.asarray layout and (N,) int32
+// FwActionIndex uhat indices. They are memory mapped and processed in
+// blocks of block_rows: while a block is filtered by the thread pool the
+// next one is prefetched and the finished one is dropped from the page
+// cache, so memory stays bounded by a few blocks. Outputs are raw files
+// of (N,) float64 h(x0), int32 safe action indices and uint8 override
+// flags.
+class StreamingRelabeler {
+ public:
+  StreamingRelabeler(
+      const BarrierGammaTurn &barrier, size_t num_threads, size_t block_rows);
+
+  // returns (rows processed, rows overridden)
+  std::tuple<size_t, size_t> run(
+      const std::string &states_path, const std::string &actions_path,
+      const std::string &h_path, const std::string &safe_path,
+      const std::string &override_path);
+
+  size_t get_num_threads() const {return pool_->get_num_threads();}
+  size_t get_block_rows() const {return block_rows_;}
+  std::string to_string() const;
+
+ protected:
+  // shared by the chunks of a block
+  std::shared_ptr<const BarrierGammaTurn> barrier_;
+  size_t block_rows_;
+  std::unique_ptr<ThreadPool> pool_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_STREAMINGRELABELER_H_
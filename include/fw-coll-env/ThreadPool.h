@@ -0,0 +1,61 @@
+#ifndef INCLUDE_FW_COLL_ENV_THREADPOOL_H_
+#define INCLUDE_FW_COLL_ENV_THREADPOOL_H_
+
+#include <condition_variable>  // NOLINT
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace fw_coll_env {
+
+// Persistent pool of worker threads. With pin_threads worker i is pinned
+// to the i-th core of the process affinity mask (modulo its size); pools
+// are not pinned by default since several pools in one process would
+// share the same cores.
+// run() splits the tasks into one contiguous range per worker and
+// workers that finish early steal from the back of the other ranges.
+// Tasks must only write state owned by their own index so that results
+// do not depend on the number of threads or on which thread ran a task.
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t num_threads, bool pin_threads = false);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+
+  // calls fn(task) for every task in [0, num_tasks) and blocks until
+  // all of them have finished. The first exception thrown by a task is
+  // rethrown here. With no worker threads the tasks run inline.
+  void run(size_t num_tasks, const std::function<void(size_t)> &fn);
+
+  size_t get_num_threads() const {return workers_.size();}
+
+ protected:
+  struct TaskRange {
+    std::mutex mtx;
+    size_t begin = 0;
+    size_t end = 0;
+  };
+
+  void worker_loop(size_t worker);
+  bool next_task(size_t worker, size_t &task);
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<TaskRange>> ranges_;
+
+  std::mutex mtx_;
+  std::condition_variable start_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(size_t)> *fn_ = nullptr;
+  size_t generation_ = 0;
+  size_t busy_ = 0;
+  bool stop_ = false;
+  std::exception_ptr error_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_THREADPOOL_H_
@@ -0,0 +1,88 @@
+#ifndef INCLUDE_FW_COLL_ENV_TRAJECTORYREADER_H_
+#define INCLUDE_FW_COLL_ENV_TRAJECTORYREADER_H_
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include <fw-coll-env/MappedFile.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Reads files written by TrajectoryRecorder. The file is memory mapped
+// and the arrays returned are read-only views: raw blocks are viewed in
+// place and compressed blocks are inflated once into a buffer shared by
+// all views of that block. The mapping and buffers live as long as any
+// view does.
+class TrajectoryReader {
+ public:
+  explicit TrajectoryReader(const std::string &path);
+
+  struct Column {
+    std::string name;
+    std::string dtype;
+    size_t itemsize;
+    size_t width;
+  };
+
+  // pointer to the first row of column col of episode, valid while owner is
+  const char *episode_data(
+      size_t episode, size_t col, std::shared_ptr<const void> &owner);
+  size_t column_index(const std::string &name) const;
+
+  // {column name: (rows,) or (rows, width) view} of episode
+  pybind11::dict episode(size_t episode);
+  // column of one episode (a view) or of all episodes in order (a view
+  // when the file has one raw chunk, otherwise a copy)
+  pybind11::array column(const std::string &name, std::optional<size_t> episode);
+
+  size_t get_num_episodes() const {return episodes_.size();}
+  size_t get_num_chunks() const {return chunks_.size();}
+  size_t get_num_rows() const {return num_rows_;}
+  const std::vector<Column> &get_columns() const {return columns_;}
+  // rows and stream of every episode
+  pybind11::array_t<int64_t> get_episode_lengths() const;
+  pybind11::array_t<int64_t> get_episode_streams() const;
+  // whether any block is compressed, in which case views of it are
+  // backed by an inflated copy instead of the mapping
+  bool get_compressed() const;
+  std::string to_string() const;
+
+ protected:
+  struct Chunk {
+    uint64_t row_begin;
+    uint64_t num_rows;
+    std::vector<uint64_t> offset;
+    std::vector<uint64_t> stored;
+    std::vector<uint64_t> raw;
+  };
+  struct Episode {
+    uint64_t row_begin;
+    uint64_t num_rows;
+    uint64_t chunk;
+    uint64_t stream;
+  };
+
+  // start of the inflated block of col in chunk
+  const char *block(size_t chunk, size_t col, std::shared_ptr<const void> &owner);
+  pybind11::array view(
+      size_t col, const char *data, size_t rows, std::shared_ptr<const void> owner) const;
+  const Episode &get_episode(size_t episode) const;
+
+  std::shared_ptr<MappedFile> file_;
+  std::vector<Column> columns_;
+  std::vector<Chunk> chunks_;
+  std::vector<Episode> episodes_;
+  size_t num_rows_ = 0;
+  std::map<std::pair<size_t, size_t>, std::shared_ptr<std::vector<char>>> inflated_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_TRAJECTORYREADER_H_
@@ -0,0 +1,199 @@
+#ifndef INCLUDE_FW_COLL_ENV_TRAJECTORYRECORDER_H_
+#define INCLUDE_FW_COLL_ENV_TRAJECTORYRECORDER_H_
+
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace fw_coll_env {
+
+// One recorded FwCollisionEnv state, after a reset (no action) or a step.
+struct TrajectoryRow {
+  double t;
+  // FwState.asarray layout
+  double x[8];
+  // a1 (v, w, dz) then a2 (v, w, dz), NaN after a reset
+  double action[6];
+  // FwActionIndex indices of a shielded step, -1 otherwise
+  int32_t requested_idx;
+  int32_t executed_idx;
+  bool overridden;
+  double dist_to_veh;
+  double dist_to_goal1;
+  double dist_to_goal2;
+  double dist_closest_approach;
+  bool done_time;
+  bool done_goal;
+  bool done_collision;
+};
+
+// a fixed width column of TrajectoryRow
+struct TrajectoryColumn {
+  const char *name;
+  // numpy dtype string
+  const char *dtype;
+  size_t itemsize;
+  size_t width;
+  size_t offset;
+
+  size_t row_bytes() const {return itemsize * width;}
+};
+
+const std::vector<TrajectoryColumn> &trajectory_columns();
+
+// File layout (little endian): a header of trajectory_align bytes starting
+// with trajectory_magic and the uint64 format version, the column blocks
+// of every chunk each starting on a trajectory_align boundary, the footer,
+// and last the uint64 footer offset and trajectory_magic again. The footer
+// is all uint64 apart from the strings: num_columns, (name[32], dtype[8],
+// width) per column, num_chunks, (row_begin, num_rows, (offset, stored,
+// raw) per column) per chunk, num_episodes and (row_begin, num_rows,
+// chunk, stream) per episode. A block is compressed iff stored != raw.
+constexpr char trajectory_magic[] = "FWTRAJ01";
+constexpr uint64_t trajectory_version = 1;
+constexpr size_t trajectory_align = 64;
+
+// Streams TrajectoryRows to a columnar file. Rows are appended to streams
+// (one per env) and an episode is the rows of a stream between two calls
+// of end_episode. Finished episodes are gathered into chunks of about
+// chunk_rows rows (an episode is never split) and each column of a chunk
+// is written as one block, zlib compressed when compression_level is 1 to
+// 9. close writes a footer indexing the columns, chunks and episodes.
+//
+// Chunks are compressed and written by a writer thread, so end_episode
+// (called by FwCollisionEnv::reset) only moves rows and never waits on
+// zlib or the file unless max_queued_chunks chunks are already waiting.
+// Errors of the writer thread are rethrown by the next end_episode, flush
+// or close. Any call after close throws.
+//
+// Every stream must only be appended to by one thread at a time, other
+// calls may come from any thread. Streams are added before recording.
+class TrajectoryRecorder {
+ public:
+  TrajectoryRecorder(const std::string &path, size_t chunk_rows, int compression_level);
+  ~TrajectoryRecorder();
+
+  TrajectoryRecorder(const TrajectoryRecorder &) = delete;
+  TrajectoryRecorder &operator=(const TrajectoryRecorder &) = delete;
+
+  size_t add_stream();
+  void append(size_t stream, const TrajectoryRow &row);
+  // finishes the open episode of stream (if it has rows)
+  void end_episode(size_t stream);
+  // writes the finished episodes not yet written as a chunk and waits
+  // for the writer thread to write every queued chunk
+  void flush();
+  // finishes all open episodes, flushes and writes the footer
+  void close();
+
+  bool is_closed() const {return closed_;}
+  const std::string &get_path() const {return path_;}
+  size_t get_chunk_rows() const {return chunk_rows_;}
+  int get_compression_level() const {return compression_level_;}
+  size_t get_num_streams() const;
+  // rows and episodes written or waiting for the next chunk
+  size_t get_num_rows() const;
+  size_t get_num_episodes() const;
+  // chunks written by the writer thread
+  size_t get_num_chunks() const;
+  size_t get_bytes_written() const;
+  std::string to_string() const;
+
+ protected:
+  struct Columns {
+    std::vector<std::vector<char>> data;
+    size_t rows = 0;
+  };
+  // the open episode of a stream. append only locks mutex, and close
+  // sets closed under it so no row is appended after the last chunk.
+  struct Stream {
+    std::mutex mutex;
+    bool closed = false;
+    Columns cols;
+  };
+  struct QueuedChunk {
+    uint64_t row_begin;
+    Columns cols;
+  };
+  struct Chunk {
+    uint64_t row_begin;
+    uint64_t num_rows;
+    // per column: file offset, bytes stored and bytes inflated
+    std::vector<uint64_t> offset;
+    std::vector<uint64_t> stored;
+    std::vector<uint64_t> raw;
+  };
+  struct Episode {
+    uint64_t row_begin;
+    uint64_t num_rows;
+    uint64_t chunk;
+    uint64_t stream;
+  };
+
+  // callers hold mutex_
+  void check_open_locked() const;
+  void end_episode_locked(size_t stream);
+  void queue_pending_locked(std::unique_lock<std::mutex> &lock);
+  void wait_written_locked(std::unique_lock<std::mutex> &lock);
+
+  // out_ and bytes_written_ are only touched by the writer thread until
+  // close has joined it
+  void writer_loop();
+  Chunk write_chunk(QueuedChunk &queued);
+  void write(const void *data, size_t size);
+  void pad();
+
+  std::string path_;
+  size_t chunk_rows_;
+  int compression_level_;
+  std::ofstream out_;
+  std::atomic<uint64_t> bytes_written_ {0};
+  std::atomic<bool> closed_ {false};
+  // serializes close
+  std::mutex close_mutex_;
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Stream>> streams_;
+  Columns pending_;
+  // rows and chunks handed to the writer thread
+  uint64_t rows_queued_ = 0;
+  uint64_t chunks_queued_ = 0;
+  std::vector<Chunk> chunks_;
+  std::vector<Episode> episodes_;
+
+  std::deque<QueuedChunk> queue_;
+  // a chunk taken from queue_ that is not written yet
+  bool writing_ = false;
+  bool stop_writer_ = false;
+  std::exception_ptr error_;
+  // signals the writer of new chunks or stop_writer_
+  std::condition_variable queued_cv_;
+  // signals waiters in end_episode and flush of written chunks
+  std::condition_variable written_cv_;
+  std::thread writer_;
+  const size_t max_queued_chunks_ = 4;
+};
+
+// Attachment of an env to one stream of a TrajectoryRecorder. Copies are
+// detached so that two envs never append to the same stream.
+struct RecorderLink {
+  std::shared_ptr<TrajectoryRecorder> recorder;
+  size_t stream = 0;
+
+  RecorderLink() {}
+  RecorderLink(const RecorderLink &) {}
+  RecorderLink(RecorderLink &&) noexcept = default;
+  RecorderLink &operator=(const RecorderLink &) {return *this;}
+  RecorderLink &operator=(RecorderLink &&) noexcept = default;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_TRAJECTORYRECORDER_H_
@@ -14,7 +14,7 @@ class Uhat {
   Uhat(const Point &goal, double dt, const FwAvailActions &avail_actions) :
     goal_(goal), dt_(dt), avail_actions_(avail_actions) {}
 
-  FwSingleAction calc(const FwSingleState &x0);
+  FwSingleAction calc(const FwSingleState &x0) const;
 
   const Point &set_goal(const fw_coll_env::Point &goal) {goal_ = goal;}
   const Point &get_goal() const {return goal_;}
@@ -0,0 +1,92 @@
+#ifndef INCLUDE_FW_COLL_ENV_UNIFORMGRID_H_
+#define INCLUDE_FW_COLL_ENV_UNIFORMGRID_H_
+
+#include <fw-coll-env/Utils.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace fw_coll_env {
+
+// Broad phase over aircraft positions: a hashed grid of square cells in
+// the horizontal plane, with cell_size the interaction radius (safety_dist
+// or the cull distance). Points are sorted by cell so each occupied cell
+// is a contiguous range, and only occupied cells are stored, so memory and
+// build time do not depend on how far apart the points are. Distances are
+// 3d, and since the 3d distance is at least the horizontal one only cells
+// within ceil(radius / cell size) of a point can hold points within radius.
+//
+// Nearest queries and pair queries with a radius well beyond cell_size
+// use a second, coarser level whose cells merge 2^k x 2^k cells, with the
+// smallest k that puts about two points in each occupied coarse cell.
+class UniformGrid {
+ public:
+  explicit UniformGrid(double cell_size);
+
+  // points with active false are left out of the grid
+  void build(const std::vector<Point> &points, const std::vector<bool> &active);
+
+  // appends the pairs (i, j), i < j, of points within radius
+  void pairs_within(double radius, std::vector<std::pair<int, int>> &out) const;
+
+  // nearest other point of grid point i (-1 when there is none). Rings of
+  // coarse cells are searched outwards until no unsearched cell can be
+  // closer and the search falls back to all points once the searched
+  // block of cells outnumbers them.
+  int nearest(size_t i, double &dist) const;
+
+  double get_cell_size() const {return fine_.size;}
+  double get_coarse_cell_size() const {return coarse_.size;}
+  size_t num_points() const {return fine_.order.size();}
+  size_t num_cells() const {return fine_.cells.size();}
+
+ protected:
+  using Cell = std::pair<int32_t, int32_t>;
+
+  // the points bucketed by cells of size cell_size * 2^shift
+  struct Level {
+    int shift = 0;
+    double size = 0;
+    // grid point indices sorted by cell
+    std::vector<uint32_t> order;
+    // cell key to its [begin, end) range of order
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> cells;
+    // extent of the occupied cells
+    Cell min_cell;
+    Cell max_cell;
+
+    Cell cell_of(const Cell &fine) const {
+      return {fine.first >> shift, fine.second >> shift};
+    }
+  };
+
+  static uint64_t key(int32_t ix, int32_t iy) {
+    return (static_cast<uint64_t>(static_cast<uint32_t>(ix)) << 32) |
+           static_cast<uint32_t>(iy);
+  }
+  void bucket(Level &level, int shift);
+  // calls fn(j) for the points in cell (ix, iy) of level
+  template <typename F>
+  static void for_cell(const Level &level, int32_t ix, int32_t iy, F fn) {
+    const auto it = level.cells.find(key(ix, iy));
+    if (it == level.cells.end()) {
+      return;
+    }
+    for (uint32_t k = it->second.first; k < it->second.second; k++) {
+      fn(level.order[k]);
+    }
+  }
+  double dist(size_t i, size_t j) const {return points_[i].dist(points_[j]);}
+
+  std::vector<Point> points_;
+  std::vector<bool> active_;
+  // cell of every active point at the fine level
+  std::vector<Cell> point_cells_;
+  Level fine_;
+  Level coarse_;
+};
+
+} // namespace fw_coll_env
+#endif // INCLUDE_FW_COLL_ENV_UNIFORMGRID_H_
@@ -10,75 +10,112 @@
 
 namespace fw_coll_env {
 
-struct Point {
-  Point() : x(std::numeric_limits<double>::quiet_NaN()),
-            y(std::numeric_limits<double>::quiet_NaN()),
-            z(std::numeric_limits<double>::quiet_NaN()) {}
-  Point(double _x, double _y, double _z) : x(_x), y(_y), z(_z) {}
-
-  double x;
-  double y;
-  double z;
-
-  bool operator==(const Point &p) const;
-  double dist(const Point &p) const;
+// The state and action types are templated on the scalar type so the
+// barrier rollouts can also run in float32 (see calc_h_f32). Member
+// definitions live in Utils.cpp, which instantiates float and double.
+template <typename T>
+struct PointT {
+  PointT() : x(std::numeric_limits<T>::quiet_NaN()),
+             y(std::numeric_limits<T>::quiet_NaN()),
+             z(std::numeric_limits<T>::quiet_NaN()) {}
+  PointT(T _x, T _y, T _z) : x(_x), y(_y), z(_z) {}
+  template <typename U>
+  explicit PointT(const PointT<U> &p) : x(p.x), y(p.y), z(p.z) {}
+
+  T x;
+  T y;
+  T z;
+
+  bool operator==(const PointT &p) const;
+  T dist(const PointT &p) const;
   std::string to_string() const;
 };
 
-struct FwSingleState {
-  FwSingleState() : th(std::numeric_limits<double>::quiet_NaN()) {}
-  FwSingleState(const Point &_p, double _th) : p(_p), th(_th) {}
-  Point p;
-  double th;
+template <typename T>
+struct FwSingleStateT {
+  FwSingleStateT() : th(std::numeric_limits<T>::quiet_NaN()) {}
+  FwSingleStateT(const PointT<T> &_p, T _th) : p(_p), th(_th) {}
+  template <typename U>
+  explicit FwSingleStateT(const FwSingleStateT<U> &x) : p(x.p), th(x.th) {}
+  PointT<T> p;
+  T th;
 
-  bool operator==(const FwSingleState &_x) const;
+  bool operator==(const FwSingleStateT &_x) const;
   std::string to_string() const;
 };
 
-struct FwState {
-  FwState() {}
-  FwState(const FwSingleState &_x1, const FwSingleState &_x2) :
+template <typename T>
+struct FwStateT {
+  FwStateT() {}
+  FwStateT(const FwSingleStateT<T> &_x1, const FwSingleStateT<T> &_x2) :
     x1(_x1), x2(_x2) {}
+  template <typename U>
+  explicit FwStateT(const FwStateT<U> &x) : x1(x.x1), x2(x.x2) {}
 
-  pybind11::array_t<double> asarray() const;
+  pybind11::array_t<T> asarray() const;
 
-  FwSingleState x1;
-  FwSingleState x2;
+  FwSingleStateT<T> x1;
+  FwSingleStateT<T> x2;
 
+  bool operator==(const FwStateT &_x) const;
   std::string to_string() const;
 };
 
-struct FwSingleAction {
+template <typename T>
+struct FwSingleActionT {
   // this is basically the same thing as Point
   // but with different names to the members.
   // An initial implementation using only a 3 entry vector
   // led to bugs where the wrong members were called
   // so this is more explicit
-  FwSingleAction() : v(std::numeric_limits<double>::quiet_NaN()),
-                     w(std::numeric_limits<double>::quiet_NaN()),
-                     dz(std::numeric_limits<double>::quiet_NaN()) {}
-  FwSingleAction(double _v, double _w, double _dz) : v(_v), w(_w), dz(_dz) {}
-  double v;
-  double w;
-  double dz;
-
-  bool operator==(const FwSingleAction &ac) const;
-  bool operator<(const FwSingleAction &ac) const;
-  double dist(const FwSingleAction &ac) const;
-  double dist_sq(const FwSingleAction &ac) const;
+  FwSingleActionT() : v(std::numeric_limits<T>::quiet_NaN()),
+                      w(std::numeric_limits<T>::quiet_NaN()),
+                      dz(std::numeric_limits<T>::quiet_NaN()) {}
+  FwSingleActionT(T _v, T _w, T _dz) : v(_v), w(_w), dz(_dz) {}
+  template <typename U>
+  explicit FwSingleActionT(const FwSingleActionT<U> &ac) : v(ac.v), w(ac.w), dz(ac.dz) {}
+  T v;
+  T w;
+  T dz;
+
+  bool operator==(const FwSingleActionT &ac) const;
+  bool operator<(const FwSingleActionT &ac) const;
+  T dist(const FwSingleActionT &ac) const;
+  T dist_sq(const FwSingleActionT &ac) const;
   std::string to_string() const;
 };
 
-struct FwAction {
-  FwAction(const FwSingleAction &_a1, const FwSingleAction &_a2) : a1(_a1), a2(_a2) {}
-  FwSingleAction a1;
-  FwSingleAction a2;
-
-  bool operator==(const FwAction &ac) const;
-  double dist(const FwAction &ac) const;
+template <typename T>
+struct FwActionT {
+  FwActionT(const FwSingleActionT<T> &_a1, const FwSingleActionT<T> &_a2) :
+    a1(_a1), a2(_a2) {}
+  template <typename U>
+  explicit FwActionT(const FwActionT<U> &ac) : a1(ac.a1), a2(ac.a2) {}
+  FwSingleActionT<T> a1;
+  FwSingleActionT<T> a2;
+
+  bool operator==(const FwActionT &ac) const;
+  T dist(const FwActionT &ac) const;
   std::string to_string() const;
 };
 
+extern template struct PointT<float>;
+extern template struct PointT<double>;
+extern template struct FwSingleStateT<float>;
+extern template struct FwSingleStateT<double>;
+extern template struct FwStateT<float>;
+extern template struct FwStateT<double>;
+extern template struct FwSingleActionT<float>;
+extern template struct FwSingleActionT<double>;
+extern template struct FwActionT<float>;
+extern template struct FwActionT<double>;
+
+using Point = PointT<double>;
+using FwSingleState = FwSingleStateT<double>;
+using FwState = FwStateT<double>;
+using FwSingleAction = FwSingleActionT<double>;
+using FwAction = FwActionT<double>;
+
 class Rho {
  public:
   Rho() : safety_dist_(std::numeric_limits<double>::quiet_NaN()),
@@ -97,7 +134,11 @@ class Rho {
   double max_val_;
 };
 
-void fw_dynamics(double dt, const FwSingleAction &a, FwSingleState &x);
+template <typename T>
+void fw_dynamics(T dt, const FwSingleActionT<T> &a, FwSingleStateT<T> &x);
+extern template void fw_dynamics(float, const FwSingleActionT<float> &, FwSingleStateT<float> &);
+extern template void fw_dynamics(
+    double, const FwSingleActionT<double> &, FwSingleStateT<double> &);
 std::string bool2str(bool val);
 double deg2rad(double val);
 double rad2deg(double val);
@@ -0,0 +1,93 @@
+"""Compares the float32 barrier kernels against the double path.
+
+For random encounters in a box it reports the error of h, how often
+choose_u_f32 picks a different action than choose_u and, for those rows,
+whether the float32 choice still satisfies the double barrier constraint.
+"""
+import argparse
+import time
+
+import numpy as np
+import fw_coll_env_c
+
+
+def make_barriers(avail, args):
+    kwargs = dict(dt=args.dt, max_val=args.max_val, v=args.v,
+                  safety_dist=args.safety_dist, avail_actions=avail)
+    return {
+        'turn': fw_coll_env_c.BarrierGammaTurn(
+            w_deg_per_sec=args.w, **kwargs),
+        'straight': fw_coll_env_c.BarrierGammaStraight(**kwargs),
+        'composite': fw_coll_env_c.BarrierComposite(
+            w_deg_per_sec=[-args.w, args.w], straight=True, **kwargs),
+    }
+
+
+def bf_constraint(barrier, index, x, idx):
+    state = fw_coll_env_c.FwState.from_numpy(x)
+    h = barrier.calc_h(state)
+    return barrier.calc_dh(state, index.idx_to_action(int(idx))) + \
+        barrier.lmbda * h
+
+
+def timed(f, *args):
+    start = time.perf_counter()
+    out = f(*args)
+    return out, time.perf_counter() - start
+
+
+def report(name, barrier, index, x, uhat_idx):
+    h, _ = barrier.calc_h_grad(x)
+    x32 = x.astype(np.float32)
+    h32 = barrier.calc_h_f32(x32)
+    err = np.abs(h32 - h)
+
+    out, t64 = timed(barrier.choose_u, x, uhat_idx)
+    out32, t32 = timed(barrier.choose_u_f32, x32, uhat_idx)
+    differ = np.flatnonzero(out32 != out)
+    # a different choice is harmless when it is also safe in double, or
+    # when the double path found no safe action either
+    unsafe = sum(
+        bf_constraint(barrier, index, x[i], out32[i]) < 0 <=
+        bf_constraint(barrier, index, x[i], out[i])
+        for i in differ)
+
+    print(f'{name}:')
+    print(f'  h abs error      max {err.max():.3e}  '
+          f'p99 {np.percentile(err, 99):.3e}  mean {err.mean():.3e}')
+    print(f'  h sign flips     {np.sum((h32 >= 0) != (h >= 0))}')
+    print(f'  overridden       {np.sum(out != uhat_idx)} of {len(x)}')
+    print(f'  actions differ   {len(differ)}  unsafe in double {unsafe}')
+    print(f'  choose_u time    double {t64:.3f} s  float32 {t32:.3f} s')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('--num', type=int, default=10000)
+    parser.add_argument('--box', type=float, default=300,
+                        help='positions are uniform in [-box, box]')
+    parser.add_argument('--seed', type=int, default=0)
+    parser.add_argument('--dt', type=float, default=0.1)
+    parser.add_argument('--v', type=float, default=15)
+    parser.add_argument('--w', type=float, default=12)
+    parser.add_argument('--max_val', type=float, default=300)
+    parser.add_argument('--safety_dist', type=float, default=5)
+    args = parser.parse_args()
+
+    avail = fw_coll_env_c.FwAvailActions(
+        v=[15, 20, 25], w=[-args.w, 0, args.w], dz=[0])
+    index = fw_coll_env_c.FwActionIndex(avail)
+
+    rng = np.random.default_rng(args.seed)
+    x = np.zeros((args.num, 8))
+    x[:, [0, 1, 4, 5]] = rng.uniform(-args.box, args.box, (args.num, 4))
+    x[:, [2, 6]] = rng.uniform(-np.pi, np.pi, (args.num, 2))
+    num_joint = len(avail.get_all_actions()) ** 2
+    uhat_idx = rng.integers(num_joint, size=args.num).astype(np.int32)
+
+    for name, barrier in make_barriers(avail, args).items():
+        report(name, barrier, index, x, uhat_idx)
+
+
+if __name__ == '__main__':
+    main()
@@ -12,8 +12,19 @@ ext_modules = [
         ["src/main.cpp", "src/Utils.cpp", "src/FwAvailActions.cpp",
          "src/Uhat.cpp", "src/FwCollisionEnv.cpp",
          "src/BarrierGammaTurn.cpp", "src/BarrierGammaStraight.cpp",
-         "src/FwActionIndex.cpp"],
+         "src/BarrierComposite.cpp",
+         "src/FwActionIndex.cpp", "src/ThreadPool.cpp",
+         "src/FwCollisionEnvBatch.cpp", "src/BarrierFilter.cpp",
+         "src/EncounterGenerator.cpp", "src/ReplayBuffer.cpp",
+         "src/StreamingRelabeler.cpp", "src/ActorPool.cpp",
+         "src/UniformGrid.cpp", "src/FwMultiCollisionEnv.cpp",
+         "src/MultiBarrierFilter.cpp", "src/MappedFile.cpp",
+         "src/TrajectoryRecorder.cpp", "src/TrajectoryReader.cpp",
+         "src/RealtimeSim.cpp", "src/Profiler.cpp", "src/MpcPlanner.cpp"],
         include_dirs=[Path(__file__).parent / 'include'],
+        extra_compile_args=['-pthread'],
+        extra_link_args=['-pthread'],
+        libraries=['z'],
         # Example: passing in the version to the compiled code
         define_macros=[('VERSION_INFO', __version__)],
         ),
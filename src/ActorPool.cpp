@@ -0,0 +1,382 @@
+#include <fw-coll-env/ActorPool.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cmath>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+namespace {
+
+void state_to_row(const FwSingleState &x1, const FwSingleState &x2, double *row) {
+  row[0] = x1.p.x;
+  row[1] = x1.p.y;
+  row[2] = x1.th;
+  row[3] = x1.p.z;
+  row[4] = x2.p.x;
+  row[5] = x2.p.y;
+  row[6] = x2.th;
+  row[7] = x2.p.z;
+}
+
+// mixes the actor into the seed so actor streams differ
+uint64_t actor_seed(uint64_t seed, size_t actor) {
+  return seed + 0x9E3779B97F4A7C15ULL * (actor + 1);
+}
+
+} // namespace
+
+int ActorPool::PolicyTable::lookup(const double *x) const {
+  // vehicle 2 relative to vehicle 1's position and heading
+  const double dx = x[4] - x[0];
+  const double dy = x[5] - x[1];
+  const double c = std::cos(x[2]);
+  const double s = std::sin(x[2]);
+  const double feat[3] = {
+    c * dx + s * dy, -s * dx + c * dy, std::remainder(x[6] - x[2], 2 * M_PI)};
+
+  size_t flat = 0;
+  for (size_t k = 0; k < 3; k++) {
+    const double u = (feat[k] - low[k]) / (high[k] - low[k]);
+    const auto bin = static_cast<size_t>(std::clamp(
+        std::floor(u * dims[k]), 0.0, static_cast<double>(dims[k] - 1)));
+    flat = flat * dims[k] + bin;
+  }
+  return actions[flat];
+}
+
+ActorPool::ActorPool(
+    const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+    const EncounterGenerator &generator, size_t num_actors, size_t envs_per_actor,
+    size_t queue_capacity, uint64_t seed) :
+      num_actors_(num_actors),
+      envs_per_actor_(envs_per_actor),
+      avail_actions_(avail_actions),
+      uhat2_(env.get_goal2(), env.get_dt(), avail_actions),
+      ring_(queue_capacity) {
+
+  if (num_actors_ == 0 || envs_per_actor_ == 0) {
+    throw std::runtime_error("ActorPool requires num_actors and envs_per_actor > 0");
+  }
+  if (env.get_time_warp() > 0) {
+    throw std::runtime_error("ActorPool does not support time_warp");
+  }
+
+  for (size_t a = 0; a < num_actors_; a++) {
+    actors_.push_back(
+        {std::vector<FwCollisionEnv>(envs_per_actor_, env),
+         std::vector<double>(envs_per_actor_, 1.0), generator,
+         std::mt19937_64(actor_seed(seed, a))});
+    Actor &actor = actors_.back();
+    actor.generator.seed(actor_seed(~seed, a));
+    for (auto &e : actor.envs) {
+      e.clear_shield();
+    }
+    for (size_t i = 0; i < envs_per_actor_; i++) {
+      reset_env(actor, i);
+    }
+  }
+
+  // the copies would share one barrier across threads
+  if (env.has_shield()) {
+    set_shield(*env.get_shield());
+  }
+}
+
+ActorPool::~ActorPool() {
+  // stop releases the GIL around the joins
+  if (is_running()) {
+    stop();
+  }
+}
+
+void ActorPool::check_stopped(const char *what) const {
+  if (is_running()) {
+    throw std::runtime_error(std::string(what) + " requires a stopped ActorPool");
+  }
+}
+
+void ActorPool::set_policy_random() {
+  check_stopped("set_policy_random");
+  policy_kind_ = PolicyKind::random;
+}
+
+void ActorPool::set_policy_callback(uintptr_t fn, uintptr_t user_data) {
+  check_stopped("set_policy_callback");
+  if (fn == 0) {
+    throw std::runtime_error("policy callback must not be null");
+  }
+  policy_fn_ = reinterpret_cast<PolicyFn>(fn);
+  policy_user_data_ = reinterpret_cast<void *>(user_data);
+  policy_kind_ = PolicyKind::callback;
+}
+
+void ActorPool::set_policy_table(
+    pybind11::array_t<int> table, pybind11::array_t<double> lims) {
+  if (is_running() && policy_kind_ != PolicyKind::table) {
+    throw std::runtime_error(
+        "switching to a table policy requires a stopped ActorPool");
+  }
+  if (table.ndim() != 3 || table.size() == 0) {
+    throw std::runtime_error("policy table must be a non-empty (nx, ny, nth) array");
+  }
+  if (lims.ndim() != 2 || lims.shape(0) != 2 || lims.shape(1) != 3) {
+    throw std::runtime_error("invalid shape given for policy table lims");
+  }
+
+  auto new_table = std::make_shared<PolicyTable>();
+  auto _lims = lims.unchecked<2>();
+  for (size_t k = 0; k < 3; k++) {
+    new_table->dims[k] = table.shape(k);
+    new_table->low[k] = _lims(0, k);
+    new_table->high[k] = _lims(1, k);
+    if (!(new_table->high[k] > new_table->low[k])) {
+      throw std::runtime_error("policy table lims require low < high");
+    }
+  }
+
+  const int num_actions = avail_actions_.get_all_actions().size();
+  auto _table = table.unchecked<3>();
+  new_table->actions.reserve(table.size());
+  for (pybind11::ssize_t i = 0; i < table.shape(0); i++) {
+    for (pybind11::ssize_t j = 0; j < table.shape(1); j++) {
+      for (pybind11::ssize_t k = 0; k < table.shape(2); k++) {
+        if (_table(i, j, k) < 0 || _table(i, j, k) >= num_actions) {
+          throw std::runtime_error("idx too large for all_actions");
+        }
+        new_table->actions.push_back(_table(i, j, k));
+      }
+    }
+  }
+
+  // only the pointer swap is seen by running actors
+  std::atomic_store(&table_, std::shared_ptr<const PolicyTable>(std::move(new_table)));
+  table_version_++;
+  policy_kind_ = PolicyKind::table;
+}
+
+void ActorPool::set_shield(const BarrierGammaTurn &barrier) {
+  check_stopped("set_shield");
+  if (!(barrier.get_avail_actions().get_all_actions() == avail_actions_.get_all_actions())) {
+    throw std::runtime_error("shield avail_actions do not match those of ActorPool");
+  }
+  if (barrier.get_dt() != uhat2_.get_dt()) {
+    throw std::runtime_error("shield dt does not match that of ActorPool");
+  }
+
+  shield_ = barrier.clone();
+}
+
+void ActorPool::clear_shield() {
+  check_stopped("clear_shield");
+  shield_.reset();
+}
+
+void ActorPool::start() {
+  check_stopped("start");
+  if (policy_kind_ == PolicyKind::table && !std::atomic_load(&table_)) {
+    throw std::runtime_error("ActorPool table policy has no table");
+  }
+
+  error_ = nullptr;
+  stop_ = false;
+  for (size_t a = 0; a < num_actors_; a++) {
+    threads_.emplace_back([this, a]() {actor_loop(a);});
+  }
+}
+
+void ActorPool::stop() {
+  stop_ = true;
+  {
+    // a callback policy may need the GIL to finish its step
+    pybind11::gil_scoped_release release;
+    for (auto &t : threads_) {
+      t.join();
+    }
+  }
+  threads_.clear();
+}
+
+void ActorPool::fail(std::exception_ptr error) {
+  std::lock_guard<std::mutex> lock(error_mtx_);
+  if (!error_) {
+    error_ = error;
+  }
+  stop_ = true;
+}
+
+void ActorPool::reset_env(Actor &actor, size_t i) {
+  double row[8];
+  actor.weights[i] = actor.generator.sample_row(row);
+  actor.envs[i].reset(
+      FwSingleState(Point(row[0], row[1], row[3]), row[2]),
+      FwSingleState(Point(row[4], row[5], row[7]), row[6]), 0);
+}
+
+int ActorPool::policy_action(Actor &actor, const PolicyTable *table, const double *x) {
+  const int num_actions = avail_actions_.get_all_actions().size();
+  int idx = 0;
+  switch (policy_kind_.load(std::memory_order_relaxed)) {
+    case PolicyKind::random:
+      idx = std::uniform_int_distribution<int>(0, num_actions - 1)(actor.rng);
+      break;
+    case PolicyKind::callback:
+      idx = policy_fn_(x, policy_user_data_);
+      break;
+    case PolicyKind::table:
+      idx = table->lookup(x);
+      break;
+  }
+  if (idx < 0 || idx >= num_actions) {
+    throw std::runtime_error("policy returned an idx too large for all_actions");
+  }
+  return idx;
+}
+
+void ActorPool::actor_loop(size_t a) {
+  try {
+    Actor &actor = actors_[a];
+    const BarrierGammaTurn *shield = shield_.get();
+    const auto &all_actions = avail_actions_.get_all_actions();
+    const int num_actions = all_actions.size();
+
+    while (!stop_.load(std::memory_order_relaxed)) {
+      const std::shared_ptr<const PolicyTable> table = std::atomic_load(&table_);
+
+      for (size_t i = 0; i < envs_per_actor_ && !stop_.load(std::memory_order_relaxed); i++) {
+        FwCollisionEnv &env = actor.envs[i];
+        Transition tr;
+        state_to_row(env.get_x1(), env.get_x2(), tr.x);
+
+        const int a1_idx = policy_action(actor, table.get(), tr.x);
+        const FwSingleAction a2 = uhat2_.calc(env.get_x2());
+        const FwAction ac {all_actions[a1_idx], a2};
+        FwAction safe_ac = ac;
+        if (shield) {
+          safe_ac = shield->filter_action(FwState{env.get_x1(), env.get_x2()}, ac);
+        }
+
+        tr.action_idx = a1_idx * num_actions + avail_actions_.action_to_idx(a2);
+        tr.executed_idx =
+          avail_actions_.action_to_idx(safe_ac.a1) * num_actions +
+          avail_actions_.action_to_idx(safe_ac.a2);
+        tr.overridden = tr.executed_idx != tr.action_idx;
+        tr.done = env.step(safe_ac.a1, safe_ac.a2);
+        tr.collided = env.get_collided();
+        tr.env = a * envs_per_actor_ + i;
+        tr.weight = actor.weights[i];
+        tr.t = env.get_t();
+        state_to_row(env.get_x1(), env.get_x2(), tr.x_next);
+
+        // back off to sleeping when the learner falls behind
+        for (size_t spins = 0; !ring_.try_push(tr); spins++) {
+          if (spins == 0) {
+            num_full_waits_.fetch_add(1, std::memory_order_relaxed);
+          }
+          if (stop_.load(std::memory_order_relaxed)) {
+            return;
+          }
+          if (spins < max_full_spins_) {
+            std::this_thread::yield();
+          } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+          }
+        }
+        num_steps_.fetch_add(1, std::memory_order_relaxed);
+
+        if (tr.done || tr.collided) {
+          reset_env(actor, i);
+          num_episodes_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    }
+  } catch (...) {
+    fail(std::current_exception());
+  }
+}
+
+pybind11::dict ActorPool::drain(size_t max_items) {
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(error_mtx_);
+    std::swap(error, error_);
+  }
+  // stopping under error_mtx_ would deadlock with an actor in fail()
+  if (error) {
+    stop();
+    std::rethrow_exception(error);
+  }
+
+  std::vector<Transition> items;
+  items.reserve(std::min(max_items, ring_.capacity()));
+  Transition tr;
+  while (items.size() < max_items && ring_.try_pop(tr)) {
+    items.push_back(tr);
+  }
+
+  const auto n = static_cast<pybind11::ssize_t>(items.size());
+  pybind11::array_t<double> x {{n, pybind11::ssize_t(8)}};
+  pybind11::array_t<double> x_next {{n, pybind11::ssize_t(8)}};
+  pybind11::array_t<int> action_idx {n};
+  pybind11::array_t<int> executed_idx {n};
+  pybind11::array_t<bool> overridden {n};
+  pybind11::array_t<bool> done {n};
+  pybind11::array_t<bool> collided {n};
+  pybind11::array_t<int64_t> env {n};
+  pybind11::array_t<double> weight {n};
+  pybind11::array_t<double> t {n};
+
+  auto _x = x.mutable_unchecked<2>();
+  auto _x_next = x_next.mutable_unchecked<2>();
+  auto _action_idx = action_idx.mutable_unchecked<1>();
+  auto _executed_idx = executed_idx.mutable_unchecked<1>();
+  auto _overridden = overridden.mutable_unchecked<1>();
+  auto _done = done.mutable_unchecked<1>();
+  auto _collided = collided.mutable_unchecked<1>();
+  auto _env = env.mutable_unchecked<1>();
+  auto _weight = weight.mutable_unchecked<1>();
+  auto _t = t.mutable_unchecked<1>();
+
+  for (pybind11::ssize_t i = 0; i < n; i++) {
+    const Transition &item = items[i];
+    for (pybind11::ssize_t j = 0; j < 8; j++) {
+      _x(i, j) = item.x[j];
+      _x_next(i, j) = item.x_next[j];
+    }
+    _action_idx(i) = item.action_idx;
+    _executed_idx(i) = item.executed_idx;
+    _overridden(i) = item.overridden;
+    _done(i) = item.done;
+    _collided(i) = item.collided;
+    _env(i) = item.env;
+    _weight(i) = item.weight;
+    _t(i) = item.t;
+  }
+
+  pybind11::dict out;
+  out["x"] = x;
+  out["x_next"] = x_next;
+  out["action_idx"] = action_idx;
+  out["executed_idx"] = executed_idx;
+  out["overridden"] = overridden;
+  out["done"] = done;
+  out["collided"] = collided;
+  out["env"] = env;
+  out["weight"] = weight;
+  out["t"] = t;
+  return out;
+}
+
+std::string ActorPool::to_string() const {
+  const PolicyKind kind = policy_kind_;
+  const char *policy =
+    kind == PolicyKind::random ? "random" :
+    kind == PolicyKind::callback ? "callback" : "table";
+  return std::string("ActorPool(num_actors=") + std::to_string(num_actors_) +
+    ",envs_per_actor=" + std::to_string(envs_per_actor_) +
+    ",queue_capacity=" + std::to_string(ring_.capacity()) +
+    ",policy=" + policy +
+    ",shield=" + bool2str(has_shield()) + ")";
+}
+} // namespace fw_coll_env
@@ -0,0 +1,256 @@
+#include <fw-coll-env/BarrierComposite.h>
+#include <fw-coll-env/BarrierGammaStraight.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+BarrierComposite::BarrierComposite(
+      double dt, double max_val, double v, const std::vector<double> &w_deg_per_sec,
+      bool straight, double safety_dist, const FwAvailActions &avail_actions) :
+        BarrierGammaTurn(
+            dt, max_val, v,
+            w_deg_per_sec.empty() ? avail_actions.get_w_deg_per_sec()[0] : w_deg_per_sec[0],
+            safety_dist, avail_actions),
+        w_deg_per_sec_(w_deg_per_sec),
+        straight_(straight) {
+
+  for (double w_deg : w_deg_per_sec_) {
+    const double w = deg2rad(w_deg);
+    if (w == 0) {
+      throw std::runtime_error(
+          "BarrierComposite turn rates must be nonzero, use straight instead");
+    }
+    maneuvers_.push_back(
+        {w, std::cos(w * dt_), std::sin(w * dt_),
+         static_cast<size_t>(to_int(2 * M_PI / std::abs(w) / dt_)), false});
+  }
+  if (straight_) {
+    // the same rollout length as BarrierGammaStraight
+    maneuvers_.push_back(
+        {0, 1, 0, static_cast<size_t>(straight_rollout_time / dt_), true});
+  }
+  if (maneuvers_.empty()) {
+    throw std::runtime_error("BarrierComposite requires at least one maneuver");
+  }
+
+  BarrierComposite::check_params(get_params());
+}
+
+void BarrierComposite::check_params(const BarrierParams &p) const {
+  to_int(1 / dt_);
+
+  // make sure every evasive action is in avail actions
+  // so throw exception on action_to_idx if this is not the case.
+  for (double w_deg : w_deg_per_sec_) {
+    to_int(360 / std::abs(w_deg));
+    avail_actions_.action_to_idx(FwSingleAction(p.v, deg2rad(w_deg), 0));
+  }
+  if (straight_) {
+    avail_actions_.action_to_idx(FwSingleAction(p.v, 0, 0));
+  }
+}
+
+BarrierParams BarrierComposite::hetero_params(
+    double max_val, double v, double /*w_rad_per_sec*/, double safety_dist,
+    double lmbda) const {
+  // the maneuvers keep their own turn rates
+  return {max_val, v, w_rad_per_sec_, safety_dist, lmbda};
+}
+
+std::vector<double> BarrierComposite::maneuver_dists(
+    const FwState &x0, const BarrierParams &p, PruneCounts &counts,
+    std::vector<FwState> *x_closest) const {
+  const size_t m = maneuvers_.size();
+  const double d0 = x0.x1.p.dist(x0.x2.p);
+  std::vector<double> closest(m, d0);
+  if (x_closest) {
+    x_closest->assign(m, x0);
+  }
+
+  size_t max_steps = 0;
+  for (const auto &man : maneuvers_) {
+    max_steps = std::max(max_steps, man.num_steps);
+  }
+  if (steps_out_of_reach(p, d0, d0, max_steps) >= max_steps) {
+    counts.skipped_steps += max_steps * m;
+    return closest;
+  }
+
+  // every maneuver starts from the same headings
+  const double c1 = std::cos(x0.x1.th);
+  const double s1 = std::sin(x0.x1.th);
+  const double c2 = std::cos(x0.x2.th);
+  const double s2 = std::sin(x0.x2.th);
+  const double dz = x0.x1.p.z - x0.x2.p.z;
+
+  struct Rollout {
+    double x1, y1, c1, s1;
+    double x2, y2, c2, s2;
+    bool active;
+  };
+  std::vector<Rollout> rollouts(
+      m, {x0.x1.p.x, x0.x1.p.y, c1, s1, x0.x2.p.x, x0.x2.p.y, c2, s2, true});
+
+  size_t num_active = m;
+  for (size_t i = 0; num_active > 0; i++) {
+    for (size_t k = 0; k < m; k++) {
+      Rollout &r = rollouts[k];
+      if (!r.active) {
+        continue;
+      }
+      const Maneuver &man = maneuvers_[k];
+
+      r.x1 += p.v * r.c1 * dt_;
+      r.y1 += p.v * r.s1 * dt_;
+      r.x2 += p.v * r.c2 * dt_;
+      r.y2 += p.v * r.s2 * dt_;
+      if (!man.straight) {
+        const double c1_next = r.c1 * man.cos_step - r.s1 * man.sin_step;
+        r.s1 = r.s1 * man.cos_step + r.c1 * man.sin_step;
+        r.c1 = c1_next;
+        const double c2_next = r.c2 * man.cos_step - r.s2 * man.sin_step;
+        r.s2 = r.s2 * man.cos_step + r.c2 * man.sin_step;
+        r.c2 = c2_next;
+      }
+
+      const double ddx = r.x1 - r.x2;
+      const double ddy = r.y1 - r.y2;
+      const double dist = std::sqrt(ddx * ddx + ddy * ddy + dz * dz);
+
+      const size_t steps_left = man.num_steps - i - 1;
+      bool done = steps_left == 0;
+      if (man.straight && dist >= closest[k]) {
+        // a straight trajectory has passed its closest point
+        done = true;
+      } else {
+        if (dist < closest[k]) {
+          closest[k] = dist;
+          if (x_closest) {
+            const double th_step = man.w_rad_per_sec * dt_ * (i + 1);
+            FwState &xc = (*x_closest)[k];
+            xc.x1 = FwSingleState(Point(r.x1, r.y1, x0.x1.p.z), x0.x1.th + th_step);
+            xc.x2 = FwSingleState(Point(r.x2, r.y2, x0.x2.p.z), x0.x2.th + th_step);
+          }
+        }
+        if (!done && steps_out_of_reach(p, dist, closest[k], steps_left) >= steps_left) {
+          counts.skipped_steps += steps_left;
+          done = true;
+        }
+      }
+
+      if (done) {
+        r.active = false;
+        num_active--;
+      }
+    }
+  }
+
+  return closest;
+}
+
+double BarrierComposite::closest_future_dist(
+    const FwState &x, const BarrierParams &p, PruneCounts &counts) const {
+  const std::vector<double> closest = maneuver_dists(x, p, counts);
+  return *std::max_element(closest.begin(), closest.end());
+}
+
+float BarrierComposite::closest_future_dist(
+    const FwStateT<float> &x, const BarrierParams &p, PruneCounts &counts) const {
+  // a state is safe when any maneuver is
+  float dist = -std::numeric_limits<float>::infinity();
+  for (const auto &man : maneuvers_) {
+    const EvasiveManeuver evasive {man.w_rad_per_sec, man.num_steps, man.straight};
+    dist = std::max(dist, maneuver_dist(x, p, evasive, counts));
+  }
+  return dist;
+}
+
+double BarrierComposite::closest_future_state(
+    const FwState &x0, const BarrierParams &p, FwState &x_closest,
+    PruneCounts &counts) const {
+  std::vector<FwState> states;
+  const std::vector<double> closest = maneuver_dists(x0, p, counts, &states);
+  const size_t k = std::max_element(closest.begin(), closest.end()) - closest.begin();
+  x_closest = states[k];
+  return closest[k];
+}
+
+double BarrierComposite::rollout_horizon() const {
+  size_t max_steps = 0;
+  for (const auto &man : maneuvers_) {
+    max_steps = std::max(max_steps, man.num_steps);
+  }
+  return max_steps * dt_;
+}
+
+std::vector<double> BarrierComposite::calc_h_maneuvers(const FwState &x0) const {
+  PruneCounts counts;
+  const std::vector<double> h = calc_h_maneuvers(x0, get_params(), counts);
+  add_counts(counts);
+  return h;
+}
+
+std::vector<double> BarrierComposite::calc_h_maneuvers(
+    const FwState &x0, const BarrierParams &p, PruneCounts &counts) const {
+  std::vector<double> h = maneuver_dists(x0, p, counts);
+  for (double &val : h) {
+    val = p.h(val);
+  }
+  return h;
+}
+
+std::pair<pybind11::array_t<double>, pybind11::array_t<double>>
+BarrierComposite::calc_h_batch(pybind11::array_t<double> x) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to calc_h_batch");
+  }
+
+  const auto num_rows = x.shape(0);
+  const auto m = static_cast<pybind11::ssize_t>(maneuvers_.size());
+  pybind11::array_t<double> h_maneuvers {{num_rows, m}};
+  pybind11::array_t<double> h {num_rows};
+
+  auto _x = x.unchecked<2>();
+  auto _h_maneuvers = h_maneuvers.mutable_unchecked<2>();
+  auto _h = h.mutable_unchecked<1>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+
+    const std::vector<double> vals = calc_h_maneuvers(x_state, p, counts);
+    for (pybind11::ssize_t k = 0; k < m; k++) {
+      _h_maneuvers(i, k) = vals[k];
+    }
+    _h(i) = *std::max_element(vals.begin(), vals.end());
+  }
+
+  add_counts(counts);
+  return {h_maneuvers, h};
+}
+
+std::shared_ptr<BarrierGammaTurn> BarrierComposite::clone() const {
+  return std::make_shared<BarrierComposite>(*this);
+}
+
+std::string BarrierComposite::to_string() const {
+  std::string w_str;
+  for (size_t i = 0; i < w_deg_per_sec_.size(); i++) {
+    w_str += (i ? "," : "") + std::to_string(w_deg_per_sec_[i]);
+  }
+  return std::string("BarrierComposite(dt=") + std::to_string(dt_) +
+    ",max_val=" + std::to_string(max_val_) +
+    ",v=" + std::to_string(v_) +
+    ",w_deg_per_sec=[" + w_str + "]" +
+    ",straight=" + bool2str(straight_) +
+    ",safety_dist=" + std::to_string(safety_dist_) + ")";
+}
+} // namespace fw_coll_env
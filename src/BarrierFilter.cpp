@@ -0,0 +1,177 @@
+#include <fw-coll-env/BarrierFilter.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <typeinfo>
+
+namespace fw_coll_env {
+
+namespace {
+
+void push_dist(std::deque<std::pair<size_t, double>> &min_dists, size_t step, double dist) {
+  while (!min_dists.empty() && min_dists.back().second >= dist) {
+    min_dists.pop_back();
+  }
+  min_dists.emplace_back(step, dist);
+}
+
+} // namespace
+
+BarrierFilter::BarrierFilter(const BarrierGammaTurn &barrier, size_t num_envs) :
+    barrier_(barrier),
+    evasive_(barrier.get_v(), barrier.get_w_rad_per_sec(), 0),
+    n_(0),
+    windows_(num_envs) {
+  // the window only models the single turning orbit of BarrierGammaTurn,
+  // subclasses would be sliced to it
+  if (typeid(barrier) != typeid(BarrierGammaTurn) || barrier_.get_w_rad_per_sec() == 0) {
+    throw std::runtime_error("BarrierFilter requires a turning evasive maneuver");
+  }
+  n_ = barrier_.steps_per_revolution();
+}
+
+BarrierFilter::OrbitWindow &BarrierFilter::window(size_t env) {
+  if (env >= windows_.size()) {
+    throw std::runtime_error("env index out of range in BarrierFilter");
+  }
+  return windows_[env];
+}
+
+double BarrierFilter::calc_h(size_t env, const FwState &x0) {
+  OrbitWindow &w = window(env);
+  if (w.valid && x0 == w.next) {
+    cache_hits_++;
+    advance(w);
+    return window_h(w);
+  }
+
+  cache_misses_++;
+  const double d0 = x0.x1.p.dist(x0.x2.p);
+  if (barrier_.steps_out_of_reach(barrier_.get_params(), d0, d0, n_) >= n_) {
+    // h is saturated at max_val for the whole revolution, which is
+    // cheaper to recheck than to keep a window for
+    w.valid = false;
+    barrier_.add_counts({n_, 0});
+    return std::min(barrier_.get_max_val(), d0 - barrier_.get_safety_dist());
+  }
+
+  rollout(w, x0);
+  return window_h(w);
+}
+
+double BarrierFilter::window_h(const OrbitWindow &w) const {
+  return std::min(
+      barrier_.get_max_val(), w.min_dists.front().second - barrier_.get_safety_dist());
+}
+
+void BarrierFilter::rollout(OrbitWindow &w, const FwState &x0) {
+  w.min_dists.clear();
+  w.first = 0;
+
+  FwState x = x0;
+  push_dist(w.min_dists, 0, x.x1.p.dist(x.x2.p));
+  for (size_t i = 1; i <= n_; i++) {
+    fw_dynamics(barrier_.get_dt(), evasive_, x.x1);
+    fw_dynamics(barrier_.get_dt(), evasive_, x.x2);
+    if (i == 1) {
+      w.next = x;
+    }
+    push_dist(w.min_dists, i, x.x1.p.dist(x.x2.p));
+  }
+  w.last = x;
+  w.valid = true;
+}
+
+void BarrierFilter::advance(OrbitWindow &w) {
+  const double dt = barrier_.get_dt();
+
+  w.first++;
+  while (w.min_dists.front().first < w.first) {
+    w.min_dists.pop_front();
+  }
+
+  fw_dynamics(dt, evasive_, w.last.x1);
+  fw_dynamics(dt, evasive_, w.last.x2);
+  push_dist(w.min_dists, w.first + n_, w.last.x1.p.dist(w.last.x2.p));
+
+  // the same operations produced this state in the original rollout,
+  // so it matches bit for bit
+  fw_dynamics(dt, evasive_, w.next.x1);
+  fw_dynamics(dt, evasive_, w.next.x2);
+}
+
+FwAction BarrierFilter::evasive_action() const {
+  return {evasive_, evasive_};
+}
+
+pybind11::array_t<int> BarrierFilter::choose_u(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) {
+
+  int num_rows = x.shape(0);
+  if (x.shape(1) != 8 || uhat_idx.shape(0) != num_rows ||
+      static_cast<size_t>(num_rows) != windows_.size()) {
+    throw std::runtime_error("invalid shape given to BarrierFilter.choose_u");
+  }
+
+  pybind11::array_t<int> out {num_rows};
+
+  auto _x = x.unchecked<2>();
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  auto _out = out.mutable_unchecked<1>();
+
+  const FwAction evasive = evasive_action();
+  const BarrierParams p = barrier_.get_params();
+  PruneCounts counts;
+  for (int i = 0; i < num_rows; i++) {
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    FwAction uhat_ac = barrier_.action_index_.idx_to_action(_uhat_idx(i));
+
+    const double h = calc_h(i, x_state);
+    const OrbitWindow &w = windows_[i];
+
+    double uhat_bf_val;
+    if (w.valid && uhat_ac == evasive) {
+      // h after the evasive step is the window shifted by one step
+      double rest = std::numeric_limits<double>::infinity();
+      if (w.min_dists.front().first > w.first) {
+        rest = w.min_dists.front().second;
+      } else if (w.min_dists.size() > 1) {
+        rest = w.min_dists[1].second;
+      }
+      FwState x_last = w.last;
+      fw_dynamics(barrier_.get_dt(), evasive_, x_last.x1);
+      fw_dynamics(barrier_.get_dt(), evasive_, x_last.x2);
+      const double hnext = p.h(std::min(rest, x_last.x1.p.dist(x_last.x2.p)));
+      uhat_bf_val = p.bf_value(h, hnext);
+    } else {
+      uhat_bf_val = barrier_.bf_constraint(p, h, x_state, uhat_ac, counts);
+    }
+
+    FwAction safe_ac =
+      barrier_.choose_u_single(x_state, uhat_ac, h, uhat_bf_val, p, counts);
+    _out(i) = barrier_.action_index_.action_to_idx(safe_ac);
+  }
+
+  barrier_.add_counts(counts);
+  return out;
+}
+
+void BarrierFilter::reset(size_t env) {
+  window(env).valid = false;
+}
+
+void BarrierFilter::reset_all() {
+  for (auto &w : windows_) {
+    w.valid = false;
+  }
+}
+
+std::string BarrierFilter::to_string() const {
+  return std::string("BarrierFilter(barrier=") + barrier_.to_string() +
+    ",num_envs=" + std::to_string(windows_.size()) + ")";
+}
+} // namespace fw_coll_env
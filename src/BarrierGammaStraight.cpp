@@ -12,33 +12,29 @@ BarrierGammaStraight::BarrierGammaStraight(
             dt, max_val, v, avail_actions.get_w_deg_per_sec()[0],
             safety_dist, avail_actions) {
   w_rad_per_sec_ = 0;
+  BarrierGammaStraight::check_params(get_params());
+}
+
+void BarrierGammaStraight::check_params(const BarrierParams &p) const {
   // make sure v, 0, and 0 for dt are in avail actions
   // so throw exception on action_to_idx if this is not the case.
-  FwSingleAction ac {v_, 0, 0};
+  FwSingleAction ac {p.v, 0, 0};
   avail_actions_.action_to_idx(ac);
 }
 
-double BarrierGammaStraight::closest_future_dist(const FwState &x0) {
-
-  // integrate a maximum of num seconds (currently hardcoded to match env)
-  const int n = 30 / dt_;
-  FwState x = x0;
-  FwSingleAction ac {v_, 0, 0};
-  double closest_dist = x.x1.p.dist(x.x2.p);
-  for (int i = 0; i < n; i++) {
-      fw_dynamics(dt_, ac, x.x1);
-      fw_dynamics(dt_, ac, x.x2);
-
-      const double dist = x.x1.p.dist(x.x2.p);
-      if (dist < closest_dist) {
-        closest_dist = dist;
-      } else {
-        // since this is a straight trajectory we have already found
-        // the smallest point
-        break;
-      }
-  }
-  return closest_dist;
+BarrierParams BarrierGammaStraight::hetero_params(
+    double max_val, double v, double /*w_rad_per_sec*/, double safety_dist,
+    double lmbda) const {
+  // the evasive maneuver is always straight so the turn rate is unused
+  return {max_val, v, 0, safety_dist, lmbda};
+}
+
+EvasiveManeuver BarrierGammaStraight::evasive_maneuver(const BarrierParams & /*p*/) const {
+  return {0, static_cast<size_t>(straight_rollout_time / dt_), true};
+}
+
+std::shared_ptr<BarrierGammaTurn> BarrierGammaStraight::clone() const {
+  return std::make_shared<BarrierGammaStraight>(*this);
 }
 
 std::string BarrierGammaStraight::to_string() const {
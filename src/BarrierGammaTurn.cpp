@@ -1,10 +1,83 @@
 
 #include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/Profiler.h>
+#include <fw-coll-env/Uhat.h>
 
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 namespace fw_coll_env {
 
+namespace {
+
+// [v1, w1, dz1, v2, w2, dz2]
+using ActionVec = std::array<double, 6>;
+
+FwAction vec_to_action(const ActionVec &u) {
+  return {FwSingleAction(u[0], u[1], u[2]), FwSingleAction(u[3], u[4], u[5])};
+}
+
+// minimizes |u - uhat| over lo <= u <= hi subject to
+// g + grad . (u - u_lin) >= 0. The solution is clip(uhat + mu * grad) for
+// the smallest mu >= 0 satisfying the constraint, and the constraint value
+// along that path is nondecreasing in mu so mu is found by bisection.
+// If the constraint cannot be met the box corner maximizing it is returned.
+ActionVec project_linear_constraint(
+    const ActionVec &uhat, const ActionVec &u_lin, double g,
+    const ActionVec &grad, const ActionVec &lo, const ActionVec &hi) {
+
+  auto point = [&](double mu) {
+    ActionVec u;
+    for (size_t k = 0; k < u.size(); k++) {
+      u[k] = std::clamp(uhat[k] + mu * grad[k], lo[k], hi[k]);
+    }
+    return u;
+  };
+  auto constraint = [&](const ActionVec &u) {
+    double val = g;
+    for (size_t k = 0; k < u.size(); k++) {
+      val += grad[k] * (u[k] - u_lin[k]);
+    }
+    return val;
+  };
+
+  if (constraint(point(0)) >= 0) {
+    return point(0);
+  }
+
+  // beyond mu_max every coordinate with a nonzero gradient is saturated
+  double mu_max = 0;
+  for (size_t k = 0; k < grad.size(); k++) {
+    if (grad[k] > 0) {
+      mu_max = std::max(mu_max, (hi[k] - uhat[k]) / grad[k]);
+    } else if (grad[k] < 0) {
+      mu_max = std::max(mu_max, (lo[k] - uhat[k]) / grad[k]);
+    }
+  }
+  if (constraint(point(mu_max)) < 0) {
+    return point(mu_max);
+  }
+
+  double mu_lo = 0;
+  double mu_hi = mu_max;
+  for (int i = 0; i < 60; i++) {
+    const double mu = 0.5 * (mu_lo + mu_hi);
+    if (constraint(point(mu)) >= 0) {
+      mu_hi = mu;
+    } else {
+      mu_lo = mu;
+    }
+  }
+  return point(mu_hi);
+}
+
+} // namespace
+
 BarrierGammaTurn::BarrierGammaTurn(
       double dt, double max_val, double v, double w_deg_per_sec, double safety_dist,
       const FwAvailActions &avail_actions) :
@@ -12,102 +85,849 @@ BarrierGammaTurn::BarrierGammaTurn(
     v_(v), w_rad_per_sec_(deg2rad(w_deg_per_sec)),
     safety_dist_(safety_dist), avail_actions_(avail_actions),
     action_index_(avail_actions) {
+  to_int(1 / dt_);
+  BarrierGammaTurn::check_params(get_params());
+}
 
-  const double freq = 2 * M_PI / w_rad_per_sec_;
+bool BarrierParams::operator==(const BarrierParams &p) const {
+  return max_val == p.max_val && v == p.v && w_rad_per_sec == p.w_rad_per_sec &&
+    safety_dist == p.safety_dist && lambda == p.lambda;
+}
+
+void BarrierGammaTurn::check_params(const BarrierParams &p) const {
+  const double freq = 2 * M_PI / p.w_rad_per_sec;
   to_int(freq);
-  to_int(1 / dt_);
 
   // make sure v, w, and 0 for dt are in avail actions
   // so throw exception on action_to_idx if this is not the case.
-  FwSingleAction ac {v_, w_rad_per_sec_, 0};
+  FwSingleAction ac {p.v, p.w_rad_per_sec, 0};
   avail_actions_.action_to_idx(ac);
 }
 
-double BarrierGammaTurn::calc_h(const FwState &x0) {
-  double d = closest_future_dist(x0);
-  return std::min(max_val_, d - safety_dist_);
+BarrierParams BarrierGammaTurn::hetero_params(
+    double max_val, double v, double w_rad_per_sec, double safety_dist,
+    double lmbda) const {
+  return {max_val, v, w_rad_per_sec, safety_dist, lmbda};
 }
 
-double BarrierGammaTurn::calc_dh(const FwState &x0, const FwAction &ac) {
+double BarrierGammaTurn::calc_h(const FwState &x0) const {
+  PruneCounts counts;
+  const double h = calc_h(x0, get_params(), counts);
+  add_counts(counts);
+  return h;
+}
+
+template <typename T>
+T BarrierGammaTurn::calc_h(
+    const FwStateT<T> &x0, const BarrierParams &p, PruneCounts &counts) const {
+  return p.h(closest_future_dist(x0, p, counts));
+}
+
+double BarrierGammaTurn::calc_dh(const FwState &x0, const FwAction &ac) const {
   FwState x = x0;
   fw_dynamics(dt_, ac.a1, x.x1);
   fw_dynamics(dt_, ac.a2, x.x2);
-  return calc_h(x) - calc_h(x0);
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  const double dh = calc_h(x, p, counts) - calc_h(x0, p, counts);
+  add_counts(counts);
+  return dh;
 }
 
-size_t BarrierGammaTurn::steps_per_revolution() const {
-  // already checked this is an integer in constructor
-  return 2 * M_PI / w_rad_per_sec_ / dt_;
+void BarrierGammaTurn::add_counts(const PruneCounts &counts) const {
+  if (counts.skipped_steps) {
+    skipped_.steps.fetch_add(counts.skipped_steps, std::memory_order_relaxed);
+  }
+  if (counts.skipped_candidates) {
+    skipped_.candidates.fetch_add(counts.skipped_candidates, std::memory_order_relaxed);
+  }
 }
 
-double BarrierGammaTurn::closest_future_dist(const FwState &x0) {
+void BarrierGammaTurn::reset_skipped_counts() {
+  skipped_.steps.store(0, std::memory_order_relaxed);
+  skipped_.candidates.store(0, std::memory_order_relaxed);
+}
 
-  FwState x = x0;
-  FwSingleAction ac {v_, w_rad_per_sec_, 0};
-  double closest_dist = x.x1.p.dist(x.x2.p);
-  const size_t n = steps_per_revolution();
+size_t BarrierGammaTurn::steps_per_revolution(double w_rad_per_sec) const {
+  // already checked this is an integer by check_params. A negative w
+  // turns clockwise and takes as many steps, without std::abs the count
+  // would be negative before the conversion to size_t.
+  return 2 * M_PI / std::abs(w_rad_per_sec) / dt_;
+}
+
+EvasiveManeuver BarrierGammaTurn::evasive_maneuver(const BarrierParams &p) const {
+  return {p.w_rad_per_sec, steps_per_revolution(p.w_rad_per_sec), false};
+}
+
+template <typename T>
+size_t BarrierGammaTurn::steps_out_of_reach(
+    const BarrierParams &p, T dist, T closest_dist, size_t max_steps) const {
+  // each vehicle moves exactly |v| * dt per rollout step, so j steps from
+  // now the distance is at least dist - 2 * |v| * dt * j. Steps for which
+  // that bound stays above both closest_dist and the distance where h
+  // saturates at max_val cannot change h. The slack absorbs rounding
+  // in the integration (more of it in float) so the pruning never
+  // changes the returned h.
+  const T rel_slack = std::max<T>(1e-9, 1024 * std::numeric_limits<T>::epsilon());
+  const T target = std::min<T>(
+      closest_dist, static_cast<T>(p.max_val) + static_cast<T>(p.safety_dist));
+  const T margin = dist - rel_slack * (1 + dist) - target;
+  if (margin < 0) {
+    return 0;
+  }
+
+  const T closing_per_step = 2 * std::abs(static_cast<T>(p.v)) * static_cast<T>(dt_);
+  if (closing_per_step <= 0) {
+    return max_steps;
+  }
+  return std::min<T>(max_steps, std::floor(margin / closing_per_step));
+}
+
+template <typename T>
+T BarrierGammaTurn::maneuver_dist(
+    const FwStateT<T> &x0, const BarrierParams &p, const EvasiveManeuver &man,
+    PruneCounts &counts, FwStateT<T> *x_closest) const {
+  FW_PROFILE_SCOPE(closest_future_dist);
+  FW_PROFILE_COUNT(rollouts, 1);
+
+  FwStateT<T> x = x0;
+  if (x_closest) {
+    *x_closest = x0;
+  }
+  const T dt = dt_;
+  const FwSingleActionT<T> ac(p.v, man.w_rad_per_sec, 0);
+  T closest_dist = x.x1.p.dist(x.x2.p);
+  const size_t n = man.num_steps;
+
+  size_t next_check = steps_out_of_reach(p, closest_dist, closest_dist, n);
+  if (next_check >= n) {
+    counts.skipped_steps += n;
+    return closest_dist;
+  }
+  if (man.straight) {
+    // a straight rollout stops at its closest point, so every step is checked
+    next_check = 0;
+  }
+
+  size_t num_steps = n;
   for (size_t i = 0; i < n; i++) {
-      fw_dynamics(dt_, ac, x.x1);
-      fw_dynamics(dt_, ac, x.x2);
-      closest_dist = std::min(closest_dist, x.x1.p.dist(x.x2.p));
+      fw_dynamics(dt, ac, x.x1);
+      fw_dynamics(dt, ac, x.x2);
+      if (i + 1 <= next_check) {
+        continue;
+      }
+
+      const T dist = x.x1.p.dist(x.x2.p);
+      if (dist < closest_dist) {
+        closest_dist = dist;
+        if (x_closest) {
+          *x_closest = x;
+        }
+      } else if (man.straight) {
+        // a straight trajectory has passed its closest point
+        num_steps = i + 1;
+        break;
+      }
+
+      const size_t steps_left = n - i - 1;
+      const size_t unreachable = steps_out_of_reach(p, dist, closest_dist, steps_left);
+      if (unreachable >= steps_left) {
+        counts.skipped_steps += steps_left;
+        num_steps = i + 1;
+        break;
+      }
+      next_check = man.straight ? 0 : i + 1 + unreachable;
   }
+  FW_PROFILE_COUNT(rollout_steps, num_steps);
   return closest_dist;
 }
 
-double BarrierGammaTurn::bf_constraint(
-    double h, const FwState &x0, const FwAction &_ac) {
-  FwState x = x0;
-  fw_dynamics(dt_, _ac.a1, x.x1);
-  fw_dynamics(dt_, _ac.a2, x.x2);
-  double hnext = calc_h(x);
-  return (hnext - h) + lambda_ * h;
+double BarrierGammaTurn::closest_future_dist(
+    const FwState &x0, const BarrierParams &p, PruneCounts &counts) const {
+  return maneuver_dist(x0, p, evasive_maneuver(p), counts);
+}
+
+float BarrierGammaTurn::closest_future_dist(
+    const FwStateT<float> &x0, const BarrierParams &p, PruneCounts &counts) const {
+  return maneuver_dist(x0, p, evasive_maneuver(p), counts);
+}
+
+double BarrierGammaTurn::closest_future_state(
+    const FwState &x0, const BarrierParams &p, FwState &x_closest,
+    PruneCounts &counts) const {
+  return maneuver_dist(x0, p, evasive_maneuver(p), counts, &x_closest);
+}
+
+std::pair<double, std::array<double, 8>> BarrierGammaTurn::calc_h_grad(
+    const FwState &x0) const {
+  PruneCounts counts;
+  const auto out = calc_h_grad(x0, get_params(), counts);
+  add_counts(counts);
+  return out;
+}
+
+std::pair<double, std::array<double, 8>> BarrierGammaTurn::calc_h_grad(
+    const FwState &x0, const BarrierParams &p, PruneCounts &counts) const {
+  FwState xc;
+  const double d = closest_future_state(x0, p, xc, counts);
+  const double h = p.h(d);
+
+  std::array<double, 8> grad {};
+  if (d - p.safety_dist >= p.max_val || d <= 0) {
+    return {h, grad};
+  }
+
+  const double ex = (xc.x1.p.x - xc.x2.p.x) / d;
+  const double ey = (xc.x1.p.y - xc.x2.p.y) / d;
+  const double ez = (xc.x1.p.z - xc.x2.p.z) / d;
+  grad[0] = ex;
+  grad[1] = ey;
+  grad[2] = -ex * (xc.x1.p.y - x0.x1.p.y) + ey * (xc.x1.p.x - x0.x1.p.x);
+  grad[3] = ez;
+  grad[4] = -ex;
+  grad[5] = -ey;
+  grad[6] = ex * (xc.x2.p.y - x0.x2.p.y) - ey * (xc.x2.p.x - x0.x2.p.x);
+  grad[7] = -ez;
+  return {h, grad};
+}
+
+std::pair<pybind11::array_t<double>, pybind11::array_t<double>>
+BarrierGammaTurn::calc_h_grad_batch(pybind11::array_t<double> x) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to calc_h_grad");
+  }
+
+  const auto num_rows = x.shape(0);
+  pybind11::array_t<double> h {num_rows};
+  pybind11::array_t<double> grad {{num_rows, pybind11::ssize_t(8)}};
+
+  auto _x = x.unchecked<2>();
+  auto _h = h.mutable_unchecked<1>();
+  auto _grad = grad.mutable_unchecked<2>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+
+    const auto [h_val, g] = calc_h_grad(x_state, p, counts);
+    _h(i) = h_val;
+    for (size_t j = 0; j < 8; j++) {
+      _grad(i, j) = g[j];
+    }
+  }
+
+  add_counts(counts);
+  return {h, grad};
+}
+
+pybind11::array_t<double> BarrierGammaTurn::calc_h_grad_fd(
+    pybind11::array_t<double> x, double eps) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to calc_h_grad_fd");
+  }
+
+  const auto num_rows = x.shape(0);
+  pybind11::array_t<double> grad {{num_rows, pybind11::ssize_t(8)}};
+
+  auto _x = x.unchecked<2>();
+  auto _grad = grad.mutable_unchecked<2>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  auto h_at = [&](const std::array<double, 8> &row) {
+    const FwState x_state {FwSingleState(Point(row[0], row[1], row[3]), row[2]),
+                           FwSingleState(Point(row[4], row[5], row[7]), row[6])};
+    return calc_h(x_state, p, counts);
+  };
+
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    std::array<double, 8> row;
+    for (size_t j = 0; j < 8; j++) {
+      row[j] = _x(i, j);
+    }
+    for (size_t j = 0; j < 8; j++) {
+      std::array<double, 8> hi = row, lo = row;
+      hi[j] += eps;
+      lo[j] -= eps;
+      _grad(i, j) = (h_at(hi) - h_at(lo)) / (2 * eps);
+    }
+  }
+
+  add_counts(counts);
+  return grad;
+}
+
+template <typename T>
+T BarrierGammaTurn::bf_constraint(
+    const BarrierParams &p, T h, const FwStateT<T> &x0, const FwActionT<T> &_ac,
+    PruneCounts &counts) const {
+  const T dt = dt_;
+  FwStateT<T> x = x0;
+  fw_dynamics(dt, _ac.a1, x.x1);
+  fw_dynamics(dt, _ac.a2, x.x2);
+  return p.bf_value(h, calc_h(x, p, counts));
 }
 
 pybind11::array_t<int> BarrierGammaTurn::choose_u(
-    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) {
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) const {
+  FW_PROFILE_SCOPE(choose_u);
+  return choose_u_rows(x, uhat_idx, nullptr, "choose_u");
+}
+
+pybind11::array_t<int> BarrierGammaTurn::choose_u_rows(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+    std::vector<ChooseUInfo> *info, const char *name) const {
+  if (x.ndim() != 2 || uhat_idx.ndim() != 1 || x.shape(1) != 8 ||
+      uhat_idx.shape(0) != x.shape(0)) {
+    throw std::runtime_error(std::string("invalid shape given to ") + name);
+  }
 
   int num_rows = x.shape(0);
-  if (x.shape(1) != 8 || uhat_idx.shape(0) != num_rows) {
-    throw std::runtime_error("invalid shape given to choose_u");
+  pybind11::array_t<int> out {num_rows};
+  int num_overrides = 0;
+  if (info) {
+    info->resize(num_rows);
+  }
+
+  auto _x = x.unchecked<2>();
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  auto _out = out.mutable_unchecked<1>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (int i = 0; i < num_rows; i++) {
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+
+    FwAction uhat_ac = action_index_.idx_to_action(_uhat_idx(i));
+    FwAction safe_ac =
+      choose_u_single(x_state, uhat_ac, p, counts, info ? &(*info)[i] : nullptr);
+    _out(i) = action_index_.action_to_idx(safe_ac);
+    num_overrides += _out(i) != _uhat_idx(i);
+  }
+
+  add_counts(counts);
+  FW_PROFILE_COUNT(choose_u_rows, num_rows);
+  FW_PROFILE_COUNT(choose_u_overrides, num_overrides);
+  return out;
+}
+
+std::pair<pybind11::array_t<int>, pybind11::array_t<bool>>
+BarrierGammaTurn::choose_u_anytime(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+    double budget_s, bool per_row) const {
+  FW_PROFILE_SCOPE(choose_u);
+  using clock = std::chrono::steady_clock;
+
+  const auto num_rows = x.shape(0);
+  if (x.ndim() != 2 || x.shape(1) != 8 || uhat_idx.shape(0) != num_rows) {
+    throw std::runtime_error("invalid shape given to choose_u_anytime");
+  }
+  if (!(budget_s >= 0)) {
+    throw std::runtime_error("choose_u_anytime requires budget_s >= 0");
   }
 
   pybind11::array_t<int> out {num_rows};
+  pybind11::array_t<bool> complete {num_rows};
+  auto _x = x.unchecked<2>();
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  auto _out = out.mutable_unchecked<1>();
+  auto _complete = complete.mutable_unchecked<1>();
+
+  const int num_joint = avail_actions_.get_all_actions().size() *
+                        avail_actions_.get_all_actions().size();
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    if (_uhat_idx(i) < 0 || _uhat_idx(i) >= num_joint) {
+      throw std::runtime_error("uhat_idx out of range in choose_u_anytime");
+    }
+  }
+
+  const auto budget = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(budget_s));
+  clock::time_point deadline = clock::now() + budget;
+  int num_overrides = 0;
+  int num_incomplete = 0;
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    if (per_row) {
+      deadline = clock::now() + budget;
+    } else if (clock::now() >= deadline) {
+      _out(i) = _uhat_idx(i);
+      _complete(i) = false;
+      num_incomplete++;
+      continue;
+    }
+
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    bool row_complete;
+    _out(i) = choose_u_anytime_single(
+        x_state, _uhat_idx(i), deadline, row_complete, p, counts);
+    _complete(i) = row_complete;
+    num_overrides += _out(i) != _uhat_idx(i);
+    num_incomplete += !row_complete;
+  }
+
+  add_counts(counts);
+  FW_PROFILE_COUNT(choose_u_rows, num_rows);
+  FW_PROFILE_COUNT(choose_u_overrides, num_overrides);
+  FW_PROFILE_COUNT(choose_u_incomplete, num_incomplete);
+  return {out, complete};
+}
+
+int BarrierGammaTurn::choose_u_anytime_single(
+    const FwState &x0, int uhat_idx,
+    std::chrono::steady_clock::time_point deadline, bool &complete,
+    const BarrierParams &p, PruneCounts &counts) const {
+  complete = true;
+  const FwAction uhat = action_index_.idx_to_action(uhat_idx);
+  const double h = calc_h(x0, p, counts);
+  const double uhat_bf_val = bf_constraint(p, h, x0, uhat, counts);
+  if (uhat_bf_val >= 0) {
+    return uhat_idx;
+  }
+  FW_PROFILE_SCOPE(choose_u_search);
+  FW_PROFILE_COUNT(choose_u_searches, 1);
+
+  // the stable sort keeps equally distant candidates in index order,
+  // which is how choose_u_single breaks ties
+  const auto &all_actions = avail_actions_.get_all_actions();
+  const int num = all_actions.size();
+  std::vector<std::pair<double, int>> order;
+  order.reserve(num * num);
+  for (int i1 = 0; i1 < num; i1++) {
+    for (int i2 = 0; i2 < num; i2++) {
+      order.emplace_back(
+          all_actions[i1].dist(uhat.a1) + all_actions[i2].dist(uhat.a2), i1 * num + i2);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(),
+      [](const auto &a, const auto &b) {return a.first < b.first;});
+
+  // least unsafe action so far. As in choose_u_single ties keep uhat and
+  // otherwise go to the lower index.
+  int best_idx = uhat_idx;
+  double best_bf_val = uhat_bf_val;
+  auto improves = [&](double bf_val, int idx) {
+    return bf_val > best_bf_val ||
+      (bf_val == best_bf_val && best_idx != uhat_idx && idx < best_idx);
+  };
+
+  size_t num_candidates = 0;
+  for (const auto &cand : order) {
+    const int idx = cand.second;
+    if (idx == uhat_idx) {
+      continue;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      complete = false;
+      break;
+    }
+
+    FwState x = x0;
+    fw_dynamics(dt_, all_actions[idx / num], x.x1);
+    fw_dynamics(dt_, all_actions[idx % num], x.x2);
+    const double hnext_bound = p.h(x.x1.p.dist(x.x2.p));
+    if (!improves(p.bf_value(h, hnext_bound), idx)) {
+      counts.skipped_candidates++;
+      continue;
+    }
+    const double bf_val = p.bf_value(h, calc_h(x, p, counts));
+    num_candidates++;
+    if (bf_val >= 0) {
+      // every later candidate is at least as far from uhat
+      best_idx = idx;
+      break;
+    }
+    if (improves(bf_val, idx)) {
+      best_idx = idx;
+      best_bf_val = bf_val;
+    }
+  }
+
+  FW_PROFILE_COUNT(choose_u_candidates, num_candidates);
+  return best_idx;
+}
+
+void BarrierGammaTurn::safe_actions_single(
+    const FwState &x0, const FwSingleAction &a2, bool *safe, const BarrierParams &p,
+    PruneCounts &counts) const {
+  const double h = calc_h(x0, p, counts);
+  FwState x = x0;
+  fw_dynamics(dt_, a2, x.x2);
+
+  // fw_dynamics of vehicle 1 with the trig of its heading hoisted
+  const double cos_th = std::cos(x0.x1.th);
+  const double sin_th = std::sin(x0.x1.th);
+  const auto &all_actions = avail_actions_.get_all_actions();
+  for (size_t a = 0; a < all_actions.size(); a++) {
+    const FwSingleAction &a1 = all_actions[a];
+    x.x1.p.x = x0.x1.p.x + a1.v * cos_th * dt_;
+    x.x1.p.y = x0.x1.p.y + a1.v * sin_th * dt_;
+    x.x1.th = x0.x1.th + a1.w * dt_;
+    x.x1.p.z = x0.x1.p.z + a1.dz * dt_;
+
+    // h(x) is at most the current distance less safety_dist
+    const double hnext_bound = p.h(x.x1.p.dist(x.x2.p));
+    if (p.bf_value(h, hnext_bound) < 0) {
+      counts.skipped_candidates++;
+      safe[a] = false;
+      continue;
+    }
+    safe[a] = p.bf_value(h, calc_h(x, p, counts)) >= 0;
+  }
+}
+
+pybind11::array BarrierGammaTurn::safe_action_mask(
+    pybind11::array_t<double> x, const std::vector<FwSingleAction> &a2,
+    bool packed) const {
+  FW_PROFILE_SCOPE(safe_action_mask);
+
+  const auto num_rows = x.shape(0);
+  const auto num = static_cast<pybind11::ssize_t>(avail_actions_.get_all_actions().size());
+  auto _x = x.unchecked<2>();
+  std::unique_ptr<bool[]> safe(new bool[num]);
+
+  pybind11::array_t<bool> mask;
+  pybind11::array_t<uint8_t> bits;
+  if (packed) {
+    bits = pybind11::array_t<uint8_t>({num_rows, (num + 7) / 8});
+    std::fill(bits.mutable_data(), bits.mutable_data() + bits.size(), 0);
+  } else {
+    mask = pybind11::array_t<bool>({num_rows, num});
+  }
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    const FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    safe_actions_single(x_state, a2[i], safe.get(), p, counts);
+    if (packed) {
+      // np.packbits order, the first action is the high bit
+      uint8_t *row = bits.mutable_data() + i * bits.shape(1);
+      for (pybind11::ssize_t a = 0; a < num; a++) {
+        row[a / 8] |= safe[a] << (7 - a % 8);
+      }
+    } else {
+      std::copy(safe.get(), safe.get() + num, mask.mutable_data() + i * num);
+    }
+  }
+
+  add_counts(counts);
+  FW_PROFILE_COUNT(safe_mask_rows, num_rows);
+  if (packed) {
+    return bits;
+  }
+  return mask;
+}
+
+pybind11::array BarrierGammaTurn::safe_action_mask(
+    pybind11::array_t<double> x, pybind11::array_t<int> a2_idx, bool packed) const {
+  if (x.ndim() != 2 || x.shape(1) != 8 || a2_idx.ndim() != 1 ||
+      a2_idx.shape(0) != x.shape(0)) {
+    throw std::runtime_error("invalid shape given to safe_action_mask");
+  }
+
+  const auto &all_actions = avail_actions_.get_all_actions();
+  auto _a2_idx = a2_idx.unchecked<1>();
+  std::vector<FwSingleAction> a2;
+  a2.reserve(x.shape(0));
+  for (pybind11::ssize_t i = 0; i < x.shape(0); i++) {
+    if (_a2_idx(i) < 0 || _a2_idx(i) >= static_cast<int>(all_actions.size())) {
+      throw std::runtime_error("a2_idx out of range in safe_action_mask");
+    }
+    a2.push_back(all_actions[_a2_idx(i)]);
+  }
+  return safe_action_mask(x, a2, packed);
+}
+
+pybind11::array BarrierGammaTurn::safe_action_mask(
+    pybind11::array_t<double> x, const Uhat &uhat2, bool packed) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to safe_action_mask");
+  }
 
+  auto _x = x.unchecked<2>();
+  std::vector<FwSingleAction> a2;
+  a2.reserve(x.shape(0));
+  for (pybind11::ssize_t i = 0; i < x.shape(0); i++) {
+    a2.push_back(uhat2.calc(FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))));
+  }
+  return safe_action_mask(x, a2, packed);
+}
+
+pybind11::array_t<float> BarrierGammaTurn::calc_h_f32(pybind11::array_t<float> x) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to calc_h_f32");
+  }
+
+  const auto num_rows = x.shape(0);
+  pybind11::array_t<float> out {num_rows};
+  auto _x = x.unchecked<2>();
+  auto _out = out.mutable_unchecked<1>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    const FwStateT<float> x_state {
+      FwSingleStateT<float>(PointT<float>(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleStateT<float>(PointT<float>(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    _out(i) = calc_h(x_state, p, counts);
+  }
+
+  add_counts(counts);
+  return out;
+}
+
+pybind11::array_t<int> BarrierGammaTurn::choose_u_f32(
+    pybind11::array_t<float> x, pybind11::array_t<int> uhat_idx) const {
+  FW_PROFILE_SCOPE(choose_u);
+
+  if (x.ndim() != 2 || uhat_idx.ndim() != 1 || x.shape(1) != 8 ||
+      uhat_idx.shape(0) != x.shape(0)) {
+    throw std::runtime_error("invalid shape given to choose_u_f32");
+  }
+
+  const auto num_rows = x.shape(0);
+  pybind11::array_t<int> out {num_rows};
   auto _x = x.unchecked<2>();
   auto _uhat_idx = uhat_idx.unchecked<1>();
   auto _out = out.mutable_unchecked<1>();
 
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  int num_overrides = 0;
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    const FwStateT<float> x_state {
+      FwSingleStateT<float>(PointT<float>(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleStateT<float>(PointT<float>(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    _out(i) = choose_u_f32_single(x_state, _uhat_idx(i), p, counts);
+    num_overrides += _out(i) != _uhat_idx(i);
+  }
+
+  add_counts(counts);
+  FW_PROFILE_COUNT(choose_u_rows, num_rows);
+  FW_PROFILE_COUNT(choose_u_overrides, num_overrides);
+  return out;
+}
+
+int BarrierGammaTurn::filter_action_f32(const FwStateT<float> &x0, int uhat_idx) const {
+  PruneCounts counts;
+  const int idx = choose_u_f32_single(x0, uhat_idx, get_params(), counts);
+  add_counts(counts);
+  return idx;
+}
+
+int BarrierGammaTurn::choose_u_f32_single(
+    const FwStateT<float> &x0, int uhat_idx, const BarrierParams &p,
+    PruneCounts &counts) const {
+  const size_t num = avail_actions_.get_all_actions().size();
+  if (uhat_idx < 0 || static_cast<size_t>(uhat_idx) >= num * num) {
+    throw std::runtime_error("uhat_idx out of range in choose_u_f32");
+  }
+  const FwActionT<float> uhat(action_index_.idx_to_action(uhat_idx));
+  const float h = calc_h(x0, p, counts);
+  const int idx = choose_u_search(x0, uhat, h, bf_constraint(p, h, x0, uhat, counts), p, counts);
+  return idx < 0 ? uhat_idx : idx;
+}
+
+std::tuple<pybind11::array_t<int>, pybind11::array_t<double>,
+           pybind11::array_t<double>, pybind11::array_t<double>,
+           pybind11::array_t<bool>, pybind11::array_t<int>>
+BarrierGammaTurn::choose_u_diagnostics(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) const {
+  std::vector<ChooseUInfo> info;
+  pybind11::array_t<int> out = choose_u_rows(x, uhat_idx, &info, "choose_u_diagnostics");
+
+  const auto num_rows = out.shape(0);
+  pybind11::array_t<double> h {num_rows};
+  pybind11::array_t<double> uhat_bf_val {num_rows};
+  pybind11::array_t<double> chosen_bf_val {num_rows};
+  pybind11::array_t<bool> overridden {num_rows};
+  pybind11::array_t<int> num_candidates {num_rows};
+
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  auto _out = out.unchecked<1>();
+  auto _h = h.mutable_unchecked<1>();
+  auto _uhat_bf_val = uhat_bf_val.mutable_unchecked<1>();
+  auto _chosen_bf_val = chosen_bf_val.mutable_unchecked<1>();
+  auto _overridden = overridden.mutable_unchecked<1>();
+  auto _num_candidates = num_candidates.mutable_unchecked<1>();
+
+  for (pybind11::ssize_t i = 0; i < num_rows; i++) {
+    _h(i) = info[i].h;
+    _uhat_bf_val(i) = info[i].uhat_bf_val;
+    _chosen_bf_val(i) = info[i].chosen_bf_val;
+    _overridden(i) = _out(i) != _uhat_idx(i);
+    _num_candidates(i) = info[i].num_candidates;
+  }
+
+  return {out, h, uhat_bf_val, chosen_bf_val, overridden, num_candidates};
+}
+
+pybind11::array_t<int> BarrierGammaTurn::choose_u_hetero(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx,
+    pybind11::array_t<double> safety_dist, pybind11::array_t<double> max_val,
+    pybind11::array_t<double> v, pybind11::array_t<double> w_deg_per_sec,
+    pybind11::array_t<double> lmbda) const {
+
+  int num_rows = x.shape(0);
+  if (x.shape(1) != 8 || uhat_idx.shape(0) != num_rows ||
+      safety_dist.shape(0) != num_rows || max_val.shape(0) != num_rows ||
+      v.shape(0) != num_rows || w_deg_per_sec.shape(0) != num_rows ||
+      lmbda.shape(0) != num_rows) {
+    throw std::runtime_error("invalid shape given to choose_u_hetero");
+  }
+
+  pybind11::array_t<int> out {num_rows};
+
+  auto _x = x.unchecked<2>();
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  auto _out = out.mutable_unchecked<1>();
+
+  auto _safety_dist = safety_dist.unchecked<1>();
+  auto _max_val = max_val.unchecked<1>();
+  auto _v = v.unchecked<1>();
+  auto _w = w_deg_per_sec.unchecked<1>();
+  auto _lmbda = lmbda.unchecked<1>();
+
+  PruneCounts counts;
+  BarrierParams checked {};
+  bool have_checked = false;
   for (int i = 0; i < num_rows; i++) {
+    const BarrierParams p = hetero_params(
+        _max_val(i), _v(i), deg2rad(_w(i)), _safety_dist(i), _lmbda(i));
+    // consecutive rows usually share their parameters
+    if (!have_checked || !(p == checked)) {
+      check_params(p);
+      checked = p;
+      have_checked = true;
+    }
+
     FwState x_state {
       FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
       FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
     };
 
     FwAction uhat_ac = action_index_.idx_to_action(_uhat_idx(i));
-    FwAction safe_ac = choose_u_single(x_state, uhat_ac);
+    FwAction safe_ac = choose_u_single(x_state, uhat_ac, p, counts);
     _out(i) = action_index_.action_to_idx(safe_ac);
   }
 
+  add_counts(counts);
   return out;
 }
 
-FwAction BarrierGammaTurn::choose_u_single(const FwState &x0, const FwAction &uhat) {
-  double h = calc_h(x0);
+std::shared_ptr<BarrierGammaTurn> BarrierGammaTurn::clone() const {
+  return std::make_shared<BarrierGammaTurn>(*this);
+}
 
-  double orig_bf_val = bf_constraint(h, x0, uhat);
-  if (orig_bf_val >= 0) {
+FwAction BarrierGammaTurn::filter_action(
+    const FwState &x0, const FwAction &uhat, ChooseUInfo *info) const {
+  PruneCounts counts;
+  const FwAction safe_ac = choose_u_single(x0, uhat, get_params(), counts, info);
+  add_counts(counts);
+  return safe_ac;
+}
+
+FwAction BarrierGammaTurn::choose_u_single(
+    const FwState &x0, const FwAction &uhat, const BarrierParams &p,
+    PruneCounts &counts, ChooseUInfo *info) const {
+  double h = calc_h(x0, p, counts);
+  return choose_u_single(
+      x0, uhat, h, bf_constraint(p, h, x0, uhat, counts), p, counts, info);
+}
+
+FwAction BarrierGammaTurn::choose_u_single(
+    const FwState &x0, const FwAction &uhat, double h, double orig_bf_val,
+    const BarrierParams &p, PruneCounts &counts, ChooseUInfo *info) const {
+  const int idx = choose_u_search(x0, uhat, h, orig_bf_val, p, counts, info);
+  if (idx < 0) {
     return uhat;
   }
+  const auto &all_actions = avail_actions_.get_all_actions();
+  return {all_actions[idx / all_actions.size()], all_actions[idx % all_actions.size()]};
+}
 
-  double best_ac_dist = std::numeric_limits<double>::infinity();
-  FwAction best_ac = uhat;
-  double best_bf_val = orig_bf_val;
+template <typename T>
+int BarrierGammaTurn::choose_u_search(
+    const FwStateT<T> &x0, const FwActionT<T> &uhat, T h, T orig_bf_val,
+    const BarrierParams &p, PruneCounts &counts, ChooseUInfo *info,
+    int fixed1, int fixed2, T *bf_cache) const {
+  if (info) {
+    *info = {h, orig_bf_val, orig_bf_val, 1};
+  }
+  if (orig_bf_val >= 0) {
+    return -1;
+  }
+  FW_PROFILE_SCOPE(choose_u_search);
+  FW_PROFILE_COUNT(choose_u_searches, 1);
+  size_t num_candidates = 0;
+
+  const T dt = dt_;
+  T best_ac_dist = std::numeric_limits<T>::infinity();
+  int best_idx = -1;
+  T best_bf_val = orig_bf_val;
 
   const auto &all_actions = avail_actions_.get_all_actions();
-  for (const auto &ac1 : all_actions) {
-    for (const auto &ac2 : all_actions) {
-      FwAction ac {ac1, ac2};
-      double temp_bf_val = bf_constraint(h, x0, ac);
+  const int num_actions = all_actions.size();
+  for (int i1 = 0; i1 < num_actions; i1++) {
+    if (fixed1 >= 0 && i1 != fixed1) {
+      continue;
+    }
+    const FwSingleActionT<T> ac1(all_actions[i1]);
+    for (int i2 = 0; i2 < num_actions; i2++) {
+      if (fixed2 >= 0 && i2 != fixed2) {
+        continue;
+      }
+      const FwSingleActionT<T> ac2(all_actions[i2]);
+      T temp_ac_dist = ac1.dist(uhat.a1) + ac2.dist(uhat.a2);
+      if (best_bf_val >= 0 && temp_ac_dist >= best_ac_dist) {
+        // only a closer safe action can replace a safe one
+        counts.skipped_candidates++;
+        continue;
+      }
+
+      T *cached = bf_cache ? &bf_cache[i1 * num_actions + i2] : nullptr;
+      T temp_bf_val;
+      if (cached && !std::isnan(*cached)) {
+        temp_bf_val = *cached;
+      } else {
+        FwStateT<T> x = x0;
+        fw_dynamics(dt, ac1, x.x1);
+        fw_dynamics(dt, ac2, x.x2);
+        if (best_bf_val < 0) {
+          // h never exceeds rho at the next state, so skip the rollout
+          // when even that bound is no improvement
+          const T hnext_bound = p.h(x.x1.p.dist(x.x2.p));
+          if (p.bf_value(h, hnext_bound) <= best_bf_val) {
+            counts.skipped_candidates++;
+            continue;
+          }
+        }
+        temp_bf_val = p.bf_value(h, calc_h(x, p, counts));
+        num_candidates++;
+        if (info) {
+          info->num_candidates++;
+        }
+        if (cached) {
+          *cached = temp_bf_val;
+        }
+      }
 
       if ((best_bf_val >= 0 && temp_bf_val < 0) ||
           (best_bf_val < 0 && temp_bf_val < best_bf_val)) {
@@ -117,20 +937,144 @@ FwAction BarrierGammaTurn::choose_u_single(const FwState &x0, const FwAction &uh
         continue;
       }
 
-      double temp_ac_dist = ac1.dist(uhat.a1) + ac2.dist(uhat.a2);
-
       if ((best_bf_val < 0 && temp_bf_val > best_bf_val) ||
           (best_bf_val >= 0 && temp_bf_val >= 0 && best_ac_dist > temp_ac_dist)) {
         // if the current action is not safe and this is safer
         // or if the current acton safe and this one is both
         // safe and closer
         best_bf_val = temp_bf_val;
-        best_ac = ac;
+        best_idx = i1 * num_actions + i2;
         best_ac_dist = temp_ac_dist;
       }
     }
   }
 
+  FW_PROFILE_COUNT(choose_u_candidates, num_candidates);
+  if (info) {
+    info->chosen_bf_val = best_bf_val;
+  }
+  return best_idx;
+}
+
+std::pair<pybind11::array_t<double>, pybind11::array_t<bool>>
+BarrierGammaTurn::choose_u_continuous(
+    pybind11::array_t<double> x, pybind11::array_t<double> uhat,
+    bool grid_fallback) const {
+
+  int num_rows = x.shape(0);
+  if (x.shape(1) != 8 || uhat.shape(0) != num_rows || uhat.shape(1) != 6) {
+    throw std::runtime_error("invalid shape given to choose_u_continuous");
+  }
+
+  pybind11::array_t<double> out {{num_rows, 6}};
+  pybind11::array_t<bool> verified {num_rows};
+
+  auto _x = x.unchecked<2>();
+  auto _uhat = uhat.unchecked<2>();
+  auto _out = out.mutable_unchecked<2>();
+  auto _verified = verified.mutable_unchecked<1>();
+
+  const BarrierParams p = get_params();
+  PruneCounts counts;
+  for (int i = 0; i < num_rows; i++) {
+    FwState x_state {
+      FwSingleState(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2)),
+      FwSingleState(Point(_x(i, 4), _x(i, 5), _x(i, 7)), _x(i, 6))
+    };
+    FwAction uhat_ac {
+      FwSingleAction(_uhat(i, 0), _uhat(i, 1), _uhat(i, 2)),
+      FwSingleAction(_uhat(i, 3), _uhat(i, 4), _uhat(i, 5))
+    };
+
+    bool row_verified;
+    FwAction safe_ac = choose_u_continuous_single(
+        x_state, uhat_ac, grid_fallback, row_verified, p, counts);
+    _out(i, 0) = safe_ac.a1.v;
+    _out(i, 1) = safe_ac.a1.w;
+    _out(i, 2) = safe_ac.a1.dz;
+    _out(i, 3) = safe_ac.a2.v;
+    _out(i, 4) = safe_ac.a2.w;
+    _out(i, 5) = safe_ac.a2.dz;
+    _verified(i) = row_verified;
+  }
+
+  add_counts(counts);
+  return {out, verified};
+}
+
+FwAction BarrierGammaTurn::choose_u_continuous_single(
+    const FwState &x0, const FwAction &uhat, bool grid_fallback, bool &verified,
+    const BarrierParams &p, PruneCounts &counts) const {
+
+  ActionVec lo, hi;
+  const std::vector<double> *vals[3] = {
+    &avail_actions_.get_v(), &avail_actions_.get_w_rad_per_sec(),
+    &avail_actions_.get_dz()};
+  for (size_t k = 0; k < 3; k++) {
+    const auto [min_it, max_it] = std::minmax_element(vals[k]->begin(), vals[k]->end());
+    lo[k] = lo[k + 3] = *min_it;
+    hi[k] = hi[k + 3] = *max_it;
+  }
+
+  const double h = calc_h(x0, p, counts);
+  double g = bf_constraint(p, h, x0, uhat, counts);
+  if (g >= 0) {
+    // a safe uhat is kept as is, even outside the bounding box
+    verified = true;
+    return uhat;
+  }
+
+  ActionVec u_hat {
+    uhat.a1.v, uhat.a1.w, uhat.a1.dz, uhat.a2.v, uhat.a2.w, uhat.a2.dz};
+  bool clamped = false;
+  for (size_t k = 0; k < u_hat.size(); k++) {
+    const double val = std::clamp(u_hat[k], lo[k], hi[k]);
+    clamped = clamped || val != u_hat[k];
+    u_hat[k] = val;
+  }
+
+  ActionVec u = u_hat;
+  if (clamped) {
+    g = bf_constraint(p, h, x0, vec_to_action(u), counts);
+  }
+  ActionVec best_u = u;
+  double best_g = g;
+
+  for (int iter = 0; iter < continuous_max_iters_ && best_g < 0; iter++) {
+    // forward differences, stepping inward at the upper bound
+    ActionVec grad;
+    for (size_t k = 0; k < u.size(); k++) {
+      const double step = continuous_fd_step_ * (hi[k] - lo[k]);
+      if (step <= 0) {
+        grad[k] = 0;
+        continue;
+      }
+      ActionVec u_step = u;
+      u_step[k] = u[k] + step <= hi[k] ? u[k] + step : u[k] - step;
+      const double g_step = bf_constraint(p, h, x0, vec_to_action(u_step), counts);
+      grad[k] = (g_step - g) / (u_step[k] - u[k]);
+    }
+
+    u = project_linear_constraint(u_hat, u, g, grad, lo, hi);
+    g = bf_constraint(p, h, x0, vec_to_action(u), counts);
+    if (g > best_g) {
+      best_g = g;
+      best_u = u;
+    }
+  }
+
+  FwAction best_ac = vec_to_action(best_u);
+  if (best_g < 0 && grid_fallback) {
+    // the linearization can miss safe actions far from uhat
+    const FwAction grid_ac = choose_u_single(x0, vec_to_action(u_hat), p, counts);
+    const double grid_g = bf_constraint(p, h, x0, grid_ac, counts);
+    if (grid_g > best_g) {
+      best_g = grid_g;
+      best_ac = grid_ac;
+    }
+  }
+
+  verified = best_g >= 0;
   return best_ac;
 }
 
@@ -141,4 +1085,32 @@ std::string BarrierGammaTurn::to_string() const {
     ",w_deg_per_sec=" + std::to_string(rad2deg(w_rad_per_sec_)) +
     ",safety_dist=" + std::to_string(safety_dist_) + ")";
 }
+
+template size_t BarrierGammaTurn::steps_out_of_reach(
+    const BarrierParams &, float, float, size_t) const;
+template float BarrierGammaTurn::maneuver_dist(
+    const FwStateT<float> &, const BarrierParams &, const EvasiveManeuver &, PruneCounts &,
+    FwStateT<float> *) const;
+template float BarrierGammaTurn::calc_h(
+    const FwStateT<float> &, const BarrierParams &, PruneCounts &) const;
+template float BarrierGammaTurn::bf_constraint(
+    const BarrierParams &, float, const FwStateT<float> &, const FwActionT<float> &,
+    PruneCounts &) const;
+template int BarrierGammaTurn::choose_u_search(
+    const FwStateT<float> &, const FwActionT<float> &, float, float, const BarrierParams &,
+    PruneCounts &, ChooseUInfo *, int, int, float *) const;
+
+template size_t BarrierGammaTurn::steps_out_of_reach(
+    const BarrierParams &, double, double, size_t) const;
+template double BarrierGammaTurn::maneuver_dist(
+    const FwStateT<double> &, const BarrierParams &, const EvasiveManeuver &, PruneCounts &,
+    FwStateT<double> *) const;
+template double BarrierGammaTurn::calc_h(
+    const FwStateT<double> &, const BarrierParams &, PruneCounts &) const;
+template double BarrierGammaTurn::bf_constraint(
+    const BarrierParams &, double, const FwStateT<double> &, const FwActionT<double> &,
+    PruneCounts &) const;
+template int BarrierGammaTurn::choose_u_search(
+    const FwStateT<double> &, const FwActionT<double> &, double, double, const BarrierParams &,
+    PruneCounts &, ChooseUInfo *, int, int, double *) const;
 } // namespace fw_coll_env
@@ -0,0 +1,221 @@
+#include <fw-coll-env/EncounterGenerator.h>
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+namespace {
+
+double wrap_angle(double th) {
+  return std::remainder(th, 2 * M_PI);
+}
+
+bool in_box(double val, double low, double high) {
+  return val >= low && val <= high;
+}
+
+} // namespace
+
+EncounterGenerator::EncounterGenerator(
+    pybind11::array_t<double> veh1_lims, pybind11::array_t<double> veh2_lims,
+    double v1, double v2, double horizon, double max_miss,
+    double conflict_frac, uint64_t seed) :
+      veh1_lims_(read_box(veh1_lims, "veh1_lims")),
+      veh2_lims_(read_box(veh2_lims, "veh2_lims")),
+      v1_(v1),
+      v2_(v2),
+      horizon_(horizon),
+      max_miss_(max_miss),
+      conflict_frac_(conflict_frac),
+      rng_(seed) {
+
+  if (v1_ <= 0 || v2_ <= 0 || horizon_ <= 0 || max_miss_ <= 0) {
+    throw std::runtime_error(
+        "EncounterGenerator requires positive speeds, horizon and max_miss");
+  }
+  if (conflict_frac_ < 0 || conflict_frac_ >= 1) {
+    // the nominal component keeps the weights bounded by 1 / (1 - conflict_frac)
+    throw std::runtime_error("conflict_frac must be in [0, 1)");
+  }
+  for (size_t dim : {0, 1, 2}) {
+    if (!(veh2_lims_[1][dim] > veh2_lims_[0][dim])) {
+      throw std::runtime_error(
+          "EncounterGenerator requires non-empty x, y and th ranges in veh2_lims");
+    }
+  }
+}
+
+EncounterGenerator::Box EncounterGenerator::read_box(
+    const pybind11::array_t<double> &lims, const char *name) const {
+  if (lims.ndim() != 2 || lims.shape(0) != 2 || lims.shape(1) != 4) {
+    throw std::runtime_error(std::string(name) + " must have shape (2, 4)");
+  }
+
+  Box box;
+  auto _lims = lims.unchecked<2>();
+  for (size_t dim = 0; dim < 4; dim++) {
+    box[0][dim] = _lims(0, dim);
+    box[1][dim] = _lims(1, dim);
+    if (box[1][dim] < box[0][dim]) {
+      throw std::runtime_error(std::string(name) + " has low > high");
+    }
+  }
+  return box;
+}
+
+double EncounterGenerator::sample_dim(const Box &box, size_t dim) {
+  return std::uniform_real_distribution<double>(box[0][dim], box[1][dim])(rng_);
+}
+
+void EncounterGenerator::sample_nominal(Row &x) {
+  for (size_t dim = 0; dim < 4; dim++) {
+    x[4 + dim] = sample_dim(veh2_lims_, dim);
+  }
+}
+
+void EncounterGenerator::sample_conflict(Row &x) {
+  const size_t window = std::discrete_distribution<size_t>(
+      rel_heading_probs_.begin(), rel_heading_probs_.end())(rng_);
+  const double rel_th = rel_heading_centers_[window] +
+    std::uniform_real_distribution<double>(
+        -rel_heading_half_width_, rel_heading_half_width_)(rng_);
+  const double th2 = wrap_angle(x[2] + rel_th);
+
+  const double vr_x = v2_ * std::cos(th2) - v1_ * std::cos(x[2]);
+  const double vr_y = v2_ * std::sin(th2) - v1_ * std::sin(x[2]);
+  const double vr = std::hypot(vr_x, vr_y);
+  if (vr < min_rel_speed_) {
+    // zero density under the conflict proposal, fall back to nominal
+    sample_nominal(x);
+    return;
+  }
+
+  const double tau = std::uniform_real_distribution<double>(0, horizon_)(rng_);
+  const double miss = std::uniform_real_distribution<double>(-max_miss_, max_miss_)(rng_);
+
+  // closest approach at tau with the miss distance along the normal of v_rel
+  x[4] = x[0] - vr_x * tau - vr_y / vr * miss;
+  x[5] = x[1] - vr_y * tau + vr_x / vr * miss;
+  x[6] = th2;
+  x[7] = sample_dim(veh2_lims_, 3);
+}
+
+double EncounterGenerator::nominal_density(const Row &x) const {
+  double out = 1;
+  for (size_t dim : {0, 1, 2}) {
+    if (!in_box(x[4 + dim], veh2_lims_[0][dim], veh2_lims_[1][dim])) {
+      return 0;
+    }
+    out /= veh2_lims_[1][dim] - veh2_lims_[0][dim];
+  }
+  return out;
+}
+
+double EncounterGenerator::conflict_density(const Row &x) const {
+  const double rel_th = wrap_angle(x[6] - x[2]);
+  double th_density = 0;
+  for (size_t k = 0; k < rel_heading_centers_.size(); k++) {
+    if (std::abs(wrap_angle(rel_th - rel_heading_centers_[k])) <= rel_heading_half_width_) {
+      th_density += rel_heading_probs_[k] / (2 * rel_heading_half_width_);
+    }
+  }
+  if (th_density == 0) {
+    return 0;
+  }
+
+  const double vr_x = v2_ * std::cos(x[6]) - v1_ * std::cos(x[2]);
+  const double vr_y = v2_ * std::sin(x[6]) - v1_ * std::sin(x[2]);
+  const double vr = std::hypot(vr_x, vr_y);
+  if (vr < min_rel_speed_) {
+    return 0;
+  }
+
+  // invert the (tau, m) map
+  const double r_x = x[4] - x[0];
+  const double r_y = x[5] - x[1];
+  const double tau = -(r_x * vr_x + r_y * vr_y) / (vr * vr);
+  const double miss = (-r_x * vr_y + r_y * vr_x) / vr;
+  if (!in_box(tau, 0, horizon_) || !in_box(miss, -max_miss_, max_miss_)) {
+    return 0;
+  }
+
+  return th_density / (horizon_ * 2 * max_miss_ * vr);
+}
+
+double EncounterGenerator::weight(const Row &x) const {
+  for (size_t dim = 0; dim < 4; dim++) {
+    if (!in_box(x[dim], veh1_lims_[0][dim], veh1_lims_[1][dim])) {
+      return 0;
+    }
+  }
+  if (!in_box(x[7], veh2_lims_[0][3], veh2_lims_[1][3])) {
+    return 0;
+  }
+
+  const double p = nominal_density(x);
+  if (p == 0) {
+    return 0;
+  }
+  const double q = conflict_density(x);
+  return p / ((1 - conflict_frac_) * p + conflict_frac_ * q);
+}
+
+std::pair<pybind11::array_t<double>, pybind11::array_t<double>>
+EncounterGenerator::sample(size_t n) {
+  const auto num_rows = static_cast<pybind11::ssize_t>(n);
+  pybind11::array_t<double> x {{num_rows, pybind11::ssize_t(8)}};
+  pybind11::array_t<double> w {num_rows};
+  auto _x = x.mutable_unchecked<2>();
+  auto _w = w.mutable_unchecked<1>();
+
+  for (size_t i = 0; i < n; i++) {
+    _w(i) = sample_row(_x.mutable_data(i, 0));
+  }
+
+  return {x, w};
+}
+
+double EncounterGenerator::sample_row(double *x) {
+  Row row;
+  for (size_t dim = 0; dim < 4; dim++) {
+    row[dim] = sample_dim(veh1_lims_, dim);
+  }
+  std::bernoulli_distribution conflict(conflict_frac_);
+  if (conflict(rng_)) {
+    sample_conflict(row);
+  } else {
+    sample_nominal(row);
+  }
+
+  std::copy(row.begin(), row.end(), x);
+  return weight(row);
+}
+
+pybind11::array_t<double> EncounterGenerator::weights(pybind11::array_t<double> x) const {
+  if (x.ndim() != 2 || x.shape(1) != 8) {
+    throw std::runtime_error("invalid shape given to EncounterGenerator.weights");
+  }
+
+  pybind11::array_t<double> w {x.shape(0)};
+  auto _x = x.unchecked<2>();
+  auto _w = w.mutable_unchecked<1>();
+  for (pybind11::ssize_t i = 0; i < x.shape(0); i++) {
+    Row row;
+    for (size_t j = 0; j < 8; j++) {
+      row[j] = _x(i, j);
+    }
+    _w(i) = weight(row);
+  }
+  return w;
+}
+
+std::string EncounterGenerator::to_string() const {
+  return std::string("EncounterGenerator(v1=") + std::to_string(v1_) +
+    ",v2=" + std::to_string(v2_) +
+    ",horizon=" + std::to_string(horizon_) +
+    ",max_miss=" + std::to_string(max_miss_) +
+    ",conflict_frac=" + std::to_string(conflict_frac_) + ")";
+}
+} // namespace fw_coll_env
@@ -52,7 +52,7 @@ size_t FwAvailActions::action_to_idx(const FwSingleAction &ac) const {
   return it->second;
 }
 
-FwSingleAction FwAvailActions::idx_to_action(size_t idx) {
+FwSingleAction FwAvailActions::idx_to_action(size_t idx) const {
   if (idx >= all_actions_.size()) {
     throw std::runtime_error("idx too large for all_actions");
   }
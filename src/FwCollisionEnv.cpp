@@ -1,17 +1,88 @@
 
 #include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/BarrierGammaTurn.h>
+#include <fw-coll-env/Profiler.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 #include <thread>  // NOLINT
 
 namespace fw_coll_env {
 
+namespace {
+
+struct Vec3 {
+  double x, y, z;
+  double dot(const Vec3 &o) const {return x * o.x + y * o.y + z * o.z;}
+};
+
+Vec3 operator-(const Point &a, const Point &b) {
+  return {a.x - b.x, a.y - b.y, a.z - b.z};
+}
+
+// displacement of one Euler step with a straight action
+Vec3 straight_step(double dt, const FwSingleAction &a, const FwSingleState &x) {
+  return {a.v * std::cos(x.th) * dt, a.v * std::sin(x.th) * dt, a.dz * dt};
+}
+
+// roots s1 <= s2 of |r + s * dr| = radius, false if there are none
+bool sphere_crossings(
+    const Vec3 &r, const Vec3 &dr, double radius, double &s1, double &s2) {
+  const double a = dr.dot(dr);
+  const double b = r.dot(dr);
+  const double c = r.dot(r) - radius * radius;
+  if (a <= 0) {
+    return false;
+  }
+  const double disc = b * b - a * c;
+  if (disc < 0) {
+    return false;
+  }
+  s1 = (-b - std::sqrt(disc)) / a;
+  s2 = (-b + std::sqrt(disc)) / a;
+  return true;
+}
+
+// first integer j >= 1 with |r + j * dr| <= radius (or no_step)
+int first_step_within(const Vec3 &r, const Vec3 &dr, double radius, int no_step) {
+  // without relative motion the distance stays |r|
+  if (dr.dot(dr) <= 0) {
+    return r.dot(r) <= radius * radius ? std::min(1, no_step) : no_step;
+  }
+  double s1, s2;
+  if (!sphere_crossings(r, dr, radius, s1, s2)) {
+    return no_step;
+  }
+  const double j = std::max(1.0, std::ceil(s1));
+  return j <= s2 && j < no_step ? static_cast<int>(j) : no_step;
+}
+
+// first step j >= 1 whose interval [j - 1, j] comes within radius (or no_step)
+int first_interval_within(const Vec3 &r, const Vec3 &dr, double radius, int no_step) {
+  if (r.dot(r) <= radius * radius) {
+    return 1;
+  }
+  double s1, s2;
+  if (!sphere_crossings(r, dr, radius, s1, s2) || s1 < 0) {
+    return no_step;
+  }
+  const double j = std::max(1.0, std::ceil(s1));
+  return j < no_step ? static_cast<int>(j) : no_step;
+}
+
+} // namespace
+
 std::string FwEnvStats::to_string() const {
   return std::string("FwEnvStats(done_time=") + bool2str(done_time) +
     ",done_goal=" + bool2str(done_goal) +
     ",done_collision=" + bool2str(done_collision) +
     ",dist_to_goal1=" + std::to_string(dist_to_goal1) +
     ",dist_to_goal2=" + std::to_string(dist_to_goal2) +
-    ",dist_to_veh=" + std::to_string(dist_to_veh) + ")";
+    ",dist_to_veh=" + std::to_string(dist_to_veh) +
+    ",t_closest_approach=" + std::to_string(t_closest_approach) +
+    ",dist_closest_approach=" + std::to_string(dist_closest_approach) + ")";
 }
 
 FwCollisionEnv::FwCollisionEnv(
@@ -19,48 +90,272 @@ FwCollisionEnv::FwCollisionEnv(
   double safety_dist,
   const Point &goal1,
   const Point &goal2,
-  double time_warp) :
+  double time_warp,
+  bool continuous_collision) :
     dt_(dt), max_sim_time_(max_sim_time), done_dist_(done_dist),
     safety_dist_(safety_dist), goal1_(goal1), goal2_(goal2),
-    time_warp_(time_warp),
-    last_update_time_(std::chrono::high_resolution_clock::now()),
-    t_(0) {}
+    time_warp_(time_warp), continuous_collision_(continuous_collision),
+    step_deadline_(std::chrono::steady_clock::now()),
+    t_(0), t_prev_(0) {}
 
 bool FwCollisionEnv::step(const FwSingleAction &a1, const FwSingleAction &a2) {
-  if (time_warp_ > 0 and t_ > dt_ / 2) {
-    auto tgt_time = last_update_time_ +
-      std::chrono::duration<int, std::milli>(1000 * static_cast<int>(dt_ / time_warp_));
-    std::this_thread::sleep_for(tgt_time - std::chrono::high_resolution_clock::now());
-    last_update_time_ = std::chrono::high_resolution_clock::now();
+  return step(a1, a2, -1, -1);
+}
+
+bool FwCollisionEnv::step(
+    const FwSingleAction &a1, const FwSingleAction &a2,
+    int requested_idx, int executed_idx) {
+  FW_PROFILE_SCOPE(env_step);
+  FW_PROFILE_COUNT(env_steps, 1);
+  if (time_warp_ > 0) {
+    pace();
   }
+  t_prev_ = t_;
   t_ += dt_;
+  x1_prev_ = x1_;
+  x2_prev_ = x2_;
   fw_dynamics(dt_, a1, x1_);
   fw_dynamics(dt_, a2, x2_);
 
   update_stats();
+  record(&a1, &a2, requested_idx, executed_idx);
 
   return get_done();
 }
 
+void FwCollisionEnv::pace() {
+  using clock = std::chrono::steady_clock;
+  const auto period = std::chrono::duration_cast<clock::duration>(
+      std::chrono::duration<double>(dt_ / time_warp_));
+
+  // the first step after a reset is not delayed, whatever t it starts at
+  if (!paced_since_reset_) {
+    paced_since_reset_ = true;
+    step_deadline_ = clock::now();
+    return;
+  }
+
+  // absolute deadlines so oversleeping does not accumulate. A caller more
+  // than a step behind restarts the schedule instead of rushing steps.
+  step_deadline_ += period;
+  {
+    FW_PROFILE_SCOPE(time_warp_sleep);
+    std::this_thread::sleep_until(step_deadline_);
+  }
+  const auto now = clock::now();
+  if (now - step_deadline_ > period) {
+    step_deadline_ = now;
+  }
+}
+
+void FwCollisionEnv::set_shield(const BarrierGammaTurn &barrier) {
+  if (barrier.get_dt() != dt_) {
+    throw std::runtime_error("shield dt does not match that of FwCollisionEnv");
+  }
+  shield_ = barrier.clone();
+}
+
+std::tuple<bool, int, int, bool> FwCollisionEnv::step_shielded(int action_idx) {
+  if (!shield_) {
+    throw std::runtime_error("step_shielded requires a shield, see set_shield");
+  }
+
+  const FwActionIndex &index = shield_->get_action_index();
+  const FwAction requested = index.idx_to_action(action_idx);
+  const FwAction executed = shield_->filter_action(FwState{x1_, x2_}, requested);
+  const int executed_idx = index.action_to_idx(executed);
+
+  const bool done = step(executed.a1, executed.a2, action_idx, executed_idx);
+  return {done, action_idx, executed_idx, executed_idx != action_idx};
+}
+
+void FwCollisionEnv::set_recorder(std::shared_ptr<TrajectoryRecorder> recorder) {
+  if (!recorder) {
+    throw std::runtime_error("set_recorder requires a recorder");
+  }
+  const size_t stream = recorder->add_stream();
+  set_recorder(std::move(recorder), stream);
+}
+
+void FwCollisionEnv::set_recorder(
+    std::shared_ptr<TrajectoryRecorder> recorder, size_t stream) {
+  clear_recorder();
+  recorder_.recorder = std::move(recorder);
+  recorder_.stream = stream;
+}
+
+void FwCollisionEnv::clear_recorder() {
+  if (recorder_.recorder) {
+    // detaching from a closed recorder has no episode left to end
+    if (!recorder_.recorder->is_closed()) {
+      recorder_.recorder->end_episode(recorder_.stream);
+    }
+    recorder_.recorder.reset();
+  }
+}
+
+void FwCollisionEnv::record(
+    const FwSingleAction *a1, const FwSingleAction *a2,
+    int requested_idx, int executed_idx) {
+  if (!recorder_.recorder) {
+    return;
+  }
+
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  TrajectoryRow row {
+    t_,
+    {x1_.p.x, x1_.p.y, x1_.th, x1_.p.z, x2_.p.x, x2_.p.y, x2_.th, x2_.p.z},
+    {nan, nan, nan, nan, nan, nan},
+    requested_idx, executed_idx, requested_idx != executed_idx,
+    stats.dist_to_veh, stats.dist_to_goal1, stats.dist_to_goal2,
+    stats.dist_closest_approach,
+    stats.done_time, stats.done_goal, stats.done_collision};
+  if (a1 && a2) {
+    const double action[6] {a1->v, a1->w, a1->dz, a2->v, a2->w, a2->dz};
+    std::copy(action, action + 6, row.action);
+  }
+  recorder_.recorder->append(recorder_.stream, row);
+}
+
+std::tuple<bool, int, double> FwCollisionEnv::step_n(
+    const FwSingleAction &a1, const FwSingleAction &a2, int k) {
+  if (k < 1) {
+    throw std::runtime_error("step_n requires k >= 1");
+  }
+
+  int steps = 0;
+  double min_dist = std::numeric_limits<double>::infinity();
+  bool done = false;
+  if (time_warp_ <= 0 && !recorder_.recorder && a1.w == 0 && a2.w == 0) {
+    steps = advance_straight(a1, a2, k, min_dist);
+    done = get_done() || get_collided();
+  }
+
+  // turning actions, time_warp pacing and recording go step by step.
+  // This also finishes advance_straight when it stopped short of a done
+  // condition.
+  while (!done && steps < k) {
+    step(a1, a2);
+    steps++;
+    min_dist = std::min(min_dist, step_separation());
+    done = get_done() || get_collided();
+  }
+
+  return {done, steps, min_dist};
+}
+
+int FwCollisionEnv::advance_straight(
+    const FwSingleAction &a1, const FwSingleAction &a2, int k, double &min_dist) {
+
+  // with constant headings every step adds the same displacement, so the
+  // goal and collision conditions are quadratic in the step count
+  const Vec3 d1 = straight_step(dt_, a1, x1_);
+  const Vec3 d2 = straight_step(dt_, a2, x2_);
+  const Vec3 r = x1_.p - x2_.p;
+  const Vec3 dr {d1.x - d2.x, d1.y - d2.y, d1.z - d2.z};
+
+  // steps until done_time
+  int steps = k;
+  double t = t_;
+  for (int j = 1; j <= k; j++) {
+    t += dt_;
+    if (t >= max_sim_time_) {
+      steps = j;
+      break;
+    }
+  }
+
+  // the roots are only accurate to rounding, so the radii are padded to
+  // never stop after the step a loop over step would stop at. Stopping
+  // before it leaves step_n to finish with step.
+  auto pad = [&](const Vec3 &r0, const Vec3 &d, double radius) {
+    return radius + 1e-9 * (1 + radius + std::sqrt(r0.dot(r0)) + k * std::sqrt(d.dot(d)));
+  };
+  const Vec3 r1 = x1_.p - goal1_;
+  const Vec3 r2 = x2_.p - goal2_;
+  steps = first_step_within(r1, d1, pad(r1, d1, done_dist_), steps);
+  steps = first_step_within(r2, d2, pad(r2, d2, done_dist_), steps);
+  steps = continuous_collision_ ?
+    first_interval_within(r, dr, pad(r, dr, safety_dist_), steps) :
+    first_step_within(r, dr, pad(r, dr, safety_dist_), steps);
+
+  // replay the steps with the additions fw_dynamics makes, so states,
+  // times and separations are bit-identical to looping over step
+  auto advance = [](FwSingleState &x, const Vec3 &d) {
+    x.p.x += d.x;
+    x.p.y += d.y;
+    x.p.z += d.z;
+  };
+  for (int j = 0; j < steps; j++) {
+    t_prev_ = t_;
+    t_ += dt_;
+    x1_prev_ = x1_;
+    x2_prev_ = x2_;
+    advance(x1_, d1);
+    advance(x2_, d2);
+    update_separation();
+    min_dist = std::min(min_dist, step_separation());
+  }
+
+  update_stats();
+  return steps;
+}
+
 void FwCollisionEnv::update_stats() {
   stats.dist_to_goal1 = x1_.p.dist(goal1_);
   stats.dist_to_goal2 = x2_.p.dist(goal2_);
-  stats.dist_to_veh = x1_.p.dist(x2_.p);
+  update_separation();
 
   stats.done_time = t_ >= max_sim_time_;
-  stats.done_collision = stats.dist_to_veh <= safety_dist_;
+  stats.done_collision = continuous_collision_ ?
+    stats.dist_closest_approach <= safety_dist_ :
+    stats.dist_to_veh <= safety_dist_;
   stats.done_goal =
     stats.dist_to_goal1 <= done_dist_ ||
     stats.dist_to_goal2 <= done_dist_;
 }
 
+void FwCollisionEnv::update_separation() {
+  stats.dist_to_veh = x1_.p.dist(x2_.p);
+
+  // the relative position is linear in time over a step, so the closest
+  // approach is at the clamped minimum of a quadratic
+  const double rx = x1_prev_.p.x - x2_prev_.p.x;
+  const double ry = x1_prev_.p.y - x2_prev_.p.y;
+  const double rz = x1_prev_.p.z - x2_prev_.p.z;
+  const double drx = (x1_.p.x - x2_.p.x) - rx;
+  const double dry = (x1_.p.y - x2_.p.y) - ry;
+  const double drz = (x1_.p.z - x2_.p.z) - rz;
+  const double dr_sq = drx * drx + dry * dry + drz * drz;
+  double s = 1;
+  if (dr_sq > 0) {
+    s = std::clamp(-(rx * drx + ry * dry + rz * drz) / dr_sq, 0.0, 1.0);
+  }
+  if (s == 1) {
+    stats.dist_closest_approach = stats.dist_to_veh;
+  } else {
+    stats.dist_closest_approach = std::sqrt(
+        std::pow(rx + s * drx, 2) + std::pow(ry + s * dry, 2) +
+        std::pow(rz + s * drz, 2));
+  }
+  stats.t_closest_approach = t_ - (1 - s) * (t_ - t_prev_);
+}
+
 void FwCollisionEnv::reset(const FwSingleState &x1, const FwSingleState &x2, double t) {
   x1_ = x1;
   x2_ = x2;
+  x1_prev_ = x1;
+  x2_prev_ = x2;
   t_ = t;
-  last_update_time_ = std::chrono::high_resolution_clock::now();
+  t_prev_ = t;
+  step_deadline_ = std::chrono::steady_clock::now();
+  paced_since_reset_ = false;
 
   update_stats();
+  if (recorder_.recorder) {
+    recorder_.recorder->end_episode(recorder_.stream);
+    record(nullptr, nullptr, -1, -1);
+  }
 }
 
 std::string FwCollisionEnv::to_string() const {
@@ -70,6 +365,7 @@ std::string FwCollisionEnv::to_string() const {
     ", safety_dist=" + std::to_string(safety_dist_) +
     ", goal1=" + goal1_.to_string() +
     ", goal2=" + goal2_.to_string() +
-    ", time_warp=" + std::to_string(time_warp_) + ")";
+    ", time_warp=" + std::to_string(time_warp_) +
+    ", continuous_collision=" + bool2str(continuous_collision_) + ")";
 }
 } // namespace fw_coll_env
@@ -0,0 +1,340 @@
+#include <fw-coll-env/FwCollisionEnvBatch.h>
+#include <fw-coll-env/Profiler.h>
+
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+namespace {
+
+// reads vehicle veh (0 or 1) from row i of an (N, 8) state array
+template <typename Proxy>
+FwSingleState row_to_state(const Proxy &x, size_t i, size_t veh) {
+  const size_t c = 4 * veh;
+  return FwSingleState(Point(x(i, c), x(i, c + 1), x(i, c + 3)), x(i, c + 2));
+}
+
+} // namespace
+
+FwCollisionEnvBatch::FwCollisionEnvBatch(
+  const FwCollisionEnv &env, size_t num_envs,
+  const FwAvailActions &avail_actions,
+  size_t num_threads, size_t shard_size) :
+    envs_(num_envs, env),
+    avail_actions_(avail_actions),
+    uhat2_(env.get_goal2(), env.get_dt(), avail_actions),
+    shard_size_(shard_size),
+    pool_(std::make_unique<ThreadPool>(num_threads)) {
+
+  if (shard_size_ == 0) {
+    throw std::runtime_error("shard_size must be positive");
+  }
+  if (env.get_time_warp() > 0) {
+    throw std::runtime_error("FwCollisionEnvBatch does not support time_warp");
+  }
+
+  // the copies would share one barrier across threads
+  if (env.has_shield()) {
+    set_shield(*env.get_shield());
+    for (auto &e : envs_) {
+      e.clear_shield();
+    }
+  }
+  // copies are not attached to the recorder
+  if (env.has_recorder()) {
+    set_recorder(env.get_recorder());
+  }
+}
+
+void FwCollisionEnvBatch::set_recorder(std::shared_ptr<TrajectoryRecorder> recorder) {
+  for (auto &e : envs_) {
+    e.set_recorder(recorder);
+  }
+}
+
+void FwCollisionEnvBatch::clear_recorder() {
+  for (auto &e : envs_) {
+    e.clear_recorder();
+  }
+}
+
+void FwCollisionEnvBatch::set_shield(const BarrierGammaTurn &barrier, bool single_precision) {
+  if (!(barrier.get_avail_actions().get_all_actions() == avail_actions_.get_all_actions())) {
+    throw std::runtime_error(
+        "shield avail_actions do not match those of FwCollisionEnvBatch");
+  }
+  if (barrier.get_dt() != uhat2_.get_dt()) {
+    throw std::runtime_error("shield dt does not match that of FwCollisionEnvBatch");
+  }
+
+  shield_ = barrier.clone();
+  single_precision_ = single_precision;
+}
+
+void FwCollisionEnvBatch::check_rows(
+    const pybind11::array_t<double> &x, const char *name) const {
+  if (x.ndim() != 2 || static_cast<size_t>(x.shape(0)) != envs_.size() ||
+      x.shape(1) != 8) {
+    throw std::runtime_error(
+        std::string("invalid shape given for ") + name + " in FwCollisionEnvBatch");
+  }
+}
+
+void FwCollisionEnvBatch::check_actions(const pybind11::array_t<int> &a1_idx) const {
+  if (a1_idx.ndim() != 1 || static_cast<size_t>(a1_idx.shape(0)) != envs_.size()) {
+    throw std::runtime_error("invalid shape given for a1_idx in FwCollisionEnvBatch");
+  }
+
+  const size_t num_actions = avail_actions_.get_all_actions().size();
+  auto _a1_idx = a1_idx.unchecked<1>();
+  for (size_t i = 0; i < envs_.size(); i++) {
+    if (_a1_idx(i) < 0 || static_cast<size_t>(_a1_idx(i)) >= num_actions) {
+      throw std::runtime_error("idx too large for all_actions");
+    }
+  }
+}
+
+void FwCollisionEnvBatch::reset(pybind11::array_t<double> x, double t) {
+  check_rows(x, "x");
+  auto _x = x.unchecked<2>();
+  for (size_t i = 0; i < envs_.size(); i++) {
+    envs_[i].reset(row_to_state(_x, i, 0), row_to_state(_x, i, 1), t);
+  }
+}
+
+pybind11::array_t<bool> FwCollisionEnvBatch::step(
+    pybind11::array_t<int> a1_idx,
+    std::optional<pybind11::array_t<double>> reset_x) {
+  FW_PROFILE_SCOPE(env_batch_step);
+
+  check_actions(a1_idx);
+  const size_t n = envs_.size();
+  const auto &all_actions = avail_actions_.get_all_actions();
+  auto _a1_idx = a1_idx.unchecked<1>();
+
+  std::optional<decltype(reset_x->unchecked<2>())> _reset_x;
+  if (reset_x) {
+    check_rows(*reset_x, "reset_x");
+    _reset_x.emplace(reset_x->unchecked<2>());
+  }
+
+  pybind11::array_t<bool> done {static_cast<pybind11::ssize_t>(n)};
+  auto _done = done.mutable_unchecked<1>();
+
+  {
+    pybind11::gil_scoped_release release;
+    pool_->run(num_shards(), [&](size_t shard) {
+      const size_t end = std::min(n, (shard + 1) * shard_size_);
+      for (size_t i = shard * shard_size_; i < end; i++) {
+        FwCollisionEnv &env = envs_[i];
+        const FwSingleAction a2 = uhat2_.calc(env.get_x2());
+        env.step(all_actions[_a1_idx(i)], a2);
+        _done(i) = env.get_done() || env.get_collided();
+
+        if (_done(i) && _reset_x) {
+          env.reset(row_to_state(*_reset_x, i, 0), row_to_state(*_reset_x, i, 1), 0);
+        }
+      }
+    });
+  }
+
+  return done;
+}
+
+std::tuple<pybind11::array_t<bool>, pybind11::array_t<int>, pybind11::array_t<double>>
+FwCollisionEnvBatch::step_n(
+    pybind11::array_t<int> a1_idx, int k,
+    std::optional<pybind11::array_t<double>> reset_x) {
+  FW_PROFILE_SCOPE(env_batch_step);
+
+  if (k < 1) {
+    throw std::runtime_error("step_n requires k >= 1");
+  }
+  check_actions(a1_idx);
+  const size_t n = envs_.size();
+  const auto &all_actions = avail_actions_.get_all_actions();
+  auto _a1_idx = a1_idx.unchecked<1>();
+
+  std::optional<decltype(reset_x->unchecked<2>())> _reset_x;
+  if (reset_x) {
+    check_rows(*reset_x, "reset_x");
+    _reset_x.emplace(reset_x->unchecked<2>());
+  }
+
+  const auto num_rows = static_cast<pybind11::ssize_t>(n);
+  pybind11::array_t<bool> done {num_rows};
+  pybind11::array_t<int> steps {num_rows};
+  pybind11::array_t<double> min_dist {num_rows};
+  auto _done = done.mutable_unchecked<1>();
+  auto _steps = steps.mutable_unchecked<1>();
+  auto _min_dist = min_dist.mutable_unchecked<1>();
+
+  {
+    pybind11::gil_scoped_release release;
+    pool_->run(num_shards(), [&](size_t shard) {
+      const size_t end = std::min(n, (shard + 1) * shard_size_);
+      for (size_t i = shard * shard_size_; i < end; i++) {
+        FwCollisionEnv &env = envs_[i];
+        const FwSingleAction &a1 = all_actions[_a1_idx(i)];
+
+        // vehicle 2 re-plans with Uhat every step so there is no closed form
+        bool env_done = false;
+        int env_steps = 0;
+        double env_min_dist = std::numeric_limits<double>::infinity();
+        while (!env_done && env_steps < k) {
+          env.step(a1, uhat2_.calc(env.get_x2()));
+          env_steps++;
+          env_min_dist = std::min(env_min_dist,
+              env.get_continuous_collision() ?
+                env.stats.dist_closest_approach : env.stats.dist_to_veh);
+          env_done = env.get_done() || env.get_collided();
+        }
+        _done(i) = env_done;
+        _steps(i) = env_steps;
+        _min_dist(i) = env_min_dist;
+
+        if (env_done && _reset_x) {
+          env.reset(row_to_state(*_reset_x, i, 0), row_to_state(*_reset_x, i, 1), 0);
+        }
+      }
+    });
+  }
+
+  return {done, steps, min_dist};
+}
+
+std::tuple<pybind11::array_t<bool>, pybind11::array_t<int>,
+           pybind11::array_t<int>, pybind11::array_t<bool>>
+FwCollisionEnvBatch::step_shielded(
+    pybind11::array_t<int> a1_idx,
+    std::optional<pybind11::array_t<double>> reset_x) {
+  FW_PROFILE_SCOPE(env_batch_step);
+
+  if (!shield_) {
+    throw std::runtime_error("step_shielded requires a shield, see set_shield");
+  }
+  check_actions(a1_idx);
+  const size_t n = envs_.size();
+  const auto &all_actions = avail_actions_.get_all_actions();
+  auto _a1_idx = a1_idx.unchecked<1>();
+
+  std::optional<decltype(reset_x->unchecked<2>())> _reset_x;
+  if (reset_x) {
+    check_rows(*reset_x, "reset_x");
+    _reset_x.emplace(reset_x->unchecked<2>());
+  }
+
+  const auto num_rows = static_cast<pybind11::ssize_t>(n);
+  pybind11::array_t<bool> done {num_rows};
+  pybind11::array_t<int> requested {num_rows};
+  pybind11::array_t<int> executed {num_rows};
+  pybind11::array_t<bool> overridden {num_rows};
+  auto _done = done.mutable_unchecked<1>();
+  auto _requested = requested.mutable_unchecked<1>();
+  auto _executed = executed.mutable_unchecked<1>();
+  auto _overridden = overridden.mutable_unchecked<1>();
+
+  {
+    pybind11::gil_scoped_release release;
+    pool_->run(num_shards(), [&](size_t shard) {
+      const BarrierGammaTurn &shield = *shield_;
+      const FwActionIndex &index = shield.get_action_index();
+
+      const size_t end = std::min(n, (shard + 1) * shard_size_);
+      for (size_t i = shard * shard_size_; i < end; i++) {
+        FwCollisionEnv &env = envs_[i];
+        const FwAction ac {all_actions[_a1_idx(i)], uhat2_.calc(env.get_x2())};
+        const FwState x {env.get_x1(), env.get_x2()};
+        _requested(i) = index.action_to_idx(ac);
+        const FwAction safe_ac = single_precision_ ?
+          index.idx_to_action(shield.filter_action_f32(FwStateT<float>(x), _requested(i))) :
+          shield.filter_action(x, ac);
+        _executed(i) = index.action_to_idx(safe_ac);
+        _overridden(i) = _executed(i) != _requested(i);
+        env.step(safe_ac.a1, safe_ac.a2, _requested(i), _executed(i));
+        _done(i) = env.get_done() || env.get_collided();
+
+        if (_done(i) && _reset_x) {
+          env.reset(row_to_state(*_reset_x, i, 0), row_to_state(*_reset_x, i, 1), 0);
+        }
+      }
+    });
+  }
+
+  return {done, requested, executed, overridden};
+}
+
+pybind11::array_t<double> FwCollisionEnvBatch::get_states() const {
+  pybind11::array_t<double> out {
+    {static_cast<pybind11::ssize_t>(envs_.size()), pybind11::ssize_t(8)}};
+  auto _out = out.mutable_unchecked<2>();
+  for (size_t i = 0; i < envs_.size(); i++) {
+    const FwSingleState &x1 = envs_[i].get_x1();
+    const FwSingleState &x2 = envs_[i].get_x2();
+    _out(i, 0) = x1.p.x;
+    _out(i, 1) = x1.p.y;
+    _out(i, 2) = x1.th;
+    _out(i, 3) = x1.p.z;
+    _out(i, 4) = x2.p.x;
+    _out(i, 5) = x2.p.y;
+    _out(i, 6) = x2.th;
+    _out(i, 7) = x2.p.z;
+  }
+  return out;
+}
+
+namespace {
+
+template <typename T, typename F>
+pybind11::array_t<T> per_env(const std::vector<FwCollisionEnv> &envs, F f) {
+  pybind11::array_t<T> out {static_cast<pybind11::ssize_t>(envs.size())};
+  auto _out = out.template mutable_unchecked<1>();
+  for (size_t i = 0; i < envs.size(); i++) {
+    _out(i) = f(envs[i]);
+  }
+  return out;
+}
+
+} // namespace
+
+pybind11::array_t<double> FwCollisionEnvBatch::get_t() const {
+  return per_env<double>(envs_, [](const FwCollisionEnv &e) {return e.get_t();});
+}
+
+pybind11::array_t<bool> FwCollisionEnvBatch::get_done() const {
+  return per_env<bool>(envs_, [](const FwCollisionEnv &e) {return e.get_done();});
+}
+
+pybind11::array_t<bool> FwCollisionEnvBatch::get_collided() const {
+  return per_env<bool>(envs_, [](const FwCollisionEnv &e) {return e.get_collided();});
+}
+
+pybind11::array_t<double> FwCollisionEnvBatch::get_dist_to_veh() const {
+  return per_env<double>(
+      envs_, [](const FwCollisionEnv &e) {return e.stats.dist_to_veh;});
+}
+
+pybind11::array_t<double> FwCollisionEnvBatch::get_dist_to_goal1() const {
+  return per_env<double>(
+      envs_, [](const FwCollisionEnv &e) {return e.stats.dist_to_goal1;});
+}
+
+pybind11::array_t<double> FwCollisionEnvBatch::get_dist_to_goal2() const {
+  return per_env<double>(
+      envs_, [](const FwCollisionEnv &e) {return e.stats.dist_to_goal2;});
+}
+
+const FwCollisionEnv &FwCollisionEnvBatch::get_env(size_t i) const {
+  if (i >= envs_.size()) {
+    throw std::runtime_error("env index out of range in FwCollisionEnvBatch");
+  }
+  return envs_[i];
+}
+
+std::string FwCollisionEnvBatch::to_string() const {
+  return std::string("FwCollisionEnvBatch(num_envs=") + std::to_string(envs_.size()) +
+    ", num_threads=" + std::to_string(pool_->get_num_threads()) +
+    ", shard_size=" + std::to_string(shard_size_) + ")";
+}
+} // namespace fw_coll_env
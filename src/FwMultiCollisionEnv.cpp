@@ -0,0 +1,211 @@
+#include <fw-coll-env/FwMultiCollisionEnv.h>
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+namespace {
+
+template <typename T, typename V>
+pybind11::array_t<T> to_array(const std::vector<V> &vals) {
+  pybind11::array_t<T> out {static_cast<pybind11::ssize_t>(vals.size())};
+  auto _out = out.template mutable_unchecked<1>();
+  for (size_t i = 0; i < vals.size(); i++) {
+    _out(i) = vals[i];
+  }
+  return out;
+}
+
+} // namespace
+
+FwMultiCollisionEnv::FwMultiCollisionEnv(
+    double dt, double max_sim_time, double done_dist, double safety_dist,
+    const FwAvailActions &avail_actions) :
+      dt_(dt), max_sim_time_(max_sim_time), done_dist_(done_dist),
+      safety_dist_(safety_dist), avail_actions_(avail_actions),
+      grid_(safety_dist) {}
+
+void FwMultiCollisionEnv::reset(
+    const std::vector<FwSingleState> &x, const std::vector<Point> &goals, double t) {
+  if (x.size() != goals.size()) {
+    throw std::runtime_error("FwMultiCollisionEnv needs one goal per aircraft");
+  }
+
+  const size_t n = x.size();
+  x_ = x;
+  goals_ = goals;
+  t_ = t;
+  active_.assign(n, true);
+  goal_reached_.assign(n, false);
+  collided_.assign(n, false);
+  dist_to_goal_.assign(n, std::numeric_limits<double>::quiet_NaN());
+  nearest_.assign(n, -1);
+  dist_nearest_.assign(n, std::numeric_limits<double>::infinity());
+  min_sep_.assign(n, std::numeric_limits<double>::infinity());
+  num_active_ = n;
+
+  update_stats();
+}
+
+void FwMultiCollisionEnv::reset(
+    pybind11::array_t<double> x, pybind11::array_t<double> goals, double t) {
+  if (x.ndim() != 2 || x.shape(1) != 4) {
+    throw std::runtime_error("invalid shape given for x in FwMultiCollisionEnv");
+  }
+  if (goals.ndim() != 2 || goals.shape(1) != 3 || goals.shape(0) != x.shape(0)) {
+    throw std::runtime_error("invalid shape given for goals in FwMultiCollisionEnv");
+  }
+
+  auto _x = x.unchecked<2>();
+  auto _goals = goals.unchecked<2>();
+  std::vector<FwSingleState> states;
+  std::vector<Point> goal_pts;
+  for (pybind11::ssize_t i = 0; i < x.shape(0); i++) {
+    states.emplace_back(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2));
+    goal_pts.emplace_back(_goals(i, 0), _goals(i, 1), _goals(i, 2));
+  }
+  reset(states, goal_pts, t);
+}
+
+bool FwMultiCollisionEnv::step(const std::vector<FwSingleAction> &actions) {
+  if (actions.size() != x_.size()) {
+    throw std::runtime_error("FwMultiCollisionEnv needs one action per aircraft");
+  }
+
+  t_ += dt_;
+  for (size_t i = 0; i < x_.size(); i++) {
+    if (active_[i]) {
+      fw_dynamics(dt_, actions[i], x_[i]);
+    }
+  }
+
+  update_stats();
+  return get_done();
+}
+
+bool FwMultiCollisionEnv::step(pybind11::array_t<int> a_idx) {
+  if (a_idx.ndim() != 1 || static_cast<size_t>(a_idx.shape(0)) != x_.size()) {
+    throw std::runtime_error("invalid shape given for a_idx in FwMultiCollisionEnv");
+  }
+
+  const auto &all_actions = avail_actions_.get_all_actions();
+  auto _a_idx = a_idx.unchecked<1>();
+  std::vector<FwSingleAction> actions;
+  actions.reserve(x_.size());
+  for (size_t i = 0; i < x_.size(); i++) {
+    if (_a_idx(i) < 0 || static_cast<size_t>(_a_idx(i)) >= all_actions.size()) {
+      throw std::runtime_error("idx too large for all_actions");
+    }
+    actions.push_back(all_actions[_a_idx(i)]);
+  }
+  return step(actions);
+}
+
+void FwMultiCollisionEnv::update_stats() {
+  const size_t n = x_.size();
+  points_.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    points_[i] = x_[i].p;
+  }
+
+  // aircraft that were active at the start of the step can still
+  // collide with each other during it
+  grid_.build(points_, active_);
+  pairs_.clear();
+  grid_.pairs_within(safety_dist_, pairs_);
+  for (const auto &pair : pairs_) {
+    collided_[pair.first] = true;
+    collided_[pair.second] = true;
+  }
+
+  for (size_t i = 0; i < n; i++) {
+    if (!active_[i]) {
+      nearest_[i] = -1;
+      dist_nearest_[i] = std::numeric_limits<double>::infinity();
+      continue;
+    }
+
+    dist_to_goal_[i] = x_[i].p.dist(goals_[i]);
+    goal_reached_[i] = dist_to_goal_[i] <= done_dist_;
+    nearest_[i] = grid_.nearest(i, dist_nearest_[i]);
+    min_sep_[i] = std::min(min_sep_[i], dist_nearest_[i]);
+  }
+
+  const size_t num_active_before = num_active_;
+  num_active_ = 0;
+  for (size_t i = 0; i < n; i++) {
+    active_[i] = active_[i] && !goal_reached_[i] && !collided_[i];
+    num_active_ += active_[i];
+  }
+
+  // keep the grid to the active aircraft for pairs_within
+  if (num_active_ != num_active_before) {
+    grid_.build(points_, active_);
+  }
+}
+
+pybind11::array_t<int> FwMultiCollisionEnv::pairs_within(double radius) const {
+  std::vector<std::pair<int, int>> pairs;
+  grid_.pairs_within(radius, pairs);
+
+  pybind11::array_t<int> out {
+    {static_cast<pybind11::ssize_t>(pairs.size()), pybind11::ssize_t(2)}};
+  auto _out = out.mutable_unchecked<2>();
+  for (size_t k = 0; k < pairs.size(); k++) {
+    _out(k, 0) = pairs[k].first;
+    _out(k, 1) = pairs[k].second;
+  }
+  return out;
+}
+
+size_t FwMultiCollisionEnv::get_num_collided() const {
+  return std::count(collided_.begin(), collided_.end(), true);
+}
+
+pybind11::array_t<double> FwMultiCollisionEnv::get_states() const {
+  pybind11::array_t<double> out {
+    {static_cast<pybind11::ssize_t>(x_.size()), pybind11::ssize_t(4)}};
+  auto _out = out.mutable_unchecked<2>();
+  for (size_t i = 0; i < x_.size(); i++) {
+    _out(i, 0) = x_[i].p.x;
+    _out(i, 1) = x_[i].p.y;
+    _out(i, 2) = x_[i].th;
+    _out(i, 3) = x_[i].p.z;
+  }
+  return out;
+}
+
+pybind11::array_t<bool> FwMultiCollisionEnv::get_goal_reached() const {
+  return to_array<bool>(goal_reached_);
+}
+
+pybind11::array_t<bool> FwMultiCollisionEnv::get_collided() const {
+  return to_array<bool>(collided_);
+}
+
+pybind11::array_t<double> FwMultiCollisionEnv::get_dist_to_goal() const {
+  return to_array<double>(dist_to_goal_);
+}
+
+pybind11::array_t<int> FwMultiCollisionEnv::get_nearest() const {
+  return to_array<int>(nearest_);
+}
+
+pybind11::array_t<double> FwMultiCollisionEnv::get_dist_nearest() const {
+  return to_array<double>(dist_nearest_);
+}
+
+pybind11::array_t<double> FwMultiCollisionEnv::get_min_sep() const {
+  return to_array<double>(min_sep_);
+}
+
+std::string FwMultiCollisionEnv::to_string() const {
+  return std::string("FwMultiCollisionEnv(dt=") + std::to_string(dt_) +
+    ", max_sim_time=" + std::to_string(max_sim_time_) +
+    ", done_dist=" + std::to_string(done_dist_) +
+    ", safety_dist=" + std::to_string(safety_dist_) +
+    ", num_aircraft=" + std::to_string(x_.size()) + ")";
+}
+} // namespace fw_coll_env
@@ -0,0 +1,87 @@
+#include <fw-coll-env/MappedFile.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+MappedFile::MappedFile(const std::string &path, bool write, size_t size) : path_(path) {
+  fd_ = write ? ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644) :
+                ::open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    fail("could not open");
+  }
+
+  if (write) {
+    if (::ftruncate(fd_, size) != 0) {
+      fail("could not resize");
+    }
+    size_ = size;
+  } else {
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+      fail("could not stat");
+    }
+    size_ = st.st_size;
+  }
+
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, write ? PROT_READ | PROT_WRITE : PROT_READ,
+                   MAP_SHARED, fd_, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      fail("could not mmap");
+    }
+  }
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    ::munmap(data_, size_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void MappedFile::advise(size_t begin, size_t end, int advice) const {
+  if (!data_ || begin >= end) {
+    return;
+  }
+  const size_t first = page_start(begin);
+  ::madvise(static_cast<char *>(data_) + first, std::min(end, size_) - first, advice);
+}
+
+void MappedFile::sync(size_t begin, size_t end, int flags) const {
+  if (!data_ || begin >= end) {
+    return;
+  }
+  const size_t first = page_start(begin);
+  if (::msync(static_cast<char *>(data_) + first, std::min(end, size_) - first,
+              flags) != 0) {
+    throw std::runtime_error("could not msync " + path_);
+  }
+}
+
+size_t MappedFile::page_start(size_t offset) {
+  const size_t page = ::sysconf(_SC_PAGESIZE);
+  return offset / page * page;
+}
+
+void MappedFile::fail(const char *what) {
+  const std::string msg =
+    std::string(what) + " " + path_ + ": " + std::strerror(errno);
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  throw std::runtime_error(msg);
+}
+} // namespace fw_coll_env
@@ -0,0 +1,383 @@
+#include <fw-coll-env/MpcPlanner.h>
+#include <fw-coll-env/Profiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <utility>
+
+namespace fw_coll_env {
+
+std::string MpcConfig::to_string() const {
+  return std::string("MpcConfig(method=") + method +
+    ", num_samples=" + std::to_string(num_samples) +
+    ", horizon=" + std::to_string(horizon) +
+    ", num_iters=" + std::to_string(num_iters) +
+    ", continuous=" + bool2str(continuous) + ")";
+}
+
+MpcPlanner::MpcPlanner(
+  const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+  const MpcConfig &config, size_t num_threads, uint64_t seed) :
+    config_(config),
+    cem_(config.method == "cem"),
+    dt_(env.get_dt()),
+    safety_dist_(env.get_safety_dist()),
+    uhat1_(env.get_goal1(), env.get_dt(), avail_actions),
+    uhat2_(env.get_goal2(), env.get_dt(), avail_actions),
+    all_actions_(avail_actions.get_all_actions()),
+    pool_(std::make_unique<ThreadPool>(num_threads)),
+    rng_(seed) {
+
+  if (config_.method != "mppi" && config_.method != "cem") {
+    throw std::runtime_error("method must be \"mppi\" or \"cem\", got " + config_.method);
+  }
+  if (config_.num_samples == 0 || config_.horizon == 0 || config_.num_iters == 0) {
+    throw std::runtime_error("num_samples, horizon and num_iters must be positive");
+  }
+  if (config_.temperature <= 0) {
+    throw std::runtime_error("temperature must be positive");
+  }
+  if (config_.elite_frac <= 0 || config_.elite_frac > 1) {
+    throw std::runtime_error("elite_frac must be in (0, 1]");
+  }
+  if (config_.noise_frac < 0 || (!config_.continuous && config_.noise_frac > 1)) {
+    throw std::runtime_error("noise_frac must be non-negative, and at most 1 for discrete");
+  }
+  if (config_.smoothing < 0 || config_.smoothing >= 1) {
+    throw std::runtime_error("smoothing must be in [0, 1)");
+  }
+  if (all_actions_.empty()) {
+    throw std::runtime_error("avail_actions is empty");
+  }
+
+  for (size_t d = 0; d < 3; d++) {
+    lo_[d] = std::numeric_limits<double>::infinity();
+    hi_[d] = -std::numeric_limits<double>::infinity();
+  }
+  for (const auto &ac : all_actions_) {
+    const double vals[3] {ac.v, ac.w, ac.dz};
+    for (size_t d = 0; d < 3; d++) {
+      lo_[d] = std::min(lo_[d], vals[d]);
+      hi_[d] = std::max(hi_[d], vals[d]);
+    }
+  }
+
+  const size_t h = config_.horizon;
+  const size_t k = config_.num_samples;
+  mean_.resize(h * 3);
+  std_.resize(h * 3);
+  probs_.resize(h * all_actions_.size());
+  v_.resize(h * k);
+  w_.resize(h * k);
+  dz_.resize(h * k);
+  idx_.resize(h * k);
+  costs_.resize(k);
+  x1_.resize(k);
+  y1_.resize(k);
+  th1_.resize(k);
+  z1_.resize(k);
+  traj2_.resize(h + 1);
+}
+
+void MpcPlanner::set_barrier(const BarrierGammaTurn &barrier) {
+  std::shared_ptr<const BarrierGammaTurn> clone = barrier.clone();
+  std::lock_guard<std::mutex> lock(mutex_);
+  barrier_ = std::move(clone);
+}
+
+void MpcPlanner::clear_barrier() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  barrier_.reset();
+}
+
+bool MpcPlanner::has_barrier() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return barrier_ != nullptr;
+}
+
+void MpcPlanner::reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  warm_ = false;
+}
+
+void MpcPlanner::init_distribution(const FwSingleState &x1) {
+  // Uhat to goal1 ignoring vehicle 2
+  const size_t num = all_actions_.size();
+  FwSingleState x = x1;
+  std::fill(probs_.begin(), probs_.end(), 0);
+  for (size_t t = 0; t < config_.horizon; t++) {
+    const FwSingleAction ac = uhat1_.calc(x);
+    mean_[t * 3] = ac.v;
+    mean_[t * 3 + 1] = ac.w;
+    mean_[t * 3 + 2] = ac.dz;
+
+    size_t closest = 0;
+    for (size_t a = 1; a < num; a++) {
+      if (all_actions_[a].dist(ac) < all_actions_[closest].dist(ac)) {
+        closest = a;
+      }
+    }
+    probs_[t * num + closest] = 1;
+    fw_dynamics(dt_, ac, x);
+  }
+}
+
+void MpcPlanner::shift_distribution() {
+  // the last step is repeated
+  if (config_.horizon > 1) {
+    std::copy(mean_.begin() + 3, mean_.end(), mean_.begin());
+    std::copy(probs_.begin() + all_actions_.size(), probs_.end(), probs_.begin());
+  }
+}
+
+void MpcPlanner::sample() {
+  const size_t h = config_.horizon;
+  const size_t k = config_.num_samples;
+  const size_t num = all_actions_.size();
+
+  if (config_.continuous) {
+    std::normal_distribution<double> noise;
+    for (size_t t = 0; t < h; t++) {
+      for (size_t i = 0; i < k; i++) {
+        double vals[3];
+        for (size_t d = 0; d < 3; d++) {
+          const double m = mean_[t * 3 + d];
+          vals[d] = i == 0 ? m : std::clamp(m + std_[t * 3 + d] * noise(rng_), lo_[d], hi_[d]);
+        }
+        v_[t * k + i] = vals[0];
+        w_[t * k + i] = vals[1];
+        dz_[t * k + i] = vals[2];
+      }
+    }
+    return;
+  }
+
+  for (size_t t = 0; t < h; t++) {
+    const auto first = probs_.begin() + t * num;
+    std::discrete_distribution<int> dist(first, first + num);
+    for (size_t i = 0; i < k; i++) {
+      const int a = i == 0 ? std::max_element(first, first + num) - first : dist(rng_);
+      idx_[t * k + i] = a;
+      v_[t * k + i] = all_actions_[a].v;
+      w_[t * k + i] = all_actions_[a].w;
+      dz_[t * k + i] = all_actions_[a].dz;
+    }
+  }
+}
+
+void MpcPlanner::rollout_shard(size_t shard, const FwSingleState &x1) {
+  const size_t h = config_.horizon;
+  const size_t k = config_.num_samples;
+  const size_t begin = shard * shard_size_;
+  const size_t end = std::min(k, begin + shard_size_);
+  const Point &goal1 = uhat1_.get_goal();
+
+  for (size_t i = begin; i < end; i++) {
+    x1_[i] = x1.p.x;
+    y1_[i] = x1.p.y;
+    th1_[i] = x1.th;
+    z1_[i] = x1.p.z;
+    costs_[i] = 0;
+  }
+
+  // steps are the outer loop so the inner loop runs over contiguous
+  // samples of one step
+  for (size_t t = 0; t < h; t++) {
+    const Point &p2 = traj2_[t + 1].p;
+    for (size_t i = begin; i < end; i++) {
+      // fw_dynamics on the SoA state
+      const size_t s = t * k + i;
+      x1_[i] += v_[s] * std::cos(th1_[i]) * dt_;
+      y1_[i] += v_[s] * std::sin(th1_[i]) * dt_;
+      th1_[i] += w_[s] * dt_;
+      z1_[i] += dz_[s] * dt_;
+
+      const Point p1(x1_[i], y1_[i], z1_[i]);
+      double cost = config_.goal_weight * p1.dist(goal1) / h;
+      if (p1.dist(p2) < safety_dist_) {
+        cost += config_.collision_cost;
+      }
+      costs_[i] += cost;
+    }
+  }
+
+  if (barrier_) {
+    for (size_t i = begin; i < end; i++) {
+      const FwState x(FwSingleState(Point(x1_[i], y1_[i], z1_[i]), th1_[i]), traj2_[h]);
+      costs_[i] += config_.barrier_weight * std::max(0.0, -barrier_->calc_h(x));
+    }
+  }
+  FW_PROFILE_COUNT(mpc_rollouts, end - begin);
+  FW_PROFILE_COUNT(mpc_rollout_steps, (end - begin) * h);
+}
+
+void MpcPlanner::refit() {
+  const size_t h = config_.horizon;
+  const size_t k = config_.num_samples;
+  const size_t num = all_actions_.size();
+
+  std::vector<double> weights(k, 0);
+  if (cem_) {
+    // uniform over the elites, ties go to the lower sample
+    std::vector<size_t> order(k);
+    std::iota(order.begin(), order.end(), 0);
+    const size_t num_elites = std::max<size_t>(1, std::lround(config_.elite_frac * k));
+    std::partial_sort(
+        order.begin(), order.begin() + num_elites, order.end(),
+        [&](size_t a, size_t b) {
+          return costs_[a] < costs_[b] || (costs_[a] == costs_[b] && a < b);
+        });
+    for (size_t e = 0; e < num_elites; e++) {
+      weights[order[e]] = 1.0 / num_elites;
+    }
+  } else {
+    // shifted by the min cost so the best sample has weight 1
+    const double min_cost = *std::min_element(costs_.begin(), costs_.end());
+    double total = 0;
+    for (size_t i = 0; i < k; i++) {
+      weights[i] = std::exp(-(costs_[i] - min_cost) / config_.temperature);
+      total += weights[i];
+    }
+    for (auto &w : weights) {
+      w /= total;
+    }
+  }
+
+  if (config_.continuous) {
+    const std::vector<double> *samples[3] {&v_, &w_, &dz_};
+    for (size_t t = 0; t < h; t++) {
+      for (size_t d = 0; d < 3; d++) {
+        const double *vals = samples[d]->data() + t * k;
+        double mean = 0;
+        for (size_t i = 0; i < k; i++) {
+          mean += weights[i] * vals[i];
+        }
+        if (cem_) {
+          double var = 0;
+          for (size_t i = 0; i < k; i++) {
+            var += weights[i] * (vals[i] - mean) * (vals[i] - mean);
+          }
+          std_[t * 3 + d] = std::sqrt(var);
+        }
+        mean_[t * 3 + d] = mean;
+      }
+    }
+    return;
+  }
+
+  std::vector<double> fit(num);
+  for (size_t t = 0; t < h; t++) {
+    std::fill(fit.begin(), fit.end(), 0);
+    for (size_t i = 0; i < k; i++) {
+      fit[idx_[t * k + i]] += weights[i];
+    }
+    for (size_t a = 0; a < num; a++) {
+      double &p = probs_[t * num + a];
+      p = config_.smoothing * p + (1 - config_.smoothing) * fit[a];
+    }
+  }
+}
+
+FwSingleAction MpcPlanner::planned(size_t t) const {
+  if (config_.continuous) {
+    return FwSingleAction(mean_[t * 3], mean_[t * 3 + 1], mean_[t * 3 + 2]);
+  }
+  const size_t num = all_actions_.size();
+  const auto first = probs_.begin() + t * num;
+  return all_actions_[std::max_element(first, first + num) - first];
+}
+
+FwSingleAction MpcPlanner::plan(const FwSingleState &x1, const FwSingleState &x2) {
+  FW_PROFILE_SCOPE(mpc_plan);
+  pybind11::gil_scoped_release release;
+  // taken without the GIL, so a thread waiting for it cannot block this one
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  if (warm_) {
+    shift_distribution();
+  } else {
+    init_distribution(x1);
+  }
+  // CEM narrows the distribution, so every plan starts from the same spread
+  if (config_.continuous) {
+    for (size_t t = 0; t < config_.horizon; t++) {
+      for (size_t d = 0; d < 3; d++) {
+        std_[t * 3 + d] = config_.noise_frac * (hi_[d] - lo_[d]);
+      }
+    }
+  } else {
+    const double uniform = config_.noise_frac / all_actions_.size();
+    for (auto &p : probs_) {
+      p = (1 - config_.noise_frac) * p + uniform;
+    }
+  }
+
+  traj2_[0] = x2;
+  for (size_t t = 0; t < config_.horizon; t++) {
+    traj2_[t + 1] = traj2_[t];
+    fw_dynamics(dt_, uhat2_.calc(traj2_[t]), traj2_[t + 1]);
+  }
+
+  for (size_t iter = 0; iter < config_.num_iters; iter++) {
+    sample();
+    pool_->run(num_shards(), [&](size_t shard) {rollout_shard(shard, x1);});
+    refit();
+  }
+  warm_ = true;
+  return planned(0);
+}
+
+int MpcPlanner::plan_idx(const FwSingleState &x1, const FwSingleState &x2) {
+  const FwSingleAction ac = plan(x1, x2);
+  int closest = 0;
+  for (size_t a = 1; a < all_actions_.size(); a++) {
+    if (all_actions_[a].dist(ac) < all_actions_[closest].dist(ac)) {
+      closest = a;
+    }
+  }
+  return closest;
+}
+
+pybind11::array_t<double> MpcPlanner::get_plan() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const auto h = static_cast<pybind11::ssize_t>(config_.horizon);
+  pybind11::array_t<double> out({h, pybind11::ssize_t(3)});
+  auto _out = out.mutable_unchecked<2>();
+  for (pybind11::ssize_t t = 0; t < h; t++) {
+    const FwSingleAction ac = planned(t);
+    _out(t, 0) = ac.v;
+    _out(t, 1) = ac.w;
+    _out(t, 2) = ac.dz;
+  }
+  return out;
+}
+
+pybind11::array_t<double> MpcPlanner::get_probs() const {
+  if (config_.continuous) {
+    throw std::runtime_error("get_probs needs a discrete planner");
+  }
+  const auto h = static_cast<pybind11::ssize_t>(config_.horizon);
+  const auto num = static_cast<pybind11::ssize_t>(all_actions_.size());
+  pybind11::array_t<double> out({h, num});
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::copy(probs_.begin(), probs_.end(), out.mutable_data());
+  return out;
+}
+
+pybind11::array_t<double> MpcPlanner::get_costs() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pybind11::array_t<double> out(static_cast<pybind11::ssize_t>(costs_.size()));
+  std::copy(costs_.begin(), costs_.end(), out.mutable_data());
+  return out;
+}
+
+std::string MpcPlanner::to_string() const {
+  return std::string("MpcPlanner(config=") + config_.to_string() +
+    ", num_threads=" + std::to_string(pool_->get_num_threads()) +
+    ", barrier=" + bool2str(has_barrier()) + ")";
+}
+
+} // namespace fw_coll_env
@@ -0,0 +1,242 @@
+#include <fw-coll-env/MultiBarrierFilter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+MultiBarrierFilter::MultiBarrierFilter(
+    const BarrierGammaTurn &barrier, size_t max_sweeps) :
+      barrier_(barrier.clone()),
+      params_(barrier_->get_params()),
+      max_sweeps_(max_sweeps),
+      cull_dist_(calc_cull_dist()),
+      grid_(cull_dist_) {}
+
+double MultiBarrierFilter::calc_cull_dist() const {
+  // largest distance either aircraft covers in one step with any action
+  // and in the evasive rollout
+  double max_step = 0;
+  for (const auto &ac : barrier_->avail_actions_.get_all_actions()) {
+    max_step = std::max(max_step, std::hypot(ac.v, ac.dz) * barrier_->dt_);
+  }
+  const double rollout = std::abs(params_.v) * barrier_->rollout_horizon();
+  const double dist =
+    params_.max_val + params_.safety_dist + 2 * (max_step + rollout);
+  // slack for rounding in the rollouts
+  return dist + 1e-9 * (1 + dist);
+}
+
+double MultiBarrierFilter::pair_bf(Pair &p, int a_i, int a_j) {
+  const size_t num_actions = barrier_->avail_actions_.get_all_actions().size();
+  double &val = p.bf[a_i * num_actions + a_j];
+  if (std::isnan(val)) {
+    const auto &all_actions = barrier_->avail_actions_.get_all_actions();
+    val = barrier_->bf_constraint(
+        params_, p.h, p.x, FwAction{all_actions[a_i], all_actions[a_j]}, counts_);
+    num_evals_++;
+  }
+  return val;
+}
+
+double MultiBarrierFilter::violation(Pair &p, const std::vector<int> &a) {
+  return std::max(0.0, -pair_bf(p, a[p.i], a[p.j]));
+}
+
+void MultiBarrierFilter::solve_pair(
+    Pair &p, const std::vector<int> &uhat_idx, const std::vector<bool> &fixed,
+    std::vector<int> &a) {
+
+  // the choose_u search from the current actions, restricted to the
+  // aircraft that are not fixed and sharing the constraint cache of p
+  const auto &all_actions = barrier_->avail_actions_.get_all_actions();
+  const int num_actions = all_actions.size();
+  const FwAction uhat {all_actions[uhat_idx[p.i]], all_actions[uhat_idx[p.j]]};
+  ChooseUInfo info;
+  const int idx = barrier_->choose_u_search(
+      p.x, uhat, p.h, pair_bf(p, a[p.i], a[p.j]), params_, counts_, &info,
+      fixed[p.i] ? a[p.i] : -1, fixed[p.j] ? a[p.j] : -1, p.bf.data());
+  // info counts the starting action, which pair_bf already did
+  num_evals_ += info.num_candidates - 1;
+
+  if (idx >= 0) {
+    a[p.i] = idx / num_actions;
+    a[p.j] = idx % num_actions;
+  }
+}
+
+bool MultiBarrierFilter::descend(
+    int i, const std::vector<int> &uhat_idx,
+    const std::vector<std::vector<size_t>> &pairs_of, std::vector<int> &a) {
+
+  const auto &all_actions = barrier_->avail_actions_.get_all_actions();
+  const int num_actions = all_actions.size();
+  auto cost = [&](int ai) {
+    a[i] = ai;
+    double total = 0;
+    for (size_t k : pairs_of[i]) {
+      total += violation(pairs_[k], a);
+    }
+    return std::make_pair(total, all_actions[ai].dist(all_actions[uhat_idx[i]]));
+  };
+
+  const int start = a[i];
+  int best = start;
+  auto best_cost = cost(start);
+  for (int ai = 0; ai < num_actions; ai++) {
+    if (ai == start) {
+      continue;
+    }
+    const auto c = cost(ai);
+    if (c < best_cost) {
+      best_cost = c;
+      best = ai;
+    }
+  }
+  a[i] = best;
+  return best != start;
+}
+
+std::vector<int> MultiBarrierFilter::filter(
+    const std::vector<FwSingleState> &x, const std::vector<int> &uhat_idx,
+    const std::vector<bool> &active) {
+
+  const size_t n = x.size();
+  if (uhat_idx.size() != n || active.size() != n) {
+    throw std::runtime_error("MultiBarrierFilter needs one uhat and flag per aircraft");
+  }
+  const size_t num_actions = barrier_->avail_actions_.get_all_actions().size();
+  for (int idx : uhat_idx) {
+    if (idx < 0 || static_cast<size_t>(idx) >= num_actions) {
+      throw std::runtime_error("idx too large for all_actions");
+    }
+  }
+  num_violated_ = num_evals_ = num_sweeps_ = num_unresolved_ = 0;
+  counts_ = PruneCounts();
+
+  // broad phase
+  std::vector<Point> points(n);
+  for (size_t i = 0; i < n; i++) {
+    points[i] = x[i].p;
+  }
+  grid_.build(points, active);
+  std::vector<std::pair<int, int>> candidates;
+  grid_.pairs_within(cull_dist_, candidates);
+  num_pairs_ = candidates.size();
+
+  pairs_.clear();
+  pairs_.reserve(candidates.size());
+  std::vector<std::vector<size_t>> pairs_of(n);
+  for (const auto &c : candidates) {
+    Pair p {c.first, c.second, FwState{x[c.first], x[c.second]}, 0,
+            std::vector<double>(num_actions * num_actions,
+                                std::numeric_limits<double>::quiet_NaN())};
+    p.h = barrier_->calc_h(p.x, params_, counts_);
+    pairs_of[p.i].push_back(pairs_.size());
+    pairs_of[p.j].push_back(pairs_.size());
+    pairs_.push_back(std::move(p));
+  }
+
+  std::vector<int> a = uhat_idx;
+  std::vector<size_t> violated;
+  for (size_t k = 0; k < pairs_.size(); k++) {
+    if (violation(pairs_[k], a) > 0) {
+      violated.push_back(k);
+    }
+  }
+  num_violated_ = violated.size();
+
+  // greedy joint choice for the most urgent pairs first
+  std::stable_sort(violated.begin(), violated.end(), [&](size_t k1, size_t k2) {
+    return pairs_[k1].h < pairs_[k2].h;
+  });
+  std::vector<bool> fixed(n, false);
+  for (size_t k : violated) {
+    Pair &p = pairs_[k];
+    if ((fixed[p.i] && fixed[p.j]) || violation(p, a) == 0) {
+      continue;
+    }
+    solve_pair(p, uhat_idx, fixed, a);
+    fixed[p.i] = fixed[p.j] = true;
+  }
+
+  // coordinate descent on what the greedy pass left violated
+  while (num_sweeps_ < max_sweeps_) {
+    std::vector<int> dirty;
+    for (Pair &p : pairs_) {
+      if (violation(p, a) > 0) {
+        dirty.push_back(p.i);
+        dirty.push_back(p.j);
+      }
+    }
+    if (dirty.empty()) {
+      break;
+    }
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+    num_sweeps_++;
+
+    bool changed = false;
+    for (int i : dirty) {
+      changed = descend(i, uhat_idx, pairs_of, a) || changed;
+    }
+    if (!changed) {
+      break;
+    }
+  }
+
+  for (Pair &p : pairs_) {
+    num_unresolved_ += violation(p, a) > 0;
+  }
+  barrier_->add_counts(counts_);
+  return a;
+}
+
+pybind11::array_t<int> MultiBarrierFilter::choose_u(
+    const std::vector<FwSingleState> &x, pybind11::array_t<int> uhat_idx,
+    const std::vector<bool> &active) {
+  if (uhat_idx.ndim() != 1 || static_cast<size_t>(uhat_idx.shape(0)) != x.size()) {
+    throw std::runtime_error("invalid shape given for uhat_idx in MultiBarrierFilter");
+  }
+
+  auto _uhat_idx = uhat_idx.unchecked<1>();
+  std::vector<int> uhat(x.size());
+  for (size_t i = 0; i < x.size(); i++) {
+    uhat[i] = _uhat_idx(i);
+  }
+  const std::vector<int> safe = filter(x, uhat, active);
+
+  pybind11::array_t<int> out {static_cast<pybind11::ssize_t>(safe.size())};
+  auto _out = out.mutable_unchecked<1>();
+  for (size_t i = 0; i < safe.size(); i++) {
+    _out(i) = safe[i];
+  }
+  return out;
+}
+
+pybind11::array_t<int> MultiBarrierFilter::choose_u(
+    pybind11::array_t<double> x, pybind11::array_t<int> uhat_idx) {
+  if (x.ndim() != 2 || x.shape(1) != 4) {
+    throw std::runtime_error("invalid shape given for x in MultiBarrierFilter");
+  }
+
+  auto _x = x.unchecked<2>();
+  std::vector<FwSingleState> states;
+  for (pybind11::ssize_t i = 0; i < x.shape(0); i++) {
+    states.emplace_back(Point(_x(i, 0), _x(i, 1), _x(i, 3)), _x(i, 2));
+  }
+  return choose_u(states, uhat_idx, std::vector<bool>(states.size(), true));
+}
+
+pybind11::array_t<int> MultiBarrierFilter::choose_u_env(
+    const FwMultiCollisionEnv &env, pybind11::array_t<int> uhat_idx) {
+  return choose_u(env.get_x(), uhat_idx, env.get_active());
+}
+
+std::string MultiBarrierFilter::to_string() const {
+  return std::string("MultiBarrierFilter(barrier=") + barrier_->to_string() +
+    ",max_sweeps=" + std::to_string(max_sweeps_) + ")";
+}
+} // namespace fw_coll_env
@@ -0,0 +1,271 @@
+#include <fw-coll-env/Profiler.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <stdexcept>
+#include <vector>
+
+namespace fw_coll_env {
+namespace profiler {
+
+namespace {
+
+struct TimerInfo {
+  const char *name;
+  // per call scopes that are too fine grained for trace events
+  bool traced;
+};
+
+const char *const counter_names[num_counters] {
+  "choose_u_rows", "choose_u_overrides", "choose_u_searches",
+  "choose_u_candidates", "choose_u_incomplete", "safe_mask_rows", "rollouts",
+  "rollout_steps", "env_steps", "uhat_calls", "mpc_rollouts", "mpc_rollout_steps"};
+
+const TimerInfo timer_infos[num_timers] {
+  {"choose_u", true}, {"choose_u_search", true}, {"safe_action_mask", true},
+  {"closest_future_dist", false},
+  {"env_step", true}, {"env_batch_step", true}, {"time_warp_sleep", true},
+  {"mpc_plan", true}};
+
+struct TraceEvent {
+  Timer timer;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+};
+
+struct TimerStats {
+  std::atomic<uint64_t> count {0};
+  std::atomic<uint64_t> total_ns {0};
+  std::atomic<uint64_t> max_ns {0};
+  std::atomic<uint64_t> buckets[num_buckets] = {};
+};
+
+// written by its thread only, so increments are a relaxed load and store
+void bump(std::atomic<uint64_t> &val, uint64_t n) {
+  val.store(val.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+}
+
+struct ThreadProfile {
+  explicit ThreadProfile(uint64_t _tid) : tid(_tid) {}
+
+  uint64_t tid;
+  std::atomic<uint64_t> counters[num_counters] = {};
+  TimerStats timers[num_timers];
+
+  // only contended while the trace is read or reset
+  std::mutex trace_mutex;
+  std::vector<TraceEvent> trace;
+  uint64_t trace_dropped = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadProfile *> live;
+  uint64_t next_tid = 0;
+
+  // totals of finished threads
+  Snapshot retired;
+  std::vector<std::pair<uint64_t, TraceEvent>> retired_trace;
+
+  std::atomic<bool> tracing {false};
+  std::atomic<size_t> max_events {0};
+  const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+};
+
+// never destroyed so threads finishing during exit can still retire
+Registry &registry() {
+  static Registry *reg = new Registry();
+  return *reg;
+}
+
+void add_to(Snapshot &snap, ThreadProfile &p) {
+  for (size_t c = 0; c < num_counters; c++) {
+    snap.counters[c] += p.counters[c].load(std::memory_order_relaxed);
+  }
+  for (size_t t = 0; t < num_timers; t++) {
+    TimerSnapshot &dst = snap.timers[t];
+    const TimerStats &src = p.timers[t];
+    dst.count += src.count.load(std::memory_order_relaxed);
+    dst.total_ns += src.total_ns.load(std::memory_order_relaxed);
+    dst.max_ns = std::max(dst.max_ns, src.max_ns.load(std::memory_order_relaxed));
+    for (size_t b = 0; b < num_buckets; b++) {
+      dst.buckets[b] += src.buckets[b].load(std::memory_order_relaxed);
+    }
+  }
+  std::lock_guard<std::mutex> lock(p.trace_mutex);
+  snap.trace_events += p.trace.size();
+  snap.trace_dropped += p.trace_dropped;
+}
+
+// registers the calling thread on first use and retires it at thread exit
+class LocalProfile {
+ public:
+  LocalProfile() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    profile_ = new ThreadProfile(reg.next_tid++);
+    reg.live.push_back(profile_);
+  }
+
+  ~LocalProfile() {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    add_to(reg.retired, *profile_);
+    for (const auto &ev : profile_->trace) {
+      reg.retired_trace.emplace_back(profile_->tid, ev);
+    }
+    reg.live.erase(std::find(reg.live.begin(), reg.live.end(), profile_));
+    delete profile_;
+  }
+
+  ThreadProfile &get() {return *profile_;}
+
+ private:
+  ThreadProfile *profile_;
+};
+
+ThreadProfile &local() {
+  thread_local LocalProfile profile;
+  return profile.get();
+}
+
+size_t bucket_of(uint64_t ns) {
+  size_t b = 0;
+  while (ns > 0 && b + 1 < num_buckets) {
+    ns >>= 1;
+    b++;
+  }
+  return b;
+}
+
+} // namespace
+
+const char *counter_name(Counter counter) {
+  return counter_names[static_cast<size_t>(counter)];
+}
+
+const char *timer_name(Timer timer) {
+  return timer_infos[static_cast<size_t>(timer)].name;
+}
+
+void set_enabled(bool enabled) {
+  enabled_flag().store(enabled, std::memory_order_relaxed);
+}
+
+bool tracing() {
+  return registry().tracing.load(std::memory_order_relaxed);
+}
+
+void set_tracing(bool tracing, size_t max_events) {
+  Registry &reg = registry();
+  reg.max_events.store(max_events, std::memory_order_relaxed);
+  reg.tracing.store(tracing, std::memory_order_relaxed);
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - registry().epoch).count();
+}
+
+void add(Counter counter, uint64_t n) {
+  bump(local().counters[static_cast<size_t>(counter)], n);
+}
+
+void record(Timer timer, uint64_t start_ns, uint64_t duration_ns) {
+  ThreadProfile &p = local();
+  const size_t t = static_cast<size_t>(timer);
+  TimerStats &stats = p.timers[t];
+  bump(stats.count, 1);
+  bump(stats.total_ns, duration_ns);
+  if (duration_ns > stats.max_ns.load(std::memory_order_relaxed)) {
+    stats.max_ns.store(duration_ns, std::memory_order_relaxed);
+  }
+  bump(stats.buckets[bucket_of(duration_ns)], 1);
+
+  Registry &reg = registry();
+  if (timer_infos[t].traced && reg.tracing.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(p.trace_mutex);
+    if (p.trace.size() < reg.max_events.load(std::memory_order_relaxed)) {
+      p.trace.push_back({timer, start_ns, duration_ns});
+    } else {
+      p.trace_dropped++;
+    }
+  }
+}
+
+Snapshot snapshot() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  Snapshot snap = reg.retired;
+  for (ThreadProfile *p : reg.live) {
+    add_to(snap, *p);
+  }
+  return snap;
+}
+
+void reset() {
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.retired = Snapshot();
+  reg.retired_trace.clear();
+  for (ThreadProfile *p : reg.live) {
+    for (auto &c : p->counters) {
+      c.store(0, std::memory_order_relaxed);
+    }
+    for (auto &t : p->timers) {
+      t.count.store(0, std::memory_order_relaxed);
+      t.total_ns.store(0, std::memory_order_relaxed);
+      t.max_ns.store(0, std::memory_order_relaxed);
+      for (auto &b : t.buckets) {
+        b.store(0, std::memory_order_relaxed);
+      }
+    }
+    std::lock_guard<std::mutex> trace_lock(p->trace_mutex);
+    p->trace.clear();
+    p->trace_dropped = 0;
+  }
+}
+
+void write_trace(const std::string &path) {
+  std::ofstream out(path);
+  if (!out) {
+    throw std::runtime_error("could not open " + path);
+  }
+
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  bool first = true;
+  char buf[256];
+  auto write_event = [&](uint64_t tid, const TraceEvent &ev) {
+    // trace event timestamps are in microseconds
+    std::snprintf(
+        buf, sizeof(buf),
+        "%s\n{\"name\":\"%s\",\"cat\":\"fw_coll_env\",\"ph\":\"X\","
+        "\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%llu}",
+        first ? "" : ",", timer_name(ev.timer), ev.start_ns / 1e3, ev.duration_ns / 1e3,
+        static_cast<unsigned long long>(tid));  // NOLINT
+    out << buf;
+    first = false;
+  };
+
+  out << "{\"traceEvents\":[";
+  for (const auto &ev : reg.retired_trace) {
+    write_event(ev.first, ev.second);
+  }
+  for (ThreadProfile *p : reg.live) {
+    std::lock_guard<std::mutex> trace_lock(p->trace_mutex);
+    for (const auto &ev : p->trace) {
+      write_event(p->tid, ev);
+    }
+  }
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+  if (!out) {
+    throw std::runtime_error("could not write " + path);
+  }
+}
+
+} // namespace profiler
+} // namespace fw_coll_env
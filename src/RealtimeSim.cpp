@@ -0,0 +1,229 @@
+#include <fw-coll-env/RealtimeSim.h>
+#include <fw-coll-env/BarrierGammaTurn.h>
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+RealtimeSim::RealtimeSim(
+    const FwCollisionEnv &env, const FwAvailActions &avail_actions,
+    double time_warp, size_t max_catch_up) :
+      env_(env),
+      avail_actions_(avail_actions),
+      uhat1_(env.get_goal1(), env.get_dt(), avail_actions),
+      uhat2_(env.get_goal2(), env.get_dt(), avail_actions),
+      time_warp_(time_warp),
+      max_catch_up_(max_catch_up) {
+
+  if (!(time_warp_ > 0)) {
+    throw std::runtime_error("RealtimeSim requires time_warp > 0");
+  }
+  if (env.get_time_warp() > 0) {
+    throw std::runtime_error("RealtimeSim paces the env itself, env time_warp must be <= 0");
+  }
+  // the sim thread must not share the barrier with other envs
+  if (env.has_shield()) {
+    if (!(env.get_shield()->get_avail_actions().get_all_actions() ==
+          avail_actions_.get_all_actions())) {
+      throw std::runtime_error("shield avail_actions do not match those of RealtimeSim");
+    }
+    env_.set_shield(*env.get_shield());
+  }
+  snapshot_.store(make_snapshot());
+}
+
+RealtimeSim::~RealtimeSim() {
+  try {
+    stop();
+  } catch (...) {
+    // nothing to report to from a destructor
+  }
+}
+
+void RealtimeSim::start() {
+  if (running_) {
+    throw std::runtime_error("RealtimeSim is already running");
+  }
+  join();
+
+  stop_requested_ = false;
+  local_stats_ = RealtimeStats();
+  sum_lateness_ = sum_sq_lateness_ = 0;
+  stats_.store(local_stats_);
+  running_ = true;
+  thread_ = std::thread(&RealtimeSim::run, this);
+}
+
+void RealtimeSim::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_requested_ = true;
+  }
+  cv_.notify_all();
+  join();
+}
+
+void RealtimeSim::join() {
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::swap(error, error_);
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+bool RealtimeSim::wait(double timeout) {
+  // python threads posting actions keep running meanwhile
+  pybind11::gil_scoped_release release;
+  std::unique_lock<std::mutex> lock(mutex_);
+  const bool finished = cv_.wait_for(
+      lock, std::chrono::duration<double>(timeout), [this] {return !running_;});
+  lock.unlock();
+  if (finished) {
+    join();
+  }
+  return finished;
+}
+
+void RealtimeSim::reset(const FwSingleState &x1, const FwSingleState &x2, double t) {
+  if (running_) {
+    throw std::runtime_error("RealtimeSim can only be reset while stopped");
+  }
+  env_.reset(x1, x2, t);
+  snapshot_.store(make_snapshot());
+}
+
+const FwCollisionEnv &RealtimeSim::get_env() const {
+  if (running_) {
+    throw std::runtime_error("RealtimeSim env is only available while stopped");
+  }
+  return env_;
+}
+
+void RealtimeSim::post_action(int a1_idx, int a2_idx) {
+  const int num_actions = avail_actions_.get_all_actions().size();
+  if (a1_idx < -1 || a1_idx >= num_actions || a2_idx < -1 || a2_idx >= num_actions) {
+    throw std::runtime_error("idx too large for all_actions");
+  }
+  const uint64_t word = posted_bit |
+                        (static_cast<uint64_t>(a1_idx + 1) << 32) |
+                        static_cast<uint64_t>(a2_idx + 1);
+  mailbox_.store(word, std::memory_order_release);
+}
+
+void RealtimeSim::run() {
+  const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(env_.get_dt() / time_warp_));
+
+  // the state start was called with is step 0, the first step is due
+  // one period later
+  std::exception_ptr error;
+  try {
+    snapshot_.store(make_snapshot());
+    auto deadline = Clock::now() + period;
+    while (!env_.get_done() && !env_.get_collided()) {
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (cv_.wait_until(lock, deadline, [this] {return stop_requested_;})) {
+          break;
+        }
+      }
+
+      step_once(std::chrono::duration<double>(Clock::now() - deadline).count());
+      deadline += period;
+
+      // deadlines already passed beyond max_catch_up are dropped
+      const auto behind = Clock::now() - deadline;
+      if (behind >= Clock::duration::zero()) {
+        local_stats_.num_overruns++;
+        const size_t missed = behind / period + 1;
+        if (missed > max_catch_up_) {
+          local_stats_.num_skipped += missed - max_catch_up_;
+          deadline += (missed - max_catch_up_) * period;
+        }
+      }
+      stats_.store(local_stats_);
+    }
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    error_ = error;
+    running_ = false;
+  }
+  cv_.notify_all();
+}
+
+void RealtimeSim::step_once(double lateness) {
+  const uint64_t word = mailbox_.exchange(0, std::memory_order_acquire);
+  if (word == 0) {
+    local_stats_.num_stale++;
+  } else {
+    a1_idx_ = static_cast<int>((word & ~posted_bit) >> 32) - 1;
+    a2_idx_ = static_cast<int>(word & 0xffffffff) - 1;
+  }
+
+  const auto &all_actions = avail_actions_.get_all_actions();
+  FwAction ac {
+    a1_idx_ < 0 ? uhat1_.calc(env_.get_x1()) : all_actions[a1_idx_],
+    a2_idx_ < 0 ? uhat2_.calc(env_.get_x2()) : all_actions[a2_idx_]};
+
+  bool overridden = false;
+  if (env_.has_shield()) {
+    const FwActionIndex &index = env_.get_shield()->get_action_index();
+    const auto result = env_.step_shielded(index.action_to_idx(ac));
+    ac = index.idx_to_action(std::get<2>(result));
+    overridden = std::get<3>(result);
+  } else {
+    env_.step(ac.a1, ac.a2);
+  }
+
+  RealtimeStats &s = local_stats_;
+  s.num_steps++;
+  sum_lateness_ += lateness;
+  sum_sq_lateness_ += lateness * lateness;
+  s.mean_lateness = sum_lateness_ / s.num_steps;
+  s.rms_lateness = std::sqrt(sum_sq_lateness_ / s.num_steps);
+  s.max_lateness = std::max(s.max_lateness, lateness);
+
+  RealtimeSnapshot snap = make_snapshot();
+  snap.step = s.num_steps;
+  const double action[6] {ac.a1.v, ac.a1.w, ac.a1.dz, ac.a2.v, ac.a2.w, ac.a2.dz};
+  std::copy(action, action + 6, snap.action);
+  snap.overridden = overridden;
+  snap.lateness = lateness;
+  snapshot_.store(snap);
+}
+
+RealtimeSnapshot RealtimeSim::make_snapshot() const {
+  const FwSingleState &x1 = env_.get_x1();
+  const FwSingleState &x2 = env_.get_x2();
+  RealtimeSnapshot snap;
+  snap.t = env_.get_t();
+  const double x[8] {x1.p.x, x1.p.y, x1.th, x1.p.z, x2.p.x, x2.p.y, x2.th, x2.p.z};
+  std::copy(x, x + 8, snap.x);
+  std::fill(snap.action, snap.action + 6, std::numeric_limits<double>::quiet_NaN());
+  snap.done = env_.get_done();
+  snap.collided = env_.get_collided();
+  snap.dist_to_veh = env_.stats.dist_to_veh;
+  return snap;
+}
+
+std::string RealtimeSim::to_string() const {
+  return std::string("RealtimeSim(env=") + env_.to_string() +
+    ",time_warp=" + std::to_string(time_warp_) +
+    ",max_catch_up=" + std::to_string(max_catch_up_) + ")";
+}
+} // namespace fw_coll_env
@@ -0,0 +1,324 @@
+#include <fw-coll-env/ReplayBuffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+namespace {
+
+void atomic_add(std::atomic<double> &val, double delta) {
+  double cur = val.load(std::memory_order_relaxed);
+  while (!val.compare_exchange_weak(cur, cur + delta, std::memory_order_relaxed)) {}
+}
+
+void atomic_max(std::atomic<double> &val, double other) {
+  double cur = val.load(std::memory_order_relaxed);
+  while (cur < other &&
+         !val.compare_exchange_weak(cur, other, std::memory_order_relaxed)) {}
+}
+
+constexpr double kQuantLevels = 65535.0;
+
+} // namespace
+
+int16_t ReplayBuffer::Quantizer::encode(size_t dim, double val) const {
+  const double q = std::round((val - low[dim]) * scale[dim]);
+  return static_cast<int16_t>(std::clamp(q, 0.0, kQuantLevels) - 32768.0);
+}
+
+double ReplayBuffer::Quantizer::decode(size_t dim, int16_t val) const {
+  return low[dim] + (static_cast<double>(val) + 32768.0) / scale[dim];
+}
+
+ReplayBuffer::ReplayBuffer(
+    size_t capacity, const FwAvailActions &avail_actions,
+    pybind11::array_t<double> state_lims, pybind11::array_t<double> obs_lims,
+    uint64_t seed) :
+      capacity_(capacity),
+      obs_dim_(obs_lims.ndim() == 2 ? obs_lims.shape(1) : 0),
+      num_actions_(avail_actions.get_all_actions().size() *
+                   avail_actions.get_all_actions().size()),
+      state_q_(read_lims(state_lims, 8, "state_lims")),
+      obs_q_(read_lims(obs_lims, obs_dim_, "obs_lims")),
+      states_(capacity * 8),
+      obs_(capacity * obs_dim_),
+      actions_(capacity),
+      overridden_(capacity),
+      seq_(new std::atomic<uint64_t>[capacity]),
+      tree_leaves_(1),
+      rng_(seed) {
+
+  if (capacity_ == 0) {
+    throw std::runtime_error("ReplayBuffer capacity must be positive");
+  }
+  if (num_actions_ > std::numeric_limits<uint16_t>::max() + size_t(1)) {
+    throw std::runtime_error("too many joint actions for uint16 action indices");
+  }
+
+  for (size_t i = 0; i < capacity_; i++) {
+    seq_[i].store(0);
+  }
+  while (tree_leaves_ < capacity_) {
+    tree_leaves_ *= 2;
+  }
+  tree_.reset(new std::atomic<double>[2 * tree_leaves_]);
+  for (size_t i = 0; i < 2 * tree_leaves_; i++) {
+    tree_[i].store(0);
+  }
+}
+
+ReplayBuffer::Quantizer ReplayBuffer::read_lims(
+    const pybind11::array_t<double> &lims, size_t dim, const char *name) const {
+  if (lims.ndim() != 2 || lims.shape(0) != 2 ||
+      static_cast<size_t>(lims.shape(1)) != dim) {
+    throw std::runtime_error(std::string("invalid shape given for ") + name);
+  }
+
+  Quantizer q;
+  auto _lims = lims.unchecked<2>();
+  for (size_t i = 0; i < dim; i++) {
+    if (!(_lims(1, i) > _lims(0, i))) {
+      throw std::runtime_error(std::string(name) + " requires low < high");
+    }
+    q.low.push_back(_lims(0, i));
+    q.scale.push_back(kQuantLevels / (_lims(1, i) - _lims(0, i)));
+  }
+  return q;
+}
+
+void ReplayBuffer::insert(
+    const double *x, const double *obs, int action_idx, bool overridden) {
+  insert(x, obs, action_idx, overridden, max_priority_.load(std::memory_order_relaxed));
+}
+
+void ReplayBuffer::insert(
+    const double *x, const double *obs, int action_idx, bool overridden,
+    double priority) {
+
+  if (action_idx < 0 || static_cast<size_t>(action_idx) >= num_actions_) {
+    throw std::runtime_error("action_idx out of range in ReplayBuffer");
+  }
+  if (!(priority >= 0)) {
+    throw std::runtime_error("ReplayBuffer priorities must be non-negative");
+  }
+
+  const uint64_t ticket = cursor_.fetch_add(1, std::memory_order_relaxed);
+  const size_t slot = ticket % capacity_;
+
+  seq_[slot].store(2 * ticket + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  for (size_t i = 0; i < 8; i++) {
+    states_[slot * 8 + i] = state_q_.encode(i, x[i]);
+  }
+  for (size_t i = 0; i < obs_dim_; i++) {
+    obs_[slot * obs_dim_ + i] = obs_q_.encode(i, obs[i]);
+  }
+  actions_[slot] = static_cast<uint16_t>(action_idx);
+  overridden_[slot] = overridden;
+
+  seq_[slot].store(2 * ticket + 2, std::memory_order_release);
+  set_priority(slot, priority);
+}
+
+void ReplayBuffer::set_priority(size_t slot, double priority) {
+  atomic_max(max_priority_, priority);
+
+  size_t node = tree_leaves_ + slot;
+  const double delta = priority - tree_[node].exchange(priority);
+  for (node /= 2; node >= 1; node /= 2) {
+    atomic_add(tree_[node], delta);
+  }
+}
+
+void ReplayBuffer::add(
+    pybind11::array_t<double> x, pybind11::array_t<double> obs,
+    pybind11::array_t<int> action_idx, pybind11::array_t<bool> overridden,
+    std::optional<pybind11::array_t<double>> priorities) {
+
+  const auto n = x.shape(0);
+  if (x.ndim() != 2 || x.shape(1) != 8 || obs.ndim() != 2 || obs.shape(0) != n ||
+      static_cast<size_t>(obs.shape(1)) != obs_dim_ ||
+      action_idx.shape(0) != n || overridden.shape(0) != n ||
+      (priorities && priorities->shape(0) != n)) {
+    throw std::runtime_error("invalid shape given to ReplayBuffer.add");
+  }
+
+  auto _x = x.unchecked<2>();
+  auto _obs = obs.unchecked<2>();
+  auto _action_idx = action_idx.unchecked<1>();
+  auto _overridden = overridden.unchecked<1>();
+
+  std::vector<double> x_row(8), obs_row(obs_dim_);
+  for (pybind11::ssize_t i = 0; i < n; i++) {
+    for (size_t j = 0; j < 8; j++) {
+      x_row[j] = _x(i, j);
+    }
+    for (size_t j = 0; j < obs_dim_; j++) {
+      obs_row[j] = _obs(i, j);
+    }
+
+    if (priorities) {
+      insert(x_row.data(), obs_row.data(), _action_idx(i), _overridden(i),
+             priorities->at(i));
+    } else {
+      insert(x_row.data(), obs_row.data(), _action_idx(i), _overridden(i));
+    }
+  }
+}
+
+bool ReplayBuffer::read_slot(
+    size_t slot, double *x, double *obs, int &action_idx, bool &overridden) const {
+  const uint64_t seq = seq_[slot].load(std::memory_order_acquire);
+  if (seq == 0 || seq % 2 == 1) {
+    return false;
+  }
+
+  for (size_t i = 0; i < 8; i++) {
+    x[i] = state_q_.decode(i, states_[slot * 8 + i]);
+  }
+  for (size_t i = 0; i < obs_dim_; i++) {
+    obs[i] = obs_q_.decode(i, obs_[slot * obs_dim_ + i]);
+  }
+  action_idx = actions_[slot];
+  overridden = overridden_[slot];
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return seq_[slot].load(std::memory_order_relaxed) == seq;
+}
+
+size_t ReplayBuffer::find_prefix_sum(double u) const {
+  size_t node = 1;
+  while (node < tree_leaves_) {
+    const double left = tree_[2 * node].load(std::memory_order_relaxed);
+    if (u < left || tree_[2 * node + 1].load(std::memory_order_relaxed) <= 0) {
+      node = 2 * node;
+    } else {
+      u -= left;
+      node = 2 * node + 1;
+    }
+  }
+  return std::min(node - tree_leaves_, capacity_ - 1);
+}
+
+void ReplayBuffer::check_outputs(
+    const OutArray<double> &x_out, const OutArray<double> &obs_out,
+    const OutArray<int> &action_out, const OutArray<bool> &overridden_out,
+    const OutArray<int64_t> &idx_out) const {
+
+  const auto n = x_out.shape(0);
+  if (x_out.ndim() != 2 || x_out.shape(1) != 8 || obs_out.ndim() != 2 ||
+      obs_out.shape(0) != n || static_cast<size_t>(obs_out.shape(1)) != obs_dim_ ||
+      action_out.ndim() != 1 || action_out.shape(0) != n ||
+      overridden_out.ndim() != 1 || overridden_out.shape(0) != n ||
+      idx_out.ndim() != 1 || idx_out.shape(0) != n) {
+    throw std::runtime_error("invalid output shape given to ReplayBuffer sampling");
+  }
+  if (size() == 0) {
+    throw std::runtime_error("cannot sample from an empty ReplayBuffer");
+  }
+}
+
+void ReplayBuffer::sample(
+    OutArray<double> x_out, OutArray<double> obs_out,
+    OutArray<int> action_out, OutArray<bool> overridden_out,
+    OutArray<int64_t> idx_out) {
+
+  check_outputs(x_out, obs_out, action_out, overridden_out, idx_out);
+  auto _x = x_out.mutable_unchecked<2>();
+  auto _obs = obs_out.mutable_unchecked<2>();
+  auto _action = action_out.mutable_unchecked<1>();
+  auto _overridden = overridden_out.mutable_unchecked<1>();
+  auto _idx = idx_out.mutable_unchecked<1>();
+
+  std::uniform_int_distribution<size_t> dist(0, size() - 1);
+  for (pybind11::ssize_t i = 0; i < x_out.shape(0); i++) {
+    bool ok = false;
+    for (int retry = 0; !ok && retry < max_read_retries_; retry++) {
+      const size_t slot = dist(rng_);
+      ok = read_slot(slot, _x.mutable_data(i, 0), _obs.mutable_data(i, 0),
+                     _action(i), _overridden(i));
+      _idx(i) = slot;
+    }
+    if (!ok) {
+      throw std::runtime_error("ReplayBuffer slots kept changing while sampling");
+    }
+  }
+}
+
+void ReplayBuffer::sample_prioritized(
+    OutArray<double> x_out, OutArray<double> obs_out,
+    OutArray<int> action_out, OutArray<bool> overridden_out,
+    OutArray<int64_t> idx_out, OutArray<double> prob_out) {
+
+  check_outputs(x_out, obs_out, action_out, overridden_out, idx_out);
+  const auto n = x_out.shape(0);
+  if (prob_out.ndim() != 1 || prob_out.shape(0) != n) {
+    throw std::runtime_error("invalid output shape given to ReplayBuffer sampling");
+  }
+  const double total = get_total_priority();
+  if (!(total > 0)) {
+    throw std::runtime_error("ReplayBuffer has no positive priorities");
+  }
+
+  auto _x = x_out.mutable_unchecked<2>();
+  auto _obs = obs_out.mutable_unchecked<2>();
+  auto _action = action_out.mutable_unchecked<1>();
+  auto _overridden = overridden_out.mutable_unchecked<1>();
+  auto _idx = idx_out.mutable_unchecked<1>();
+  auto _prob = prob_out.mutable_unchecked<1>();
+
+  std::uniform_real_distribution<double> dist(0, 1);
+  const double stratum = total / n;
+  for (pybind11::ssize_t i = 0; i < n; i++) {
+    bool ok = false;
+    for (int retry = 0; !ok && retry < max_read_retries_; retry++) {
+      const size_t slot = find_prefix_sum((i + dist(rng_)) * stratum);
+      ok = read_slot(slot, _x.mutable_data(i, 0), _obs.mutable_data(i, 0),
+                     _action(i), _overridden(i));
+      _idx(i) = slot;
+      _prob(i) = tree_[tree_leaves_ + slot].load(std::memory_order_relaxed) / total;
+    }
+    if (!ok) {
+      throw std::runtime_error("ReplayBuffer slots kept changing while sampling");
+    }
+  }
+}
+
+void ReplayBuffer::update_priorities(
+    pybind11::array_t<int64_t> idx, pybind11::array_t<double> priorities) {
+  if (idx.ndim() != 1 || priorities.ndim() != 1 || idx.shape(0) != priorities.shape(0)) {
+    throw std::runtime_error("invalid shape given to ReplayBuffer.update_priorities");
+  }
+
+  auto _idx = idx.unchecked<1>();
+  auto _priorities = priorities.unchecked<1>();
+  for (pybind11::ssize_t i = 0; i < idx.shape(0); i++) {
+    if (_idx(i) < 0 || static_cast<size_t>(_idx(i)) >= size()) {
+      throw std::runtime_error("idx out of range in ReplayBuffer.update_priorities");
+    }
+    if (!(_priorities(i) >= 0)) {
+      throw std::runtime_error("ReplayBuffer priorities must be non-negative");
+    }
+    set_priority(_idx(i), _priorities(i));
+  }
+}
+
+size_t ReplayBuffer::size() const {
+  return std::min<size_t>(cursor_.load(std::memory_order_relaxed), capacity_);
+}
+
+size_t ReplayBuffer::get_nbytes() const {
+  return states_.size() * sizeof(int16_t) + obs_.size() * sizeof(int16_t) +
+    actions_.size() * sizeof(uint16_t) + overridden_.size() * sizeof(uint8_t);
+}
+
+std::string ReplayBuffer::to_string() const {
+  return std::string("ReplayBuffer(capacity=") + std::to_string(capacity_) +
+    ",obs_dim=" + std::to_string(obs_dim_) +
+    ",size=" + std::to_string(size()) + ")";
+}
+} // namespace fw_coll_env
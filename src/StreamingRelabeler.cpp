@@ -0,0 +1,108 @@
+#include <fw-coll-env/StreamingRelabeler.h>
+#include <fw-coll-env/MappedFile.h>
+
+#include <sys/mman.h>
+
+#include <pybind11/pybind11.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+StreamingRelabeler::StreamingRelabeler(
+    const BarrierGammaTurn &barrier, size_t num_threads, size_t block_rows) :
+      barrier_(barrier.clone()),
+      block_rows_(block_rows),
+      pool_(std::make_unique<ThreadPool>(num_threads)) {
+  if (block_rows_ == 0) {
+    throw std::runtime_error("block_rows must be positive");
+  }
+}
+
+std::tuple<size_t, size_t> StreamingRelabeler::run(
+    const std::string &states_path, const std::string &actions_path,
+    const std::string &h_path, const std::string &safe_path,
+    const std::string &override_path) {
+
+  MappedFile states(states_path, false, 0);
+  MappedFile actions(actions_path, false, 0);
+  if (states.size() % (8 * sizeof(double)) != 0) {
+    throw std::runtime_error(states_path + " does not hold (N, 8) float64 states");
+  }
+  const size_t n = states.size() / (8 * sizeof(double));
+  if (actions.size() != n * sizeof(int32_t)) {
+    throw std::runtime_error(actions_path + " does not hold one int32 per state");
+  }
+
+  MappedFile h_out(h_path, true, n * sizeof(double));
+  MappedFile safe_out(safe_path, true, n * sizeof(int32_t));
+  MappedFile override_out(override_path, true, n * sizeof(uint8_t));
+
+  const double *x = states.data<double>();
+  const int32_t *uhat_idx = actions.data<int32_t>();
+  double *h = h_out.data<double>();
+  int32_t *safe_idx = safe_out.data<int32_t>();
+  uint8_t *overridden = override_out.data<uint8_t>();
+
+  states.advise(0, states.size(), MADV_SEQUENTIAL);
+  actions.advise(0, actions.size(), MADV_SEQUENTIAL);
+
+  const size_t num_chunks = std::max<size_t>(1, pool_->get_num_threads());
+  std::atomic<size_t> num_overridden {0};
+
+  pybind11::gil_scoped_release release;
+  for (size_t begin = 0; begin < n; begin += block_rows_) {
+    const size_t end = std::min(n, begin + block_rows_);
+    const size_t next_end = std::min(n, end + block_rows_);
+    states.advise(end * 8 * sizeof(double), next_end * 8 * sizeof(double), MADV_WILLNEED);
+    actions.advise(end * sizeof(int32_t), next_end * sizeof(int32_t), MADV_WILLNEED);
+
+    const size_t chunk_rows = (end - begin + num_chunks - 1) / num_chunks;
+    pool_->run(num_chunks, [&](size_t chunk) {
+      const BarrierGammaTurn &barrier = *barrier_;
+      const FwActionIndex &index = barrier.get_action_index();
+
+      size_t chunk_overridden = 0;
+      const size_t chunk_end = std::min(end, begin + (chunk + 1) * chunk_rows);
+      for (size_t i = begin + chunk * chunk_rows; i < chunk_end; i++) {
+        const double *row = x + 8 * i;
+        FwState x_state {
+          FwSingleState(Point(row[0], row[1], row[3]), row[2]),
+          FwSingleState(Point(row[4], row[5], row[7]), row[6])
+        };
+
+        ChooseUInfo info;
+        const FwAction safe_ac =
+          barrier.filter_action(x_state, index.idx_to_action(uhat_idx[i]), &info);
+        h[i] = info.h;
+        safe_idx[i] = index.action_to_idx(safe_ac);
+        overridden[i] = safe_idx[i] != uhat_idx[i];
+        chunk_overridden += overridden[i];
+      }
+      num_overridden += chunk_overridden;
+    });
+
+    // the finished inputs are not needed again and the finished outputs
+    // can be written back while the next block runs
+    states.advise(begin * 8 * sizeof(double), end * 8 * sizeof(double), MADV_DONTNEED);
+    actions.advise(begin * sizeof(int32_t), end * sizeof(int32_t), MADV_DONTNEED);
+    h_out.sync(begin * sizeof(double), end * sizeof(double), MS_ASYNC);
+    safe_out.sync(begin * sizeof(int32_t), end * sizeof(int32_t), MS_ASYNC);
+    override_out.sync(begin * sizeof(uint8_t), end * sizeof(uint8_t), MS_ASYNC);
+  }
+
+  h_out.sync(0, h_out.size(), MS_SYNC);
+  safe_out.sync(0, safe_out.size(), MS_SYNC);
+  override_out.sync(0, override_out.size(), MS_SYNC);
+  return {n, num_overridden.load()};
+}
+
+std::string StreamingRelabeler::to_string() const {
+  return std::string("StreamingRelabeler(barrier=") + barrier_->to_string() +
+    ",num_threads=" + std::to_string(pool_->get_num_threads()) +
+    ",block_rows=" + std::to_string(block_rows_) + ")";
+}
+} // namespace fw_coll_env
@@ -0,0 +1,149 @@
+#include <fw-coll-env/ThreadPool.h>
+
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace fw_coll_env {
+
+ThreadPool::ThreadPool(size_t num_threads, bool pin_threads) {
+#ifdef __linux__
+  // the cores this process may run on, which respects taskset and cgroups
+  std::vector<int> cores;
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (pin_threads && sched_getaffinity(0, sizeof(cpu_set_t), &allowed) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &allowed)) {
+        cores.push_back(cpu);
+      }
+    }
+  }
+#endif
+
+  for (size_t i = 0; i < num_threads; i++) {
+    ranges_.push_back(std::make_unique<TaskRange>());
+  }
+
+  for (size_t i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&ThreadPool::worker_loop, this, i);
+
+#ifdef __linux__
+    if (!cores.empty()) {
+      cpu_set_t cpuset;
+      CPU_ZERO(&cpuset);
+      CPU_SET(cores[i % cores.size()], &cpuset);
+      // pinning is only a hint so a failure here is not an error
+      pthread_setaffinity_np(
+          workers_.back().native_handle(), sizeof(cpu_set_t), &cpuset);
+    }
+#else
+    (void) pin_threads;
+#endif
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  start_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::run(size_t num_tasks, const std::function<void(size_t)> &fn) {
+  if (num_tasks == 0) {
+    return;
+  }
+
+  if (workers_.empty()) {
+    for (size_t task = 0; task < num_tasks; task++) {
+      fn(task);
+    }
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(mtx_);
+  const size_t num_workers = workers_.size();
+  for (size_t i = 0; i < num_workers; i++) {
+    std::lock_guard<std::mutex> range_lock(ranges_[i]->mtx);
+    ranges_[i]->begin = i * num_tasks / num_workers;
+    ranges_[i]->end = (i + 1) * num_tasks / num_workers;
+  }
+  fn_ = &fn;
+  error_ = nullptr;
+  busy_ = num_workers;
+  generation_++;
+  start_cv_.notify_all();
+
+  done_cv_.wait(lock, [&]() {return busy_ == 0;});
+  fn_ = nullptr;
+
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+bool ThreadPool::next_task(size_t worker, size_t &task) {
+  {
+    TaskRange &own = *ranges_[worker];
+    std::lock_guard<std::mutex> lock(own.mtx);
+    if (own.begin < own.end) {
+      task = own.begin++;
+      return true;
+    }
+  }
+
+  // steal from the back of the other workers' ranges
+  const size_t num_workers = ranges_.size();
+  for (size_t i = 1; i < num_workers; i++) {
+    TaskRange &other = *ranges_[(worker + i) % num_workers];
+    std::lock_guard<std::mutex> lock(other.mtx);
+    if (other.begin < other.end) {
+      task = --other.end;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::worker_loop(size_t worker) {
+  size_t seen_generation = 0;
+  while (true) {
+    const std::function<void(size_t)> *fn;
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      start_cv_.wait(lock, [&]() {return stop_ || generation_ != seen_generation;});
+      if (stop_) {
+        return;
+      }
+      seen_generation = generation_;
+      fn = fn_;
+    }
+
+    size_t task;
+    while (next_task(worker, task)) {
+      try {
+        (*fn)(task);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!error_) {
+          error_ = std::current_exception();
+        }
+      }
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (--busy_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+} // namespace fw_coll_env
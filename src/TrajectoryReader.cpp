@@ -0,0 +1,228 @@
+#include <fw-coll-env/TrajectoryReader.h>
+#include <fw-coll-env/TrajectoryRecorder.h>
+
+#include <zlib.h>
+
+#include <cstring>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+TrajectoryReader::TrajectoryReader(const std::string &path) :
+    file_(std::make_shared<MappedFile>(path, false, 0)) {
+
+  const char *data = file_->data<char>();
+  const size_t size = file_->size();
+  auto invalid = [&](const char *what) {
+    return std::runtime_error(path + " is not a trajectory file: " + what);
+  };
+
+  if (size < trajectory_align + 16 || std::memcmp(data, trajectory_magic, 8) != 0 ||
+      std::memcmp(data + size - 8, trajectory_magic, 8) != 0) {
+    throw invalid("bad magic");
+  }
+  uint64_t version;
+  std::memcpy(&version, data + 8, sizeof(version));
+  if (version != trajectory_version) {
+    throw invalid("unknown version");
+  }
+
+  uint64_t pos;
+  std::memcpy(&pos, data + size - 16, sizeof(pos));
+  const size_t footer_end = size - 16;
+  auto read = [&](void *dst, size_t n) {
+    if (pos > footer_end || n > footer_end - pos) {
+      throw invalid("truncated footer");
+    }
+    std::memcpy(dst, data + pos, n);
+    pos += n;
+  };
+  auto read_u64 = [&]() {
+    uint64_t val;
+    read(&val, sizeof(val));
+    return val;
+  };
+
+  const uint64_t num_columns = read_u64();
+  for (uint64_t c = 0; c < num_columns; c++) {
+    char name[33] = {};
+    char dtype[9] = {};
+    read(name, 32);
+    read(dtype, 8);
+    const uint64_t width = read_u64();
+    // numpy dtype strings end in the item size
+    const size_t itemsize = std::strtoul(dtype + 2, nullptr, 10);
+    if (itemsize == 0 || width == 0) {
+      throw invalid("bad column");
+    }
+    columns_.push_back({name, dtype, itemsize, width});
+  }
+
+  const uint64_t num_chunks = read_u64();
+  for (uint64_t k = 0; k < num_chunks; k++) {
+    Chunk chunk {read_u64(), read_u64(), {}, {}, {}};
+    for (uint64_t c = 0; c < num_columns; c++) {
+      chunk.offset.push_back(read_u64());
+      chunk.stored.push_back(read_u64());
+      chunk.raw.push_back(read_u64());
+      if (chunk.offset[c] > size || chunk.stored[c] > size - chunk.offset[c] ||
+          chunk.raw[c] != chunk.num_rows * columns_[c].itemsize * columns_[c].width) {
+        throw invalid("bad chunk");
+      }
+    }
+    num_rows_ += chunk.num_rows;
+    chunks_.push_back(std::move(chunk));
+  }
+
+  const uint64_t num_episodes = read_u64();
+  for (uint64_t e = 0; e < num_episodes; e++) {
+    Episode ep {read_u64(), read_u64(), read_u64(), read_u64()};
+    if (ep.chunk >= chunks_.size() || ep.row_begin < chunks_[ep.chunk].row_begin ||
+        ep.row_begin + ep.num_rows >
+          chunks_[ep.chunk].row_begin + chunks_[ep.chunk].num_rows) {
+      throw invalid("bad episode");
+    }
+    episodes_.push_back(ep);
+  }
+}
+
+const char *TrajectoryReader::block(
+    size_t chunk, size_t col, std::shared_ptr<const void> &owner) {
+  const Chunk &c = chunks_[chunk];
+  const char *stored = file_->data<char>() + c.offset[col];
+  if (c.stored[col] == c.raw[col]) {
+    owner = file_;
+    return stored;
+  }
+
+  auto &buf = inflated_[{chunk, col}];
+  if (!buf) {
+    auto out = std::make_shared<std::vector<char>>(c.raw[col]);
+    uLongf size = out->size();
+    if (uncompress(reinterpret_cast<Bytef *>(out->data()), &size,
+                   reinterpret_cast<const Bytef *>(stored), c.stored[col]) != Z_OK ||
+        size != out->size()) {
+      throw std::runtime_error("could not inflate a chunk of " + file_->get_path());
+    }
+    buf = out;
+  }
+  owner = buf;
+  return buf->data();
+}
+
+const TrajectoryReader::Episode &TrajectoryReader::get_episode(size_t episode) const {
+  if (episode >= episodes_.size()) {
+    throw std::runtime_error("episode index out of range in TrajectoryReader");
+  }
+  return episodes_[episode];
+}
+
+const char *TrajectoryReader::episode_data(
+    size_t episode, size_t col, std::shared_ptr<const void> &owner) {
+  const Episode &ep = get_episode(episode);
+  const char *data = block(ep.chunk, col, owner);
+  const size_t first = ep.row_begin - chunks_[ep.chunk].row_begin;
+  return data + first * columns_[col].itemsize * columns_[col].width;
+}
+
+size_t TrajectoryReader::column_index(const std::string &name) const {
+  for (size_t c = 0; c < columns_.size(); c++) {
+    if (columns_[c].name == name) {
+      return c;
+    }
+  }
+  throw std::runtime_error("no column " + name + " in TrajectoryReader");
+}
+
+pybind11::array TrajectoryReader::view(
+    size_t col, const char *data, size_t rows, std::shared_ptr<const void> owner) const {
+  const Column &c = columns_[col];
+  std::vector<pybind11::ssize_t> shape {static_cast<pybind11::ssize_t>(rows)};
+  std::vector<pybind11::ssize_t> strides {
+    static_cast<pybind11::ssize_t>(c.itemsize * c.width)};
+  if (c.width > 1) {
+    shape.push_back(c.width);
+    strides.push_back(c.itemsize);
+  }
+
+  // the capsule keeps the mapping or inflated block alive
+  pybind11::capsule base(
+      new std::shared_ptr<const void>(std::move(owner)),
+      [](void *p) {delete static_cast<std::shared_ptr<const void> *>(p);});
+  pybind11::array out(pybind11::dtype(c.dtype), shape, strides, data, base);
+  out.attr("setflags")(pybind11::arg("write") = false);
+  return out;
+}
+
+pybind11::dict TrajectoryReader::episode(size_t episode) {
+  const Episode &ep = get_episode(episode);
+  pybind11::dict out;
+  for (size_t c = 0; c < columns_.size(); c++) {
+    std::shared_ptr<const void> owner;
+    const char *data = episode_data(episode, c, owner);
+    out[pybind11::str(columns_[c].name)] = view(c, data, ep.num_rows, std::move(owner));
+  }
+  return out;
+}
+
+pybind11::array TrajectoryReader::column(
+    const std::string &name, std::optional<size_t> episode) {
+  const size_t col = column_index(name);
+  std::shared_ptr<const void> owner;
+  if (episode) {
+    const char *data = episode_data(*episode, col, owner);
+    return view(col, data, episodes_[*episode].num_rows, std::move(owner));
+  }
+
+  if (chunks_.size() == 1 && chunks_[0].stored[col] == chunks_[0].raw[col]) {
+    const char *data = block(0, col, owner);
+    return view(col, data, num_rows_, std::move(owner));
+  }
+
+  // chunks are not contiguous in the file
+  auto buf = std::make_shared<std::vector<char>>();
+  for (size_t k = 0; k < chunks_.size(); k++) {
+    const char *data = block(k, col, owner);
+    buf->insert(buf->end(), data, data + chunks_[k].raw[col]);
+  }
+  const char *data = buf->data();
+  return view(col, data, num_rows_, std::move(buf));
+}
+
+namespace {
+
+template <typename V, typename F>
+pybind11::array_t<int64_t> per_episode(const std::vector<V> &episodes, F f) {
+  pybind11::array_t<int64_t> out {static_cast<pybind11::ssize_t>(episodes.size())};
+  auto _out = out.mutable_unchecked<1>();
+  for (size_t i = 0; i < episodes.size(); i++) {
+    _out(i) = f(episodes[i]);
+  }
+  return out;
+}
+
+} // namespace
+
+pybind11::array_t<int64_t> TrajectoryReader::get_episode_lengths() const {
+  return per_episode(episodes_, [](const Episode &ep) {return ep.num_rows;});
+}
+
+pybind11::array_t<int64_t> TrajectoryReader::get_episode_streams() const {
+  return per_episode(episodes_, [](const Episode &ep) {return ep.stream;});
+}
+
+bool TrajectoryReader::get_compressed() const {
+  for (const auto &chunk : chunks_) {
+    if (chunk.stored != chunk.raw) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string TrajectoryReader::to_string() const {
+  return std::string("TrajectoryReader(path=") + file_->get_path() +
+    ",num_episodes=" + std::to_string(episodes_.size()) +
+    ",num_rows=" + std::to_string(num_rows_) + ")";
+}
+} // namespace fw_coll_env
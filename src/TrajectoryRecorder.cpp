@@ -0,0 +1,362 @@
+#include <fw-coll-env/TrajectoryRecorder.h>
+
+#include <zlib.h>
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+namespace fw_coll_env {
+
+const std::vector<TrajectoryColumn> &trajectory_columns() {
+  static const std::vector<TrajectoryColumn> columns {
+    {"t", "<f8", sizeof(double), 1, offsetof(TrajectoryRow, t)},
+    {"x", "<f8", sizeof(double), 8, offsetof(TrajectoryRow, x)},
+    {"action", "<f8", sizeof(double), 6, offsetof(TrajectoryRow, action)},
+    {"requested_idx", "<i4", sizeof(int32_t), 1, offsetof(TrajectoryRow, requested_idx)},
+    {"executed_idx", "<i4", sizeof(int32_t), 1, offsetof(TrajectoryRow, executed_idx)},
+    {"overridden", "|b1", sizeof(bool), 1, offsetof(TrajectoryRow, overridden)},
+    {"dist_to_veh", "<f8", sizeof(double), 1, offsetof(TrajectoryRow, dist_to_veh)},
+    {"dist_to_goal1", "<f8", sizeof(double), 1, offsetof(TrajectoryRow, dist_to_goal1)},
+    {"dist_to_goal2", "<f8", sizeof(double), 1, offsetof(TrajectoryRow, dist_to_goal2)},
+    {"dist_closest_approach", "<f8", sizeof(double), 1,
+     offsetof(TrajectoryRow, dist_closest_approach)},
+    {"done_time", "|b1", sizeof(bool), 1, offsetof(TrajectoryRow, done_time)},
+    {"done_goal", "|b1", sizeof(bool), 1, offsetof(TrajectoryRow, done_goal)},
+    {"done_collision", "|b1", sizeof(bool), 1, offsetof(TrajectoryRow, done_collision)},
+  };
+  return columns;
+}
+
+TrajectoryRecorder::TrajectoryRecorder(
+    const std::string &path, size_t chunk_rows, int compression_level) :
+      path_(path), chunk_rows_(chunk_rows), compression_level_(compression_level) {
+  if (chunk_rows_ == 0) {
+    throw std::runtime_error("chunk_rows must be positive");
+  }
+  if (compression_level_ < 0 || compression_level_ > 9) {
+    throw std::runtime_error("compression_level must be in [0, 9]");
+  }
+
+  out_.open(path_, std::ios::binary | std::ios::trunc);
+  if (!out_) {
+    throw std::runtime_error("could not open " + path_);
+  }
+  pending_.data.resize(trajectory_columns().size());
+
+  write(trajectory_magic, 8);
+  write(&trajectory_version, sizeof(trajectory_version));
+  pad();
+  writer_ = std::thread(&TrajectoryRecorder::writer_loop, this);
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+  try {
+    close();
+  } catch (...) {
+    // nothing to report to from a destructor
+  }
+  if (writer_.joinable()) {
+    // close threw before joining
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_writer_ = true;
+    }
+    queued_cv_.notify_all();
+    writer_.join();
+  }
+}
+
+size_t TrajectoryRecorder::add_stream() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  check_open_locked();
+  streams_.push_back(std::make_unique<Stream>());
+  streams_.back()->cols.data.resize(trajectory_columns().size());
+  return streams_.size() - 1;
+}
+
+void TrajectoryRecorder::append(size_t stream, const TrajectoryRow &row) {
+  if (stream >= streams_.size()) {
+    throw std::runtime_error("invalid stream for TrajectoryRecorder");
+  }
+
+  Stream &st = *streams_[stream];
+  std::lock_guard<std::mutex> lock(st.mutex);
+  if (st.closed) {
+    throw std::runtime_error("TrajectoryRecorder " + path_ + " is closed");
+  }
+  Columns &cols = st.cols;
+  const auto &columns = trajectory_columns();
+  const char *src = reinterpret_cast<const char *>(&row);
+  for (size_t c = 0; c < columns.size(); c++) {
+    const char *field = src + columns[c].offset;
+    cols.data[c].insert(cols.data[c].end(), field, field + columns[c].row_bytes());
+  }
+  cols.rows++;
+}
+
+void TrajectoryRecorder::check_open_locked() const {
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  if (stop_writer_) {
+    throw std::runtime_error("TrajectoryRecorder " + path_ + " is closed");
+  }
+}
+
+void TrajectoryRecorder::end_episode(size_t stream) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  check_open_locked();
+  if (stream >= streams_.size()) {
+    throw std::runtime_error("invalid stream for TrajectoryRecorder");
+  }
+  end_episode_locked(stream);
+  if (pending_.rows >= chunk_rows_) {
+    queue_pending_locked(lock);
+  }
+}
+
+void TrajectoryRecorder::end_episode_locked(size_t stream) {
+  Stream &st = *streams_[stream];
+  std::lock_guard<std::mutex> stream_lock(st.mutex);
+  Columns &cols = st.cols;
+  if (cols.rows == 0) {
+    return;
+  }
+
+  episodes_.push_back(
+      {rows_queued_ + pending_.rows, cols.rows, chunks_queued_, stream});
+  for (size_t c = 0; c < cols.data.size(); c++) {
+    pending_.data[c].insert(pending_.data[c].end(), cols.data[c].begin(), cols.data[c].end());
+    cols.data[c].clear();
+  }
+  pending_.rows += cols.rows;
+  cols.rows = 0;
+}
+
+void TrajectoryRecorder::queue_pending_locked(std::unique_lock<std::mutex> &lock) {
+  if (pending_.rows == 0) {
+    return;
+  }
+  // bound the memory of chunks waiting on a slow writer
+  written_cv_.wait(lock, [this] {
+    return queue_.size() < max_queued_chunks_ || error_ || stop_writer_;
+  });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+  if (pending_.rows == 0) {
+    // queued by another thread (or close) while this one waited
+    return;
+  }
+
+  queue_.push_back({rows_queued_, std::move(pending_)});
+  rows_queued_ += queue_.back().cols.rows;
+  chunks_queued_++;
+  pending_ = Columns();
+  pending_.data.resize(trajectory_columns().size());
+  queued_cv_.notify_one();
+}
+
+void TrajectoryRecorder::wait_written_locked(std::unique_lock<std::mutex> &lock) {
+  written_cv_.wait(lock, [this] {
+    return (queue_.empty() && !writing_) || error_;
+  });
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+}
+
+void TrajectoryRecorder::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  check_open_locked();
+  queue_pending_locked(lock);
+  wait_written_locked(lock);
+  // close may have started while this waited, and then owns out_
+  check_open_locked();
+  // the writer is idle and waits for mutex_ to take the next chunk
+  out_.flush();
+}
+
+void TrajectoryRecorder::writer_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    queued_cv_.wait(lock, [this] {return stop_writer_ || !queue_.empty();});
+    if (queue_.empty() || error_) {
+      return;
+    }
+
+    QueuedChunk queued = std::move(queue_.front());
+    queue_.pop_front();
+    writing_ = true;
+    lock.unlock();
+    // compress and write without blocking end_episode
+    Chunk chunk;
+    std::exception_ptr error;
+    try {
+      chunk = write_chunk(queued);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+
+    writing_ = false;
+    if (error) {
+      error_ = error;
+      queue_.clear();
+    } else {
+      chunks_.push_back(std::move(chunk));
+    }
+    written_cv_.notify_all();
+  }
+}
+
+TrajectoryRecorder::Chunk TrajectoryRecorder::write_chunk(QueuedChunk &queued) {
+  Chunk chunk {queued.row_begin, queued.cols.rows, {}, {}, {}};
+  std::vector<Bytef> deflated;
+  for (auto &block : queued.cols.data) {
+    pad();
+    chunk.offset.push_back(bytes_written_);
+    chunk.raw.push_back(block.size());
+
+    // blocks that do not shrink are kept raw so the reader can map them
+    bool stored_raw = true;
+    if (compression_level_ > 0) {
+      uLongf size = compressBound(block.size());
+      deflated.resize(size);
+      if (compress2(deflated.data(), &size, reinterpret_cast<const Bytef *>(block.data()),
+                    block.size(), compression_level_) != Z_OK) {
+        throw std::runtime_error("could not compress a chunk of " + path_);
+      }
+      if (size < block.size()) {
+        write(deflated.data(), size);
+        chunk.stored.push_back(size);
+        stored_raw = false;
+      }
+    }
+    if (stored_raw) {
+      write(block.data(), block.size());
+      chunk.stored.push_back(block.size());
+    }
+    block.clear();
+  }
+  return chunk;
+}
+
+void TrajectoryRecorder::close() {
+  std::lock_guard<std::mutex> close_lock(close_mutex_);
+  if (closed_) {
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!stop_writer_) {
+      // no stream takes rows after its episode is ended here
+      for (size_t s = 0; s < streams_.size(); s++) {
+        {
+          std::lock_guard<std::mutex> stream_lock(streams_[s]->mutex);
+          streams_[s]->closed = true;
+        }
+        end_episode_locked(s);
+      }
+      if (!error_) {
+        queue_pending_locked(lock);
+      }
+      stop_writer_ = true;
+    }
+  }
+  queued_cv_.notify_all();
+  if (writer_.joinable()) {
+    writer_.join();
+  }
+  if (error_) {
+    std::rethrow_exception(error_);
+  }
+
+  // only this thread is left writing
+  pad();
+  const uint64_t footer_offset = bytes_written_;
+  auto write_u64 = [this](uint64_t val) {write(&val, sizeof(val));};
+  const auto &columns = trajectory_columns();
+  write_u64(columns.size());
+  for (const auto &c : columns) {
+    char name[32] = {};
+    char dtype[8] = {};
+    std::strncpy(name, c.name, sizeof(name) - 1);
+    std::strncpy(dtype, c.dtype, sizeof(dtype) - 1);
+    write(name, sizeof(name));
+    write(dtype, sizeof(dtype));
+    write_u64(c.width);
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  write_u64(chunks_.size());
+  for (const auto &chunk : chunks_) {
+    write_u64(chunk.row_begin);
+    write_u64(chunk.num_rows);
+    for (size_t c = 0; c < columns.size(); c++) {
+      write_u64(chunk.offset[c]);
+      write_u64(chunk.stored[c]);
+      write_u64(chunk.raw[c]);
+    }
+  }
+  write_u64(episodes_.size());
+  for (const auto &ep : episodes_) {
+    write_u64(ep.row_begin);
+    write_u64(ep.num_rows);
+    write_u64(ep.chunk);
+    write_u64(ep.stream);
+  }
+  write_u64(footer_offset);
+  write(trajectory_magic, 8);
+
+  out_.close();
+  if (!out_) {
+    throw std::runtime_error("could not write " + path_);
+  }
+  closed_ = true;
+}
+
+void TrajectoryRecorder::write(const void *data, size_t size) {
+  out_.write(static_cast<const char *>(data), size);
+  if (!out_) {
+    throw std::runtime_error("could not write " + path_);
+  }
+  bytes_written_ += size;
+}
+
+void TrajectoryRecorder::pad() {
+  static const char zeros[trajectory_align] = {};
+  write(zeros, (trajectory_align - bytes_written_ % trajectory_align) % trajectory_align);
+}
+
+size_t TrajectoryRecorder::get_num_streams() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return streams_.size();
+}
+
+size_t TrajectoryRecorder::get_num_rows() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return rows_queued_ + pending_.rows;
+}
+
+size_t TrajectoryRecorder::get_num_episodes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return episodes_.size();
+}
+
+size_t TrajectoryRecorder::get_num_chunks() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return chunks_.size();
+}
+
+size_t TrajectoryRecorder::get_bytes_written() const {
+  return bytes_written_;
+}
+
+std::string TrajectoryRecorder::to_string() const {
+  return std::string("TrajectoryRecorder(path=") + path_ +
+    ",chunk_rows=" + std::to_string(chunk_rows_) +
+    ",compression_level=" + std::to_string(compression_level_) + ")";
+}
+} // namespace fw_coll_env
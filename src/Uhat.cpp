@@ -1,11 +1,13 @@
 
 #include <fw-coll-env/Uhat.h>
+#include <fw-coll-env/Profiler.h>
 
 #include <cmath>
 
 namespace fw_coll_env {
 
-FwSingleAction Uhat::calc(const FwSingleState &x0) {
+FwSingleAction Uhat::calc(const FwSingleState &x0) const {
+  FW_PROFILE_COUNT(uhat_calls, 1);
   double gain = 1;
   double l = 1;
 
@@ -0,0 +1,157 @@
+#include <fw-coll-env/UniformGrid.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace fw_coll_env {
+
+UniformGrid::UniformGrid(double cell_size) {
+  if (!(cell_size > 0)) {
+    throw std::runtime_error("UniformGrid cell_size must be positive");
+  }
+  fine_.size = coarse_.size = cell_size;
+}
+
+void UniformGrid::bucket(Level &level, int shift) {
+  level.shift = shift;
+  level.size = std::ldexp(fine_.size, shift);
+  level.order.clear();
+  level.cells.clear();
+  level.min_cell = {std::numeric_limits<int32_t>::max(), std::numeric_limits<int32_t>::max()};
+  level.max_cell = {std::numeric_limits<int32_t>::min(), std::numeric_limits<int32_t>::min()};
+
+  std::vector<std::pair<uint64_t, uint32_t>> keyed;
+  for (size_t i = 0; i < points_.size(); i++) {
+    if (!active_[i]) {
+      continue;
+    }
+    const Cell c = level.cell_of(point_cells_[i]);
+    keyed.emplace_back(key(c.first, c.second), i);
+    level.min_cell = {std::min(level.min_cell.first, c.first),
+                      std::min(level.min_cell.second, c.second)};
+    level.max_cell = {std::max(level.max_cell.first, c.first),
+                      std::max(level.max_cell.second, c.second)};
+  }
+  std::sort(keyed.begin(), keyed.end());
+
+  level.order.reserve(keyed.size());
+  level.cells.reserve(keyed.size());
+  for (size_t k = 0; k < keyed.size(); k++) {
+    level.order.push_back(keyed[k].second);
+    if (k == 0 || keyed[k].first != keyed[k - 1].first) {
+      level.cells[keyed[k].first] = {k, k + 1};
+    } else {
+      level.cells[keyed[k].first].second = k + 1;
+    }
+  }
+}
+
+void UniformGrid::build(const std::vector<Point> &points, const std::vector<bool> &active) {
+  if (points.size() != active.size()) {
+    throw std::runtime_error("UniformGrid points and active differ in size");
+  }
+
+  points_ = points;
+  active_ = active;
+  point_cells_.resize(points_.size());
+  for (size_t i = 0; i < points_.size(); i++) {
+    if (active_[i]) {
+      point_cells_[i] = {static_cast<int32_t>(std::floor(points_[i].x / fine_.size)),
+                         static_cast<int32_t>(std::floor(points_[i].y / fine_.size))};
+    }
+  }
+  bucket(fine_, 0);
+
+  // coarsen until the occupied cells hold about two points each. Counting
+  // occupied cells rather than using the bounding box keeps outliers from
+  // coarsening the cells of a dense crowd.
+  const size_t num_active = fine_.order.size();
+  int shift = 0;
+  size_t num_cells = fine_.cells.size();
+  std::unordered_set<uint64_t> occupied;
+  while (num_active > 1 && 2 * num_cells > num_active && shift < 30) {
+    shift++;
+    occupied.clear();
+    for (uint32_t i : fine_.order) {
+      const Cell c {point_cells_[i].first >> shift, point_cells_[i].second >> shift};
+      occupied.insert(key(c.first, c.second));
+    }
+    num_cells = occupied.size();
+  }
+  bucket(coarse_, shift);
+}
+
+void UniformGrid::pairs_within(
+    double radius, std::vector<std::pair<int, int>> &out) const {
+  // the level whose cells are closest to radius without exceeding it
+  const Level &level = coarse_.size <= radius ? coarse_ : fine_;
+  const auto reach = static_cast<int32_t>(std::ceil(radius / level.size));
+  for (uint32_t i : level.order) {
+    const Cell c = level.cell_of(point_cells_[i]);
+    for (int32_t dx = -reach; dx <= reach; dx++) {
+      for (int32_t dy = -reach; dy <= reach; dy++) {
+        for_cell(level, c.first + dx, c.second + dy, [&](uint32_t j) {
+          if (j > i && dist(i, j) <= radius) {
+            out.emplace_back(i, j);
+          }
+        });
+      }
+    }
+  }
+}
+
+int UniformGrid::nearest(size_t i, double &best_dist) const {
+  best_dist = std::numeric_limits<double>::infinity();
+  if (i >= points_.size() || !active_[i] || coarse_.order.size() < 2) {
+    return -1;
+  }
+  const Cell c = coarse_.cell_of(point_cells_[i]);
+
+  int best = -1;
+  auto visit = [&](uint32_t j) {
+    if (j != i) {
+      const double d = dist(i, j);
+      if (d < best_dist) {
+        best_dist = d;
+        best = j;
+      }
+    }
+  };
+
+  const int32_t max_ring = std::max(
+      std::max(c.first - coarse_.min_cell.first, coarse_.max_cell.first - c.first),
+      std::max(c.second - coarse_.min_cell.second, coarse_.max_cell.second - c.second));
+  for (int32_t r = 0; r <= max_ring; r++) {
+    const auto side = static_cast<size_t>(2 * r + 1);
+    if (side * side > coarse_.order.size()) {
+      // sparse points, scanning them is cheaper than more rings
+      for (uint32_t j : coarse_.order) {
+        visit(j);
+      }
+      return best;
+    }
+
+    // the border of the (2r + 1) x (2r + 1) block of cells
+    if (r == 0) {
+      for_cell(coarse_, c.first, c.second, visit);
+    }
+    for (int32_t d = -r; r > 0 && d <= r; d++) {
+      for_cell(coarse_, c.first + d, c.second - r, visit);
+      for_cell(coarse_, c.first + d, c.second + r, visit);
+      if (d > -r && d < r) {
+        for_cell(coarse_, c.first - r, c.second + d, visit);
+        for_cell(coarse_, c.first + r, c.second + d, visit);
+      }
+    }
+
+    // points in rings beyond r are at least r cells away horizontally
+    if (best_dist <= r * coarse_.size) {
+      break;
+    }
+  }
+  return best;
+}
+} // namespace fw_coll_env
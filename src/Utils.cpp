@@ -5,7 +5,8 @@
 
 namespace fw_coll_env {
 
-void fw_dynamics(double dt, const FwSingleAction &a, FwSingleState &x) {
+template <typename T>
+void fw_dynamics(T dt, const FwSingleActionT<T> &a, FwSingleStateT<T> &x) {
   x.p.x += a.v * std::cos(x.th) * dt;
   x.p.y += a.v * std::sin(x.th) * dt;
   x.th += a.w * dt;
@@ -16,33 +17,39 @@ std::string bool2str(bool val) {
   return val ? "True" : "False";
 }
 
-double Point::dist(const Point &p) const {
+template <typename T>
+T PointT<T>::dist(const PointT &p) const {
   return std::sqrt(
-    std::pow(x - p.x, 2) +
-    std::pow(y - p.y, 2) +
-    std::pow(z - p.z, 2));
+    (x - p.x) * (x - p.x) +
+    (y - p.y) * (y - p.y) +
+    (z - p.z) * (z - p.z));
 }
 
-bool Point::operator==(const Point &p) const {
+template <typename T>
+bool PointT<T>::operator==(const PointT &p) const {
   return x == p.x && y == p.y && z == p.z;
 }
 
-std::string Point::to_string() const {
+template <typename T>
+std::string PointT<T>::to_string() const {
   return std::string("Point(x=") + std::to_string(x) +
     ",y=" + std::to_string(y) + ",z=" + std::to_string(z) + ")";
 }
 
-bool FwSingleState::operator==(const FwSingleState &_x) const {
+template <typename T>
+bool FwSingleStateT<T>::operator==(const FwSingleStateT &_x) const {
   return p == _x.p && th == _x.th;
 }
 
-std::string FwSingleState::to_string() const {
+template <typename T>
+std::string FwSingleStateT<T>::to_string() const {
   return std::string("FwSingleState(p=") + p.to_string() +
     ",th=" + std::to_string(th) + ")";
 }
 
-pybind11::array_t<double> FwState::asarray() const {
-  pybind11::array_t<double> out{8};
+template <typename T>
+pybind11::array_t<T> FwStateT<T>::asarray() const {
+  pybind11::array_t<T> out{8};
   out.mutable_at(0) = x1.p.x;
   out.mutable_at(1) = x1.p.y;
   out.mutable_at(2) = x1.th;
@@ -55,49 +62,77 @@ pybind11::array_t<double> FwState::asarray() const {
   return out;
 }
 
-std::string FwState::to_string() const {
+template <typename T>
+bool FwStateT<T>::operator==(const FwStateT &_x) const {
+  return x1 == _x.x1 && x2 == _x.x2;
+}
+
+template <typename T>
+std::string FwStateT<T>::to_string() const {
   return std::string("FwState(x1=") + x1.to_string() +
     ",x2=" + x2.to_string() + ")";
 }
 
-double FwSingleAction::dist_sq(const FwSingleAction &ac) const {
-  return std::pow(v - ac.v, 2) +
-    std::pow(w - ac.w, 2) +
-    std::pow(dz - ac.dz, 2);
+template <typename T>
+T FwSingleActionT<T>::dist_sq(const FwSingleActionT &ac) const {
+  return (v - ac.v) * (v - ac.v) +
+    (w - ac.w) * (w - ac.w) +
+    (dz - ac.dz) * (dz - ac.dz);
 }
 
-double FwSingleAction::dist(const FwSingleAction &ac) const {
+template <typename T>
+T FwSingleActionT<T>::dist(const FwSingleActionT &ac) const {
   return std::sqrt(dist_sq(ac));
 }
 
-bool FwSingleAction::operator==(const FwSingleAction &ac) const {
+template <typename T>
+bool FwSingleActionT<T>::operator==(const FwSingleActionT &ac) const {
   return v == ac.v && w == ac.w && dz == ac.dz;
 }
 
-bool FwSingleAction::operator<(const FwSingleAction &ac) const {
+template <typename T>
+bool FwSingleActionT<T>::operator<(const FwSingleActionT &ac) const {
   return v < ac.v ||
     (v == ac.v && w < ac.w) ||
     (v == ac.v && w == ac.w && dz < ac.dz);
 }
 
-std::string FwSingleAction::to_string() const {
+template <typename T>
+std::string FwSingleActionT<T>::to_string() const {
   return std::string("FwSingleAction(v=") + std::to_string(v) +
     ",w=" + std::to_string(w) + ",dz=" + std::to_string(dz) + ")";
 }
 
-bool FwAction::operator==(const FwAction &ac) const {
+template <typename T>
+bool FwActionT<T>::operator==(const FwActionT &ac) const {
   return a1 == ac.a1 && a2 == ac.a2;
 }
 
-std::string FwAction::to_string() const {
+template <typename T>
+std::string FwActionT<T>::to_string() const {
   return std::string("FwAction(a1=") + a1.to_string() +
     ",a2=" + a2.to_string() + ")";
 }
 
-double FwAction::dist(const FwAction &ac) const {
+template <typename T>
+T FwActionT<T>::dist(const FwActionT &ac) const {
   return std::sqrt(a1.dist_sq(ac.a1) + a2.dist_sq(ac.a2));
 }
 
+template struct PointT<float>;
+template struct PointT<double>;
+template struct FwSingleStateT<float>;
+template struct FwSingleStateT<double>;
+template struct FwStateT<float>;
+template struct FwStateT<double>;
+template struct FwSingleActionT<float>;
+template struct FwSingleActionT<double>;
+template struct FwActionT<float>;
+template struct FwActionT<double>;
+template void fw_dynamics(float, const FwSingleActionT<float> &, FwSingleStateT<float> &);
+template void fw_dynamics(
+    double, const FwSingleActionT<double> &, FwSingleStateT<double> &);
+
 double Rho::operator()(const FwState &x) const {
   return std::min(max_val_, x.x1.p.dist(x.x2.p) - safety_dist_);
 }
@@ -7,16 +7,30 @@
 
 #include <fw-coll-env/BarrierGammaTurn.h>
 #include <fw-coll-env/BarrierGammaStraight.h>
+#include <fw-coll-env/ActorPool.h>
+#include <fw-coll-env/BarrierComposite.h>
+#include <fw-coll-env/BarrierFilter.h>
+#include <fw-coll-env/EncounterGenerator.h>
 #include <fw-coll-env/FwActionIndex.h>
 #include <fw-coll-env/FwAvailActions.h>
 #include <fw-coll-env/FwCollisionEnv.h>
+#include <fw-coll-env/FwCollisionEnvBatch.h>
+#include <fw-coll-env/FwMultiCollisionEnv.h>
+#include <fw-coll-env/MpcPlanner.h>
+#include <fw-coll-env/MultiBarrierFilter.h>
+#include <fw-coll-env/Profiler.h>
+#include <fw-coll-env/RealtimeSim.h>
+#include <fw-coll-env/ReplayBuffer.h>
+#include <fw-coll-env/StreamingRelabeler.h>
+#include <fw-coll-env/TrajectoryReader.h>
+#include <fw-coll-env/TrajectoryRecorder.h>
 #include <fw-coll-env/Uhat.h>
 #include <fw-coll-env/Utils.h>
 
 namespace py = pybind11;
 
 PYBIND11_MODULE(fw_coll_env_c, m) {
-  m.def("fw_dynamics", &fw_coll_env::fw_dynamics,
+  m.def("fw_dynamics", &fw_coll_env::fw_dynamics<double>,
         py::arg("dt"), py::arg("ac"), py::arg("x"));
 
   using Pt = fw_coll_env::Point;
@@ -26,7 +40,10 @@ PYBIND11_MODULE(fw_coll_env_c, m) {
   using FwAc = fw_coll_env::FwAction;
   using BFTurn = fw_coll_env::BarrierGammaTurn;
   using BFStraight = fw_coll_env::BarrierGammaStraight;
+  using BFComposite = fw_coll_env::BarrierComposite;
+  using BFFilter = fw_coll_env::BarrierFilter;
   using FwEnv = fw_coll_env::FwCollisionEnv;
+  using FwEnvBatch = fw_coll_env::FwCollisionEnvBatch;
 
   py::class_<Pt>(m, "Point")
     .def(py::init<double, double, double>(),
@@ -214,34 +231,61 @@ PYBIND11_MODULE(fw_coll_env_c, m) {
     .def_readonly("done_collision", &fw_coll_env::FwEnvStats::done_collision)
     .def_readonly("dist_to_goal1", &fw_coll_env::FwEnvStats::dist_to_goal1)
     .def_readonly("dist_to_goal2", &fw_coll_env::FwEnvStats::dist_to_goal2)
-    .def_readonly("dist_to_veh", &fw_coll_env::FwEnvStats::dist_to_veh);
+    .def_readonly("dist_to_veh", &fw_coll_env::FwEnvStats::dist_to_veh)
+    .def_readonly("t_closest_approach", &fw_coll_env::FwEnvStats::t_closest_approach)
+    .def_readonly("dist_closest_approach", &fw_coll_env::FwEnvStats::dist_closest_approach);
 
+  // Python copies get their own shield instead of sharing it
+  auto copy_env = [](const FwEnv &e) {
+    FwEnv copy(e);
+    if (e.has_shield()) {
+      copy.set_shield(*e.get_shield());
+    }
+    return copy;
+  };
   py::class_<FwEnv>(m, "FwCollisionEnv")
     .def(py::init<double, double, double, double,
-                  const Pt&, const Pt&, double>(),
+                  const Pt&, const Pt&, double, bool>(),
          py::arg("dt"), py::arg("max_sim_time"), py::arg("done_dist"),
          py::arg("safety_dist"), py::arg("goal1"), py::arg("goal2"),
-         py::arg("time_warp"))
-    .def("__copy__", [](const FwEnv &e){return FwEnv(e);})
-    .def("__deepcopy__", [](const FwEnv &e, py::dict){return FwEnv(e);})
+         py::arg("time_warp"), py::arg("continuous_collision") = false)
+    .def("__copy__", copy_env)
+    .def("__deepcopy__", [copy_env](const FwEnv &e, py::dict){return copy_env(e);})
     .def(py::pickle(
         [](const FwEnv &e) {return py::make_tuple(
           e.get_dt(), e.get_max_sim_time(), e.get_done_dist(), e.get_safety_dist(),
           e.get_goal1(), e.get_goal2(), e.get_time_warp(),
-          e.get_x1(), e.get_x2(), e.get_t());},
+          e.get_x1(), e.get_x2(), e.get_t(), e.get_continuous_collision(),
+          e.has_shield() ? py::cast(*e.get_shield()) : py::none());},
         [](py::tuple t) { // __setstate__
-            if (t.size() != 10) {
+            if (t.size() < 10 || t.size() > 12) {
                 throw std::runtime_error("Invalid tuple provided for FwEnv!");
             }
             FwEnv e = FwEnv(
                 t[0].cast<double>(), t[1].cast<double>(),
                 t[2].cast<double>(), t[3].cast<double>(),
-                t[4].cast<Pt>(), t[5].cast<Pt>(), t[6].cast<double>());
+                t[4].cast<Pt>(), t[5].cast<Pt>(), t[6].cast<double>(),
+                t.size() >= 11 && t[10].cast<bool>());
             e.reset(t[7].cast<FwSngSt>(), t[8].cast<FwSngSt>(), t[9].cast<double>());
+            if (t.size() == 12 && !t[11].is_none()) {
+              e.set_shield(t[11].cast<const BFTurn &>());
+            }
             return e;
         }))
-    .def("step", &FwEnv::step)
+    .def("step", py::overload_cast<const FwSngAc&, const FwSngAc&>(&FwEnv::step))
+    .def("step", &FwEnv::step_shielded, py::arg("action_idx"))
+    .def("step_n", &FwEnv::step_n, py::arg("a1"), py::arg("a2"), py::arg("k"))
     .def("reset", &FwEnv::reset)
+    .def("set_shield", &FwEnv::set_shield, py::arg("barrier"))
+    .def("clear_shield", &FwEnv::clear_shield)
+    .def_property_readonly("has_shield", &FwEnv::has_shield)
+    .def("set_recorder",
+         py::overload_cast<std::shared_ptr<fw_coll_env::TrajectoryRecorder>>(
+             &FwEnv::set_recorder),
+         py::arg("recorder"))
+    .def("clear_recorder", &FwEnv::clear_recorder)
+    .def_property_readonly("has_recorder", &FwEnv::has_recorder)
+    .def_property_readonly("recorder", &FwEnv::get_recorder)
     .def_property_readonly("x1", &FwEnv::get_x1)
     .def_property_readonly("x2", &FwEnv::get_x2)
     .def_property_readonly("t", &FwEnv::get_t)
@@ -253,9 +297,74 @@ PYBIND11_MODULE(fw_coll_env_c, m) {
     .def_property_readonly("done_dist", &FwEnv::get_done_dist)
     .def_property_readonly("max_sim_time", &FwEnv::get_max_sim_time)
     .def_property_readonly("time_warp", &FwEnv::get_time_warp)
+    .def_property("continuous_collision",
+                  &FwEnv::get_continuous_collision, &FwEnv::set_continuous_collision)
     .def_property_readonly("collided", &FwEnv::get_collided)
     .def_readonly("stats", &FwEnv::stats);
 
+  py::class_<FwEnvBatch>(m, "FwCollisionEnvBatch")
+    .def(py::init<const FwEnv&, size_t, const fw_coll_env::FwAvailActions&,
+                  size_t, size_t>(),
+         py::arg("env"), py::arg("num_envs"), py::arg("avail_actions"),
+         py::arg("num_threads") = 1, py::arg("shard_size") = 1024)
+    .def("__repr__", &FwEnvBatch::to_string)
+    .def("__len__", &FwEnvBatch::size)
+    .def("reset", &FwEnvBatch::reset, py::arg("x"), py::arg("t") = 0.0)
+    .def("step", &FwEnvBatch::step,
+         py::arg("a1_idx"), py::arg("reset_x") = py::none())
+    .def("step_n", &FwEnvBatch::step_n,
+         py::arg("a1_idx"), py::arg("k"), py::arg("reset_x") = py::none())
+    .def("step_shielded", &FwEnvBatch::step_shielded,
+         py::arg("a1_idx"), py::arg("reset_x") = py::none())
+    .def("set_shield", &FwEnvBatch::set_shield,
+         py::arg("barrier"), py::arg("single_precision") = false)
+    .def("clear_shield", &FwEnvBatch::clear_shield)
+    .def_property_readonly("has_shield", &FwEnvBatch::has_shield)
+    .def_property_readonly("has_single_precision_shield",
+                           &FwEnvBatch::has_single_precision_shield)
+    .def("set_recorder", &FwEnvBatch::set_recorder, py::arg("recorder"))
+    .def("clear_recorder", &FwEnvBatch::clear_recorder)
+    .def("env", &FwEnvBatch::get_env, py::arg("i"))
+    .def_property_readonly("states", &FwEnvBatch::get_states)
+    .def_property_readonly("t", &FwEnvBatch::get_t)
+    .def_property_readonly("done", &FwEnvBatch::get_done)
+    .def_property_readonly("collided", &FwEnvBatch::get_collided)
+    .def_property_readonly("dist_to_veh", &FwEnvBatch::get_dist_to_veh)
+    .def_property_readonly("dist_to_goal1", &FwEnvBatch::get_dist_to_goal1)
+    .def_property_readonly("dist_to_goal2", &FwEnvBatch::get_dist_to_goal2)
+    .def_property_readonly("num_threads", &FwEnvBatch::get_num_threads)
+    .def_property_readonly("shard_size", &FwEnvBatch::get_shard_size);
+
+  using FwMultiEnv = fw_coll_env::FwMultiCollisionEnv;
+  py::class_<FwMultiEnv>(m, "FwMultiCollisionEnv")
+    .def(py::init<double, double, double, double, const fw_coll_env::FwAvailActions&>(),
+         py::arg("dt"), py::arg("max_sim_time"), py::arg("done_dist"),
+         py::arg("safety_dist"), py::arg("avail_actions"))
+    .def("__repr__", &FwMultiEnv::to_string)
+    .def("__len__", &FwMultiEnv::size)
+    .def("reset",
+         py::overload_cast<py::array_t<double>, py::array_t<double>, double>(
+             &FwMultiEnv::reset),
+         py::arg("x"), py::arg("goals"), py::arg("t") = 0.0)
+    .def("step", py::overload_cast<py::array_t<int>>(&FwMultiEnv::step),
+         py::arg("a_idx"))
+    .def("pairs_within", &FwMultiEnv::pairs_within, py::arg("radius"))
+    .def_property_readonly("states", &FwMultiEnv::get_states)
+    .def_property_readonly("goal_reached", &FwMultiEnv::get_goal_reached)
+    .def_property_readonly("collided", &FwMultiEnv::get_collided)
+    .def_property_readonly("dist_to_goal", &FwMultiEnv::get_dist_to_goal)
+    .def_property_readonly("nearest", &FwMultiEnv::get_nearest)
+    .def_property_readonly("dist_nearest", &FwMultiEnv::get_dist_nearest)
+    .def_property_readonly("min_sep", &FwMultiEnv::get_min_sep)
+    .def_property_readonly("num_active", &FwMultiEnv::get_num_active)
+    .def_property_readonly("num_collided", &FwMultiEnv::get_num_collided)
+    .def_property_readonly("done", &FwMultiEnv::get_done)
+    .def_property_readonly("t", &FwMultiEnv::get_t)
+    .def_property_readonly("dt", &FwMultiEnv::get_dt)
+    .def_property_readonly("safety_dist", &FwMultiEnv::get_safety_dist)
+    .def_property_readonly("done_dist", &FwMultiEnv::get_done_dist)
+    .def_property_readonly("max_sim_time", &FwMultiEnv::get_max_sim_time);
+
   py::class_<BFTurn>(m, "BarrierGammaTurn")
     .def(py::init<double, double, double,
                   double, double, const fw_coll_env::FwAvailActions&>(),
@@ -278,15 +387,49 @@ PYBIND11_MODULE(fw_coll_env_c, m) {
             return b;
         }))
     .def("__repr__", &BFTurn::to_string)
-    .def("calc_h", &BFTurn::calc_h)
+    .def("calc_h", [](const BFTurn &b, const fw_coll_env::FwState &x) {return b.calc_h(x);})
+    .def("calc_h_grad", &BFTurn::calc_h_grad_batch, py::arg("x"))
+    .def("calc_h_grad_fd", &BFTurn::calc_h_grad_fd, py::arg("x"),
+         py::arg("eps") = 1e-6)
     .def("calc_dh", &BFTurn::calc_dh)
-    .def("choose_u", &BFTurn::choose_u)
+    .def("choose_u",
+         [](BFTurn &b, py::array_t<double> x, py::array_t<int> uhat_idx,
+            bool diagnostics) -> py::object {
+           if (diagnostics) {
+             return py::cast(b.choose_u_diagnostics(x, uhat_idx));
+           }
+           return b.choose_u(x, uhat_idx);
+         },
+         py::arg("x"), py::arg("uhat_idx"), py::arg("diagnostics") = false)
+    .def("choose_u_continuous", &BFTurn::choose_u_continuous,
+         py::arg("x"), py::arg("uhat"), py::arg("grid_fallback") = false)
+    .def("choose_u_anytime", &BFTurn::choose_u_anytime,
+         py::arg("x"), py::arg("uhat_idx"), py::arg("budget_s"),
+         py::arg("per_row") = false)
+    .def("safe_action_mask",
+         py::overload_cast<py::array_t<double>, const fw_coll_env::Uhat&, bool>(
+             &BFTurn::safe_action_mask, py::const_),
+         py::arg("x"), py::arg("uhat2"), py::arg("packed") = false)
+    .def("safe_action_mask",
+         py::overload_cast<py::array_t<double>, py::array_t<int>, bool>(
+             &BFTurn::safe_action_mask, py::const_),
+         py::arg("x"), py::arg("a2_idx"), py::arg("packed") = false)
+    .def("calc_h_f32", &BFTurn::calc_h_f32, py::arg("x"))
+    .def("choose_u_f32", &BFTurn::choose_u_f32, py::arg("x"), py::arg("uhat_idx"))
+    .def("choose_u_hetero", &BFTurn::choose_u_hetero,
+         py::arg("x"), py::arg("uhat_idx"), py::arg("safety_dist"),
+         py::arg("max_val"), py::arg("v"), py::arg("w_deg_per_sec"),
+         py::arg("lmbda"))
     .def_property_readonly("dt", &BFTurn::get_dt)
     .def_property_readonly("max_val", &BFTurn::get_max_val)
     .def_property_readonly("v", &BFTurn::get_v)
     .def_property_readonly("w_rad_per_sec", &BFTurn::get_w_rad_per_sec)
     .def_property_readonly("safety_dist", &BFTurn::get_safety_dist)
-    .def_property_readonly("avail_actions", &BFTurn::get_avail_actions);
+    .def_property_readonly("lmbda", &BFTurn::get_lambda)
+    .def_property_readonly("avail_actions", &BFTurn::get_avail_actions)
+    .def_property_readonly("skipped_steps", &BFTurn::get_skipped_steps)
+    .def_property_readonly("skipped_candidates", &BFTurn::get_skipped_candidates)
+    .def("reset_skipped_counts", &BFTurn::reset_skipped_counts);
 
   py::class_<BFStraight, BFTurn>(m, "BarrierGammaStraight")
     .def(py::init<double, double, double,
@@ -310,21 +453,354 @@ PYBIND11_MODULE(fw_coll_env_c, m) {
             return b;
         }))
     .def("__repr__", &BFStraight::to_string)
-    .def("calc_h", &BFStraight::calc_h)
+    .def("calc_h", [](const BFStraight &b, const fw_coll_env::FwState &x) {return b.calc_h(x);})
+    .def("calc_h_grad", &BFStraight::calc_h_grad_batch, py::arg("x"))
+    .def("calc_h_grad_fd", &BFStraight::calc_h_grad_fd, py::arg("x"),
+         py::arg("eps") = 1e-6)
     .def("calc_dh", &BFStraight::calc_dh)
-    .def("choose_u", &BFStraight::choose_u)
+    .def("choose_u",
+         [](BFStraight &b, py::array_t<double> x, py::array_t<int> uhat_idx,
+            bool diagnostics) -> py::object {
+           if (diagnostics) {
+             return py::cast(b.choose_u_diagnostics(x, uhat_idx));
+           }
+           return b.choose_u(x, uhat_idx);
+         },
+         py::arg("x"), py::arg("uhat_idx"), py::arg("diagnostics") = false)
+    .def("choose_u_continuous", &BFStraight::choose_u_continuous,
+         py::arg("x"), py::arg("uhat"), py::arg("grid_fallback") = false)
+    .def("choose_u_hetero", &BFStraight::choose_u_hetero,
+         py::arg("x"), py::arg("uhat_idx"), py::arg("safety_dist"),
+         py::arg("max_val"), py::arg("v"), py::arg("w_deg_per_sec"),
+         py::arg("lmbda"))
     .def_property_readonly("dt", &BFStraight::get_dt)
     .def_property_readonly("max_val", &BFStraight::get_max_val)
     .def_property_readonly("v", &BFStraight::get_v)
     .def_property_readonly("w_rad_per_sec", &BFStraight::get_w_rad_per_sec)
     .def_property_readonly("safety_dist", &BFStraight::get_safety_dist)
-    .def_property_readonly("avail_actions", &BFStraight::get_avail_actions);
+    .def_property_readonly("lmbda", &BFStraight::get_lambda)
+    .def_property_readonly("avail_actions", &BFStraight::get_avail_actions)
+    .def_property_readonly("skipped_steps", &BFStraight::get_skipped_steps)
+    .def_property_readonly("skipped_candidates", &BFStraight::get_skipped_candidates)
+    .def("reset_skipped_counts", &BFStraight::reset_skipped_counts);
+
+  py::class_<BFComposite, BFTurn>(m, "BarrierComposite")
+    .def(py::init<double, double, double, const std::vector<double>&,
+                  bool, double, const fw_coll_env::FwAvailActions&>(),
+         py::arg("dt"), py::arg("max_val"), py::arg("v"),
+         py::arg("w_deg_per_sec"), py::arg("straight"),
+         py::arg("safety_dist"), py::arg("avail_actions"))
+    .def("__copy__", [](const BFComposite &b){return BFComposite(b);})
+    .def("__deepcopy__", [](const BFComposite &b, py::dict){return BFComposite(b);})
+    .def(py::pickle(
+        [](const BFComposite &b) {return py::make_tuple(
+          b.get_dt(), b.get_max_val(), b.get_v(), b.get_w_deg_per_sec(),
+          b.get_straight(), b.get_safety_dist(), b.get_avail_actions());},
+        [](py::tuple t) { // __setstate__
+            if (t.size() != 7) {
+                throw std::runtime_error("Invalid tuple provided for BarrierComposite!");
+            }
+            BFComposite b = BFComposite(
+                t[0].cast<double>(), t[1].cast<double>(), t[2].cast<double>(),
+                t[3].cast<std::vector<double>>(), t[4].cast<bool>(),
+                t[5].cast<double>(), t[6].cast<fw_coll_env::FwAvailActions>());
+            return b;
+        }))
+    .def("__repr__", &BFComposite::to_string)
+    .def("calc_h_maneuvers",
+         py::overload_cast<const fw_coll_env::FwState&>(
+             &BFComposite::calc_h_maneuvers, py::const_),
+         py::arg("x"))
+    .def("calc_h_batch", &BFComposite::calc_h_batch, py::arg("x"))
+    .def_property_readonly("w_deg_per_sec", &BFComposite::get_w_deg_per_sec)
+    .def_property_readonly("straight", &BFComposite::get_straight)
+    .def_property_readonly("num_maneuvers", &BFComposite::num_maneuvers);
+
+  py::class_<BFFilter>(m, "BarrierFilter")
+    .def(py::init<const BFTurn&, size_t>(),
+         py::arg("barrier"), py::arg("num_envs"))
+    .def("__repr__", &BFFilter::to_string)
+    .def("__len__", &BFFilter::size)
+    .def("calc_h", &BFFilter::calc_h, py::arg("env"), py::arg("x"))
+    .def("choose_u", &BFFilter::choose_u, py::arg("x"), py::arg("uhat_idx"))
+    .def("reset", &BFFilter::reset, py::arg("env"))
+    .def("reset_all", &BFFilter::reset_all)
+    .def_property_readonly("cache_hits", &BFFilter::get_cache_hits)
+    .def_property_readonly("cache_misses", &BFFilter::get_cache_misses);
+
+  using MultiFilter = fw_coll_env::MultiBarrierFilter;
+  py::class_<MultiFilter>(m, "MultiBarrierFilter")
+    .def(py::init<const BFTurn&, size_t>(),
+         py::arg("barrier"), py::arg("max_sweeps") = 10)
+    .def("__repr__", &MultiFilter::to_string)
+    .def("choose_u",
+         py::overload_cast<py::array_t<double>, py::array_t<int>>(&MultiFilter::choose_u),
+         py::arg("x"), py::arg("uhat_idx"))
+    .def("choose_u_env", &MultiFilter::choose_u_env,
+         py::arg("env"), py::arg("uhat_idx"))
+    .def_property_readonly("cull_dist", &MultiFilter::get_cull_dist)
+    .def_property_readonly("max_sweeps", &MultiFilter::get_max_sweeps)
+    .def_property_readonly("num_pairs", &MultiFilter::get_num_pairs)
+    .def_property_readonly("num_violated", &MultiFilter::get_num_violated)
+    .def_property_readonly("num_evals", &MultiFilter::get_num_evals)
+    .def_property_readonly("num_sweeps", &MultiFilter::get_num_sweeps)
+    .def_property_readonly("num_unresolved", &MultiFilter::get_num_unresolved);
+
+  py::class_<fw_coll_env::EncounterGenerator>(m, "EncounterGenerator")
+    .def(py::init<py::array_t<double>, py::array_t<double>,
+                  double, double, double, double, double, uint64_t>(),
+         py::arg("veh1_lims"), py::arg("veh2_lims"), py::arg("v1"), py::arg("v2"),
+         py::arg("horizon"), py::arg("max_miss"), py::arg("conflict_frac") = 0.5,
+         py::arg("seed") = 0)
+    .def("__repr__", &fw_coll_env::EncounterGenerator::to_string)
+    .def("sample", &fw_coll_env::EncounterGenerator::sample, py::arg("n"))
+    .def("weights", &fw_coll_env::EncounterGenerator::weights, py::arg("x"))
+    .def("seed", &fw_coll_env::EncounterGenerator::seed, py::arg("seed"))
+    .def_property_readonly("conflict_frac",
+                           &fw_coll_env::EncounterGenerator::get_conflict_frac)
+    .def_property_readonly("horizon", &fw_coll_env::EncounterGenerator::get_horizon)
+    .def_property_readonly("max_miss", &fw_coll_env::EncounterGenerator::get_max_miss);
+
+  using RB = fw_coll_env::ReplayBuffer;
+  py::class_<RB>(m, "ReplayBuffer")
+    .def(py::init<size_t, const fw_coll_env::FwAvailActions&,
+                  py::array_t<double>, py::array_t<double>, uint64_t>(),
+         py::arg("capacity"), py::arg("avail_actions"), py::arg("state_lims"),
+         py::arg("obs_lims"), py::arg("seed") = 0)
+    .def("__repr__", &RB::to_string)
+    .def("__len__", &RB::size)
+    .def("add", &RB::add,
+         py::arg("x"), py::arg("obs"), py::arg("action_idx"), py::arg("overridden"),
+         py::arg("priorities") = py::none())
+    .def("sample", &RB::sample,
+         py::arg("x_out").noconvert(), py::arg("obs_out").noconvert(),
+         py::arg("action_out").noconvert(), py::arg("overridden_out").noconvert(),
+         py::arg("idx_out").noconvert())
+    .def("sample_prioritized", &RB::sample_prioritized,
+         py::arg("x_out").noconvert(), py::arg("obs_out").noconvert(),
+         py::arg("action_out").noconvert(), py::arg("overridden_out").noconvert(),
+         py::arg("idx_out").noconvert(), py::arg("prob_out").noconvert())
+    .def("update_priorities", &RB::update_priorities,
+         py::arg("idx"), py::arg("priorities"))
+    .def_property_readonly("capacity", &RB::get_capacity)
+    .def_property_readonly("obs_dim", &RB::get_obs_dim)
+    .def_property_readonly("num_inserted", &RB::get_num_inserted)
+    .def_property_readonly("total_priority", &RB::get_total_priority)
+    .def_property_readonly("max_priority", &RB::get_max_priority)
+    .def_property_readonly("nbytes", &RB::get_nbytes);
+
+  using Relabeler = fw_coll_env::StreamingRelabeler;
+  py::class_<Relabeler>(m, "StreamingRelabeler")
+    .def(py::init<const BFTurn&, size_t, size_t>(),
+         py::arg("barrier"), py::arg("num_threads") = 1,
+         py::arg("block_rows") = 1 << 20)
+    .def("__repr__", &Relabeler::to_string)
+    .def("run", &Relabeler::run,
+         py::arg("states_path"), py::arg("actions_path"), py::arg("h_path"),
+         py::arg("safe_path"), py::arg("override_path"))
+    .def_property_readonly("num_threads", &Relabeler::get_num_threads)
+    .def_property_readonly("block_rows", &Relabeler::get_block_rows);
+
+  using Recorder = fw_coll_env::TrajectoryRecorder;
+  py::class_<Recorder, std::shared_ptr<Recorder>>(m, "TrajectoryRecorder")
+    .def(py::init<const std::string&, size_t, int>(),
+         py::arg("path"), py::arg("chunk_rows") = 1 << 16,
+         py::arg("compression_level") = 0)
+    .def("__repr__", &Recorder::to_string)
+    .def("__enter__", [](std::shared_ptr<Recorder> r) {return r;})
+    .def("__exit__", [](Recorder &r, py::object, py::object, py::object) {r.close();})
+    .def("flush", &Recorder::flush)
+    .def("close", &Recorder::close)
+    .def_property_readonly("closed", &Recorder::is_closed)
+    .def_property_readonly("path", &Recorder::get_path)
+    .def_property_readonly("chunk_rows", &Recorder::get_chunk_rows)
+    .def_property_readonly("compression_level", &Recorder::get_compression_level)
+    .def_property_readonly("num_streams", &Recorder::get_num_streams)
+    .def_property_readonly("num_rows", &Recorder::get_num_rows)
+    .def_property_readonly("num_episodes", &Recorder::get_num_episodes)
+    .def_property_readonly("num_chunks", &Recorder::get_num_chunks)
+    .def_property_readonly("bytes_written", &Recorder::get_bytes_written);
+
+  using Reader = fw_coll_env::TrajectoryReader;
+  py::class_<Reader>(m, "TrajectoryReader")
+    .def(py::init<const std::string&>(), py::arg("path"))
+    .def("__repr__", &Reader::to_string)
+    .def("__len__", &Reader::get_num_episodes)
+    .def("episode", &Reader::episode, py::arg("i"))
+    .def("column", &Reader::column, py::arg("name"), py::arg("episode") = py::none())
+    .def_property_readonly("columns",
+        [](const Reader &r) {
+          std::vector<std::string> names;
+          for (const auto &c : r.get_columns()) {
+            names.push_back(c.name);
+          }
+          return names;
+        })
+    .def_property_readonly("num_episodes", &Reader::get_num_episodes)
+    .def_property_readonly("num_chunks", &Reader::get_num_chunks)
+    .def_property_readonly("num_rows", &Reader::get_num_rows)
+    .def_property_readonly("episode_lengths", &Reader::get_episode_lengths)
+    .def_property_readonly("episode_streams", &Reader::get_episode_streams)
+    .def_property_readonly("compressed", &Reader::get_compressed);
+
+  using Actors = fw_coll_env::ActorPool;
+  py::class_<Actors>(m, "ActorPool")
+    .def(py::init<const FwEnv&, const fw_coll_env::FwAvailActions&,
+                  const fw_coll_env::EncounterGenerator&, size_t, size_t, size_t,
+                  uint64_t>(),
+         py::arg("env"), py::arg("avail_actions"), py::arg("generator"),
+         py::arg("num_actors") = 1, py::arg("envs_per_actor") = 1,
+         py::arg("queue_capacity") = 1 << 16, py::arg("seed") = 0)
+    .def("__repr__", &Actors::to_string)
+    .def("start", &Actors::start)
+    .def("stop", &Actors::stop)
+    .def("drain", &Actors::drain, py::arg("max_items"))
+    .def("set_policy_random", &Actors::set_policy_random)
+    .def("set_policy_callback", &Actors::set_policy_callback,
+         py::arg("fn"), py::arg("user_data") = 0)
+    .def("set_policy_table", &Actors::set_policy_table,
+         py::arg("table"), py::arg("lims"))
+    .def("set_shield", &Actors::set_shield, py::arg("barrier"))
+    .def("clear_shield", &Actors::clear_shield)
+    .def_property_readonly("has_shield", &Actors::has_shield)
+    .def_property_readonly("running", &Actors::is_running)
+    .def_property_readonly("num_actors", &Actors::get_num_actors)
+    .def_property_readonly("envs_per_actor", &Actors::get_envs_per_actor)
+    .def_property_readonly("queue_capacity", &Actors::get_queue_capacity)
+    .def_property_readonly("queue_size", &Actors::get_queue_size)
+    .def_property_readonly("num_steps", &Actors::get_num_steps)
+    .def_property_readonly("num_episodes", &Actors::get_num_episodes)
+    .def_property_readonly("num_full_waits", &Actors::get_num_full_waits)
+    .def_property_readonly("table_version", &Actors::get_table_version);
+
+  using RtSnapshot = fw_coll_env::RealtimeSnapshot;
+  py::class_<RtSnapshot>(m, "RealtimeSnapshot")
+    .def_readonly("step", &RtSnapshot::step)
+    .def_readonly("t", &RtSnapshot::t)
+    .def_property_readonly("x",
+        [](const RtSnapshot &s) {return py::array_t<double>({8}, s.x);})
+    .def_property_readonly("action",
+        [](const RtSnapshot &s) {return py::array_t<double>({6}, s.action);})
+    .def_readonly("overridden", &RtSnapshot::overridden)
+    .def_readonly("done", &RtSnapshot::done)
+    .def_readonly("collided", &RtSnapshot::collided)
+    .def_readonly("dist_to_veh", &RtSnapshot::dist_to_veh)
+    .def_readonly("lateness", &RtSnapshot::lateness);
+
+  using RtStats = fw_coll_env::RealtimeStats;
+  py::class_<RtStats>(m, "RealtimeStats")
+    .def_readonly("num_steps", &RtStats::num_steps)
+    .def_readonly("num_overruns", &RtStats::num_overruns)
+    .def_readonly("num_skipped", &RtStats::num_skipped)
+    .def_readonly("num_stale", &RtStats::num_stale)
+    .def_readonly("mean_lateness", &RtStats::mean_lateness)
+    .def_readonly("rms_lateness", &RtStats::rms_lateness)
+    .def_readonly("max_lateness", &RtStats::max_lateness);
+
+  using RtSim = fw_coll_env::RealtimeSim;
+  py::class_<RtSim>(m, "RealtimeSim")
+    .def(py::init<const FwEnv&, const fw_coll_env::FwAvailActions&, double, size_t>(),
+         py::arg("env"), py::arg("avail_actions"), py::arg("time_warp") = 1.0,
+         py::arg("max_catch_up") = 0)
+    .def("__repr__", &RtSim::to_string)
+    .def("start", &RtSim::start)
+    .def("stop", &RtSim::stop)
+    .def("wait", &RtSim::wait, py::arg("timeout"))
+    .def("reset", &RtSim::reset, py::arg("x1"), py::arg("x2"), py::arg("t") = 0.0)
+    .def("post_action", &RtSim::post_action,
+         py::arg("a1_idx"), py::arg("a2_idx") = -1)
+    .def("snapshot", &RtSim::snapshot)
+    .def("stats", &RtSim::stats)
+    .def_property_readonly("env", &RtSim::get_env)
+    .def_property_readonly("running", &RtSim::is_running)
+    .def_property_readonly("time_warp", &RtSim::get_time_warp)
+    .def_property_readonly("max_catch_up", &RtSim::get_max_catch_up);
+
+  using MpcCfg = fw_coll_env::MpcConfig;
+  py::class_<MpcCfg>(m, "MpcConfig")
+    .def(py::init<>())
+    .def("__repr__", &MpcCfg::to_string)
+    .def_readwrite("method", &MpcCfg::method)
+    .def_readwrite("num_samples", &MpcCfg::num_samples)
+    .def_readwrite("horizon", &MpcCfg::horizon)
+    .def_readwrite("num_iters", &MpcCfg::num_iters)
+    .def_readwrite("continuous", &MpcCfg::continuous)
+    .def_readwrite("temperature", &MpcCfg::temperature)
+    .def_readwrite("elite_frac", &MpcCfg::elite_frac)
+    .def_readwrite("noise_frac", &MpcCfg::noise_frac)
+    .def_readwrite("smoothing", &MpcCfg::smoothing)
+    .def_readwrite("goal_weight", &MpcCfg::goal_weight)
+    .def_readwrite("collision_cost", &MpcCfg::collision_cost)
+    .def_readwrite("barrier_weight", &MpcCfg::barrier_weight);
+
+  using Mpc = fw_coll_env::MpcPlanner;
+  py::class_<Mpc>(m, "MpcPlanner")
+    .def(py::init<const FwEnv&, const fw_coll_env::FwAvailActions&, const MpcCfg&,
+                  size_t, uint64_t>(),
+         py::arg("env"), py::arg("avail_actions"), py::arg("config") = MpcCfg(),
+         py::arg("num_threads") = 1, py::arg("seed") = 0)
+    .def("__repr__", &Mpc::to_string)
+    .def("plan", &Mpc::plan, py::arg("x1"), py::arg("x2"))
+    .def("plan_idx", &Mpc::plan_idx, py::arg("x1"), py::arg("x2"))
+    .def("reset", &Mpc::reset)
+    .def("set_barrier", &Mpc::set_barrier, py::arg("barrier"))
+    .def("clear_barrier", &Mpc::clear_barrier)
+    .def_property_readonly("has_barrier", &Mpc::has_barrier)
+    .def_property_readonly("plan_actions", &Mpc::get_plan)
+    .def_property_readonly("probs", &Mpc::get_probs)
+    .def_property_readonly("costs", &Mpc::get_costs)
+    .def_property_readonly("config", &Mpc::get_config)
+    .def_property_readonly("num_threads", &Mpc::get_num_threads);
 
   py::class_<fw_coll_env::FwActionIndex>(m, "FwActionIndex")
     .def(py::init<fw_coll_env::FwAvailActions&>(), py::arg("avail_actions"))
     .def("idx_to_action", &fw_coll_env::FwActionIndex::idx_to_action)
     .def("action_to_idx", &fw_coll_env::FwActionIndex::action_to_idx);
 
+  namespace prof = fw_coll_env::profiler;
+  py::module_ profiler = m.def_submodule(
+      "profiler", "counters, latency histograms and Chrome traces of the hot paths");
+  profiler.def("set_enabled", &prof::set_enabled, py::arg("enabled"));
+  profiler.def("enabled", &prof::enabled);
+  profiler.def("set_tracing", &prof::set_tracing,
+               py::arg("tracing"), py::arg("max_events") = size_t(1) << 20);
+  profiler.def("tracing", &prof::tracing);
+  profiler.def("reset", &prof::reset);
+  profiler.def("write_trace", &prof::write_trace, py::arg("path"));
+  profiler.def("snapshot", []() {
+    const prof::Snapshot snap = prof::snapshot();
+    py::dict counters;
+    for (size_t c = 0; c < prof::num_counters; c++) {
+      counters[prof::counter_name(static_cast<prof::Counter>(c))] = snap.counters[c];
+    }
+    py::dict timers;
+    for (size_t t = 0; t < prof::num_timers; t++) {
+      const prof::TimerSnapshot &ts = snap.timers[t];
+      py::dict timer;
+      timer["count"] = ts.count;
+      timer["total_s"] = ts.total_ns * 1e-9;
+      timer["mean_s"] = ts.count ? ts.total_ns * 1e-9 / ts.count : 0.0;
+      timer["max_s"] = ts.max_ns * 1e-9;
+      timer["hist"] = py::array_t<uint64_t>({prof::num_buckets}, ts.buckets);
+      timers[prof::timer_name(static_cast<prof::Timer>(t))] = timer;
+    }
+    // hist[b] counts latencies in [edges[b], edges[b + 1])
+    py::array_t<double> edges {prof::num_buckets + 1};
+    auto _edges = edges.mutable_unchecked<1>();
+    _edges(0) = 0;
+    for (size_t b = 1; b <= prof::num_buckets; b++) {
+      _edges(b) = static_cast<double>(uint64_t(1) << (b - 1)) * 1e-9;
+    }
+
+    py::dict out;
+    out["counters"] = counters;
+    out["timers"] = timers;
+    out["hist_edges_s"] = edges;
+    out["trace_events"] = snap.trace_events;
+    out["trace_dropped"] = snap.trace_dropped;
+    return out;
+  });
+
 #ifdef VERSION_INFO
     m.attr("__version__") = MACRO_STRINGIFY(VERSION_INFO);
 #else
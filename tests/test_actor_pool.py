@@ -0,0 +1,102 @@
+import ctypes
+import time
+from typing import Any, Dict
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import ActorPool, BarrierGammaTurn, EncounterGenerator, \
+    FwActionIndex, FwAvailActions, FwCollisionEnv, FwSingleState, Point
+
+DT = 0.1
+GOAL1 = Point(3000, 0, 0)
+GOAL2 = Point(-3000, 0, 0)
+VEH1_LIMS = np.array([[-100, -100, -np.pi, 0], [100, 100, np.pi, 0]])
+VEH2_LIMS = np.array([[-500, -500, -np.pi, 0], [500, 500, np.pi, 0]])
+
+
+def make_env() -> FwCollisionEnv:
+    return FwCollisionEnv(
+        dt=DT, max_sim_time=20, done_dist=10, safety_dist=5,
+        goal1=GOAL1, goal2=GOAL2, time_warp=-1)
+
+
+def make_pool(avail: FwAvailActions, queue_capacity: int) -> ActorPool:
+    gen = EncounterGenerator(
+        VEH1_LIMS, VEH2_LIMS, v1=15, v2=15, horizon=20, max_miss=50)
+    return ActorPool(
+        make_env(), avail, gen, num_actors=2, envs_per_actor=4,
+        queue_capacity=queue_capacity, seed=1)
+
+
+def collect(pool: ActorPool) -> Dict[str, np.ndarray]:
+    pool.start()
+    time.sleep(0.1)
+    pool.stop()
+    return pool.drain(pool.queue_capacity)
+
+
+def test_actor_pool_transitions() -> None:
+    avail = FwAvailActions(v=[15], w=[-12, 0, 12], dz=[0])
+    bf = BarrierGammaTurn(
+        dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+        avail_actions=avail)
+    pool = make_pool(avail, 1024)
+    pool.set_shield(bf)
+    out = collect(pool)
+
+    # the ring fills up and the actors wait for the learner
+    num = len(out['action_idx'])
+    assert num == 1024
+    assert out['x'].shape == out['x_next'].shape == (num, 8)
+    assert pool.num_full_waits > 0
+    assert len(pool.drain(10)['x']) == 0
+
+    index = FwActionIndex(avail)
+    for i in range(0, num, 50):
+        env = make_env()
+        env.reset(FwSingleState.from_numpy(out['x'][i, :4]),
+                  FwSingleState.from_numpy(out['x'][i, 4:]),
+                  out['t'][i] - DT)
+        ac = index.idx_to_action(int(out['executed_idx'][i]))
+        env.step(ac.a1, ac.a2)
+        assert np.allclose(out['x_next'][i, :2],
+                           [env.x1.p.x, env.x1.p.y])
+        assert out['overridden'][i] == \
+            (out['executed_idx'][i] != out['action_idx'][i])
+
+
+def test_actor_pool_table_policy() -> None:
+    avail = FwAvailActions(v=[15], w=[-12, 0, 12], dz=[0])
+    pool = make_pool(avail, 4096)
+    lims = np.array([[-100, -100, -np.pi], [100, 100, np.pi]])
+    pool.set_policy_table(np.full((4, 4, 4), 2, dtype=np.int32), lims)
+    out = collect(pool)
+    num_actions = len(avail.get_all_actions())
+    assert np.all(out['action_idx'] // num_actions == 2)
+
+    with pytest.raises(RuntimeError):
+        pool.set_policy_table(np.full((2, 2, 2), 3, dtype=np.int32), lims)
+
+
+POLICY_FN = ctypes.CFUNCTYPE(
+    ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_void_p)
+
+
+def test_actor_pool_error() -> None:
+    avail = FwAvailActions(v=[15], w=[-12, 0, 12], dz=[0])
+    pool = make_pool(avail, 4096)
+
+    # every actor fails on its first step, drain stops the pool and
+    # rethrows the first error
+    def bad_policy(_x: Any, _user_data: Any) -> int:
+        return len(avail.get_all_actions())
+    policy = POLICY_FN(bad_policy)
+    pool.set_policy_callback(
+        ctypes.cast(policy, ctypes.c_void_p).value)
+    pool.start()
+    time.sleep(0.1)
+    with pytest.raises(RuntimeError):
+        pool.drain(10)
+    assert not pool.running
+    assert len(pool.drain(10)['x']) == 0
@@ -1,7 +1,8 @@
 import pickle
-from typing import Tuple
+from typing import Any, Tuple
 
 import numpy as np
+import pytest
 
 import fw_coll_env_c
 from fw_coll_env_c import FwAvailActions, BarrierGammaTurn, FwSingleState, \
@@ -160,3 +161,482 @@ def test_fw_action_index() -> None:
     for idx in range(len(actions)**2):
         ac = fw_action_idx.idx_to_action(idx)
         assert idx == fw_action_idx.action_to_idx(ac)
+
+
+def _full_rollout_h(bf: BarrierGammaTurn, x: FwState) -> float:
+    ac = FwSingleAction(V, np.deg2rad(W), 0)
+    x1 = FwSingleState(Point(x.x1.p.x, x.x1.p.y, x.x1.p.z), x.x1.th)
+    x2 = FwSingleState(Point(x.x2.p.x, x.x2.p.y, x.x2.p.z), x.x2.th)
+    closest = x1.p.dist(x2.p)
+    for _ in range(int(round(360 / W / DT))):
+        fw_coll_env_c.fw_dynamics(DT, ac, x1)
+        fw_coll_env_c.fw_dynamics(DT, ac, x2)
+        closest = min(closest, x1.p.dist(x2.p))
+    return min(MAX_VAL, closest - SAFETY_DIST)  # type: ignore
+
+
+def test_rollout_pruning() -> None:
+    bf = make_barrier_func()[1]
+    assert bf.skipped_steps == 0
+
+    x = FwState(FwSingleState(Point(5000, 0, 0), 0),
+                FwSingleState(Point(-5000, 0, 0), 0))
+    assert bf.calc_h(x) == MAX_VAL
+    assert bf.skipped_steps == int(round(360 / W / DT))
+
+    np.random.seed(0)
+    for _ in range(20):
+        x = FwState(_new_state(), _new_state())
+        assert bf.calc_h(x) == _full_rollout_h(bf, x)
+
+    bf.reset_skipped_counts()
+    assert bf.skipped_steps == 0
+    assert bf.skipped_candidates == 0
+
+
+def test_choose_u_hetero() -> None:
+    avail, bf = make_barrier_func()
+    bf_other = BarrierGammaTurn(
+        dt=DT, max_val=100, v=20, w_deg_per_sec=W, safety_dist=8,
+        avail_actions=avail)
+    num_actions = len(avail.get_all_actions())**2
+
+    np.random.seed(1)
+    num_rows = 50
+    x = np.array([np.asarray(FwState(_new_state(), _new_state()))
+                  for _ in range(num_rows)]) / 5
+    uhat_idx = np.random.randint(num_actions, size=num_rows)
+
+    other = np.arange(num_rows) % 2 == 1
+    safety_dist = np.where(other, 8.0, SAFETY_DIST)
+    max_val = np.where(other, 100.0, MAX_VAL)
+    v = np.where(other, 20.0, V)
+    w = np.full(num_rows, float(W))
+    lmbda = np.full(num_rows, bf.lmbda)
+
+    out = bf.choose_u_hetero(
+        x, uhat_idx, safety_dist, max_val, v, w, lmbda)
+
+    expected = np.where(
+        other, bf_other.choose_u(x, uhat_idx), bf.choose_u(x, uhat_idx))
+    assert np.array_equal(out, expected)
+
+    # the barrier's own parameters are left untouched
+    assert bf.v == V
+    assert bf.safety_dist == SAFETY_DIST
+
+    # every row can carry its own continuous parameters
+    lmbda_before = bf.lmbda
+    safety_dist = np.random.uniform(2, 10, size=num_rows)
+    lmbda = np.random.uniform(0.5, 1, size=num_rows)
+    out = bf.choose_u_hetero(
+        x, uhat_idx, safety_dist, max_val, v, w, lmbda)
+    for i in range(num_rows):
+        row = slice(i, i + 1)
+        assert out[i] == bf.choose_u_hetero(
+            x[row], uhat_idx[row], safety_dist[row], max_val[row],
+            v[row], w[row], lmbda[row])[0]
+
+    # a row whose evasive action is not avail throws without side effects
+    v[-1] = 17
+    with pytest.raises(RuntimeError):
+        bf.choose_u_hetero(x, uhat_idx, safety_dist, max_val, v, w, lmbda)
+    assert bf.v == V
+    assert bf.lmbda == lmbda_before
+
+
+def test_choose_u_continuous() -> None:
+    avail, bf = make_barrier_func()
+
+    far = np.asarray(FwState(FwSingleState(Point(5000, 0, 0), 0),
+                             FwSingleState(Point(-5000, 0, 0), 0)))
+    close = np.asarray(FwState(FwSingleState(Point(16, -1, 0), np.pi),
+                               FwSingleState(Point(-16, 1, 0), 0)))
+    x = np.vstack((far, close))
+    uhat = np.array([[17.5, 0.1, 0, 22.5, -0.1, 0],
+                     [17.5, 0.0, 0, 17.5, 0.0, 0]])
+
+    out, verified = bf.choose_u_continuous(x, uhat, grid_fallback=True)
+    assert verified.all()
+    assert np.array_equal(out[0], uhat[0])
+
+    # a safe uhat outside the avail action bounds is not clamped
+    fast = np.array([[40, 0.5, 2, 10, -0.5, -2]])
+    out_fast, verified_fast = bf.choose_u_continuous(far[None], fast)
+    assert verified_fast.all()
+    assert np.array_equal(out_fast, fast)
+
+    w_max = np.deg2rad(W)
+    low = np.array([15, -w_max, 0] * 2)
+    high = np.array([25, w_max, 0] * 2)
+    assert np.all(out >= low - 1e-12) and np.all(out <= high + 1e-12)
+
+    state = FwState.from_numpy(close)
+    safe_ac = FwAction(FwSingleAction(*out[1, :3]),
+                       FwSingleAction(*out[1, 3:]))
+    unsafe_ac = FwAction(FwSingleAction(*uhat[1, :3]),
+                         FwSingleAction(*uhat[1, 3:]))
+    h = bf.calc_h(state)
+    assert calc_bf_constraint(bf.calc_dh(state, unsafe_ac), h) < 0
+    assert calc_bf_constraint(bf.calc_dh(state, safe_ac), h) >= 0
+
+
+def test_barrier_filter() -> None:
+    avail, bf = make_barrier_func()
+    action_index = fw_coll_env_c.FwActionIndex(avail)
+    filt = fw_coll_env_c.BarrierFilter(bf, num_envs=2)
+    assert len(filt) == 2
+
+    evasive = FwSingleAction(V, np.deg2rad(W), 0)
+    evasive_idx = action_index.action_to_idx(FwAction(evasive, evasive))
+
+    x1 = FwSingleState(Point(40, 3, 0), np.pi)
+    x2 = FwSingleState(Point(0, 0, 0), 0)
+    for _ in range(50):
+        state = FwState(x1, x2)
+        assert filt.calc_h(0, state) == bf.calc_h(state)
+        fw_coll_env_c.fw_dynamics(dt=DT, ac=evasive, x=x1)
+        fw_coll_env_c.fw_dynamics(dt=DT, ac=evasive, x=x2)
+    assert filt.cache_misses == 1
+    assert filt.cache_hits == 49
+
+    rng = np.random.default_rng(0)
+    x = np.zeros((2, 8))
+    x[:, [0, 1, 4, 5]] = rng.uniform(-30, 30, size=(2, 4))
+    x[:, [2, 6]] = rng.uniform(-np.pi, np.pi, size=(2, 2))
+    filt.reset_all()
+    for _ in range(20):
+        uhat_idx = np.array([evasive_idx, evasive_idx])
+        out = filt.choose_u(x, uhat_idx)
+        assert np.array_equal(out, bf.choose_u(x, uhat_idx))
+        for i in range(2):
+            ac = action_index.idx_to_action(int(out[i]))
+            state = FwState.from_numpy(x[i])
+            fw_coll_env_c.fw_dynamics(dt=DT, ac=ac.a1, x=state.x1)
+            fw_coll_env_c.fw_dynamics(dt=DT, ac=ac.a2, x=state.x2)
+            x[i] = np.asarray(state)
+
+
+def test_multi_barrier_filter() -> None:
+    avail, bf = make_barrier_func()
+    filt = fw_coll_env_c.MultiBarrierFilter(bf, max_sweeps=10)
+    num_actions = len(avail.get_all_actions())
+
+    # for two aircraft it is the joint choose_u
+    rng = np.random.default_rng(1)
+    num = 100
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = rng.uniform(-60, 60, size=(num, 4))
+    x[:, [2, 6]] = rng.uniform(-np.pi, np.pi, size=(num, 2))
+    uhat = rng.integers(num_actions, size=(num, 2))
+    joint_idx = (uhat[:, 0] * num_actions + uhat[:, 1]).astype(np.int32)
+    out = bf.choose_u(x, joint_idx)
+    for i in range(num):
+        safe = filt.choose_u(x[i].reshape(2, 4), uhat[i].astype(np.int32))
+        assert safe[0] * num_actions + safe[1] == out[i]
+
+    # far apart pairs are culled
+    num = 200
+    side = 150 * np.sqrt(num)
+    x = np.zeros((num, 4))
+    x[:, :2] = rng.uniform(-side, side, size=(num, 2))
+    x[:, 2] = rng.uniform(-np.pi, np.pi, size=num)
+    uhat_idx = rng.integers(num_actions, size=num).astype(np.int32)
+    safe = filt.choose_u(x, uhat_idx)
+    assert safe.shape == (num,)
+    assert filt.num_pairs < num * (num - 1) // 2
+    assert filt.num_unresolved <= filt.num_violated
+
+    # against the pairwise filter on every pair, culled or not
+    i, j = np.triu_indices(num, 1)
+    pair_x = np.hstack([x[i], x[j]])
+    pair_uhat = (uhat_idx[i] * num_actions + uhat_idx[j]).astype(np.int32)
+    pair_out, _, uhat_bf, _, _, _ = \
+        bf.choose_u(pair_x, pair_uhat, diagnostics=True)
+    pair_safe = (safe[i] * num_actions + safe[j]).astype(np.int32)
+    _, _, safe_bf, _, _, _ = \
+        bf.choose_u(pair_x, pair_safe, diagnostics=True)
+    violated = uhat_bf < 0
+    assert np.count_nonzero(violated) == filt.num_violated
+    assert np.count_nonzero(safe_bf < 0) == filt.num_unresolved
+
+    if filt.num_sweeps == 0:
+        # without descent, aircraft in one violated pair get the pairwise
+        # choice and the others keep uhat
+        num_violated_of = np.bincount(
+            np.concatenate([i[violated], j[violated]]), minlength=num)
+        for k in np.flatnonzero(violated):
+            if num_violated_of[i[k]] == num_violated_of[j[k]] == 1:
+                assert pair_safe[k] == pair_out[k]
+        untouched = num_violated_of == 0
+        assert np.array_equal(safe[untouched], uhat_idx[untouched])
+
+
+def test_choose_u_diagnostics() -> None:
+    avail, bf = make_barrier_func()
+    action_index = fw_coll_env_c.FwActionIndex(avail)
+
+    np.random.seed(4)
+    num = 200
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-30, 30, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    uhat_idx = np.random.randint(81, size=num).astype(np.int32)
+
+    out, h, uhat_bf, chosen_bf, overridden, num_candidates = \
+        bf.choose_u(x, uhat_idx, diagnostics=True)
+    assert np.array_equal(out, bf.choose_u(x, uhat_idx))
+    assert np.array_equal(overridden, out != uhat_idx)
+    assert overridden.any()
+    assert np.all(num_candidates[uhat_bf >= 0] == 1)
+    assert np.all(num_candidates[overridden] > 1)
+
+    for i in range(num):
+        state = FwState.from_numpy(x[i])
+        assert h[i] == bf.calc_h(state)
+        uhat_ac = action_index.idx_to_action(int(uhat_idx[i]))
+        chosen_ac = action_index.idx_to_action(int(out[i]))
+        assert uhat_bf[i] == pytest.approx(
+            calc_bf_constraint(bf.calc_dh(state, uhat_ac), h[i]))
+        assert chosen_bf[i] == pytest.approx(
+            calc_bf_constraint(bf.calc_dh(state, chosen_ac), h[i]))
+
+    with pytest.raises(RuntimeError, match="choose_u_diagnostics"):
+        bf.choose_u(x, uhat_idx[:-1], diagnostics=True)
+
+
+def test_barrier_composite() -> None:
+    avail = FwAvailActions(v=[15, 20, 25], w=[-W, -6, 0, 6, W], dz=[0])
+    turn = BarrierGammaTurn(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=W, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+    turn_slow = BarrierGammaTurn(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=6,
+        safety_dist=SAFETY_DIST, avail_actions=avail)
+    straight = fw_coll_env_c.BarrierGammaStraight(
+        dt=DT, max_val=MAX_VAL, v=V, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+    comp = fw_coll_env_c.BarrierComposite(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=[W, 6], straight=True,
+        safety_dist=SAFETY_DIST, avail_actions=avail)
+    assert comp.num_maneuvers == 3
+
+    np.random.seed(5)
+    num = 100
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-100, 100, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+
+    h_maneuvers, h = comp.calc_h_batch(x)
+    assert h_maneuvers.shape == (num, 3)
+    assert np.array_equal(h, h_maneuvers.max(axis=1))
+    for i in range(num):
+        state = FwState.from_numpy(x[i])
+        expected = [turn.calc_h(state), turn_slow.calc_h(state),
+                    straight.calc_h(state)]
+        assert np.allclose(h_maneuvers[i], expected, atol=1e-8)
+        assert np.allclose(comp.calc_h_maneuvers(state), h_maneuvers[i])
+        assert comp.calc_h(state) == h[i]
+
+    uhat_idx = np.random.randint(
+        len(avail.get_all_actions()) ** 2, size=num).astype(np.int32)
+    out = comp.choose_u(x, uhat_idx)
+    assert out.shape == (num,)
+
+    comp2 = pickle.loads(pickle.dumps(comp))
+    assert np.array_equal(comp2.calc_h_batch(x)[1], h)
+
+
+def test_calc_h_grad() -> None:
+    avail, turn = make_barrier_func()
+    straight = fw_coll_env_c.BarrierGammaStraight(
+        dt=DT, max_val=MAX_VAL, v=V, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+
+    np.random.seed(6)
+    num = 200
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-100, 100, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    x[:, [3, 7]] = np.random.uniform(-10, 10, size=(num, 2))
+
+    for barrier in [turn, straight]:
+        h, grad = barrier.calc_h_grad(x)
+        assert grad.shape == (num, 8)
+        for i in range(num):
+            assert h[i] == barrier.calc_h(FwState.from_numpy(x[i]))
+
+        # h is only piecewise smooth (the closest step can switch) so
+        # allow a few rows to disagree with finite differences
+        fd = barrier.calc_h_grad_fd(x)
+        close = np.all(np.abs(grad - fd) < 1e-4, axis=1)
+        assert close.mean() > 0.95
+        assert np.all(grad[h >= MAX_VAL] == 0)
+
+    # a clockwise evasive turn is the mirror image of the counterclockwise
+    # one, with y and the headings negated
+    clockwise = BarrierGammaTurn(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=-W,
+        safety_dist=SAFETY_DIST, avail_actions=avail)
+    sign = np.array([1, -1, -1, 1] * 2)
+    h, grad = clockwise.calc_h_grad(x)
+    h_mirror, grad_mirror = turn.calc_h_grad(x * sign)
+    assert np.allclose(h, h_mirror)
+    assert np.allclose(grad, grad_mirror * sign)
+    fd = clockwise.calc_h_grad_fd(x)
+    assert np.all(np.abs(grad - fd) < 1e-4, axis=1).mean() > 0.95
+
+
+def test_streaming_relabeler(tmp_path: Any) -> None:
+    _, bf = make_barrier_func()
+
+    np.random.seed(6)
+    num = 1001
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-30, 30, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    uhat_idx = np.random.randint(81, size=num).astype(np.int32)
+
+    paths = [str(tmp_path / name) for name in
+             ['x.bin', 'uhat.bin', 'h.bin', 'safe.bin', 'override.bin']]
+    x.tofile(paths[0])
+    uhat_idx.tofile(paths[1])
+
+    relabeler = fw_coll_env_c.StreamingRelabeler(
+        bf, num_threads=3, block_rows=128)
+    num_rows, num_overridden = relabeler.run(*paths)
+
+    h = np.fromfile(paths[2], dtype=np.float64)
+    safe = np.fromfile(paths[3], dtype=np.int32)
+    overridden = np.fromfile(paths[4], dtype=np.uint8).astype(bool)
+
+    _, h_ref, _, _, overridden_ref, _ = \
+        bf.choose_u(x, uhat_idx, diagnostics=True)
+    assert num_rows == num
+    assert num_overridden == overridden_ref.sum() > 0
+    assert np.array_equal(safe, bf.choose_u(x, uhat_idx))
+    assert np.array_equal(h, h_ref)
+    assert np.array_equal(overridden, overridden_ref)
+
+
+def test_single_precision() -> None:
+    avail = FwAvailActions(v=[15, 20, 25], w=[-W, 0, W], dz=[0])
+    turn = BarrierGammaTurn(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=W, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+    straight = fw_coll_env_c.BarrierGammaStraight(
+        dt=DT, max_val=MAX_VAL, v=V, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+    comp = fw_coll_env_c.BarrierComposite(
+        dt=DT, max_val=MAX_VAL, v=V, w_deg_per_sec=[-W, W], straight=True,
+        safety_dist=SAFETY_DIST, avail_actions=avail)
+
+    np.random.seed(7)
+    num = 300
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-100, 100, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    uhat_idx = np.random.randint(
+        len(avail.get_all_actions()) ** 2, size=num).astype(np.int32)
+
+    num_overrides = 0
+    for barrier in [turn, straight, comp]:
+        h, _ = barrier.calc_h_grad(x)
+        h32 = barrier.calc_h_f32(x.astype(np.float32))
+        assert h32.dtype == np.float32
+        assert np.allclose(h32, h, atol=0.05)
+
+        # float32 rounding may only flip choices right at the boundary
+        out = barrier.choose_u(x, uhat_idx)
+        out32 = barrier.choose_u_f32(x.astype(np.float32), uhat_idx)
+        num_overrides += np.sum(out != uhat_idx)
+        assert np.mean(out32 == out) > 0.98
+    assert num_overrides > 0
+
+    with pytest.raises(RuntimeError):
+        turn.choose_u_f32(np.zeros((2, 8), dtype=np.float32), uhat_idx)
+    with pytest.raises(RuntimeError):
+        turn.choose_u_f32(np.zeros(8, dtype=np.float32), uhat_idx[:1])
+    with pytest.raises(RuntimeError):
+        turn.choose_u_f32(
+            np.zeros((2, 8), dtype=np.float32), uhat_idx[:4].reshape(2, 2))
+
+
+def test_choose_u_anytime() -> None:
+    avail, bf = make_barrier_func()
+    np.random.seed(8)
+    num = 200
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-60, 60, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    uhat_idx = np.random.randint(
+        len(avail.get_all_actions()) ** 2, size=num).astype(np.int32)
+    expected, _, uhat_bf_val, _, _, _ = bf.choose_u(
+        x, uhat_idx, diagnostics=True)
+    searched = uhat_bf_val < 0
+    assert np.any(searched)
+
+    # with enough time the search always finishes with the choose_u action
+    for per_row in [False, True]:
+        out, complete = bf.choose_u_anytime(
+            x, uhat_idx, budget_s=60, per_row=per_row)
+        assert np.all(complete)
+        assert np.array_equal(out, expected)
+
+    # without time only a safe uhat is a complete answer
+    out, complete = bf.choose_u_anytime(x, uhat_idx, budget_s=0, per_row=True)
+    assert np.array_equal(complete, ~searched)
+    assert np.array_equal(out, uhat_idx)
+
+    # rows after the budget of the call ran out are not evaluated
+    out, complete = bf.choose_u_anytime(x, uhat_idx, budget_s=0)
+    assert not np.any(complete)
+    assert np.array_equal(out, uhat_idx)
+
+    with pytest.raises(RuntimeError):
+        bf.choose_u_anytime(x, uhat_idx, budget_s=-1)
+
+
+def test_safe_action_mask() -> None:
+    avail, turn = make_barrier_func()
+    straight = fw_coll_env_c.BarrierGammaStraight(
+        dt=DT, max_val=MAX_VAL, v=V, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+    all_actions = avail.get_all_actions()
+    np.random.seed(9)
+    num = 100
+    x = np.zeros((num, 8))
+    x[:, [0, 1, 4, 5]] = np.random.uniform(-60, 60, size=(num, 4))
+    x[:, [2, 6]] = np.random.uniform(-np.pi, np.pi, size=(num, 2))
+    a2_idx = np.random.randint(len(all_actions), size=num).astype(np.int32)
+
+    for bf in [turn, straight]:
+        mask = bf.safe_action_mask(x, a2_idx)
+        assert mask.dtype == bool
+        assert mask.shape == (num, len(all_actions))
+        assert np.any(mask) and not np.all(mask)
+
+        # the same sign as bf_constraint of every action
+        for i in range(num):
+            state = FwState.from_numpy(x[i])
+            h = bf.calc_h(state)
+            for a1, ac in enumerate(all_actions):
+                dh = bf.calc_dh(state, FwAction(ac, all_actions[a2_idx[i]]))
+                assert mask[i, a1] == (calc_bf_constraint(dh, h) >= 0)
+
+        packed = bf.safe_action_mask(x, a2_idx, packed=True)
+        assert packed.dtype == np.uint8
+        assert np.array_equal(packed, np.packbits(mask, axis=1))
+
+    # the intruder action given by its Uhat
+    uhat2 = fw_coll_env_c.Uhat(goal=GOAL2, dt=DT, avail_actions=avail)
+    uhat2_idx = np.zeros(num, dtype=np.int32)
+    for i in range(num):
+        u = uhat2.calc(FwState.from_numpy(x[i]).x2)
+        uhat2_idx[i] = [(ac.v, ac.w, ac.dz) for ac in all_actions].index(
+            (u.v, u.w, u.dz))
+    assert np.array_equal(turn.safe_action_mask(x, uhat2),
+                          turn.safe_action_mask(x, uhat2_idx))
+
+    with pytest.raises(RuntimeError):
+        turn.safe_action_mask(x, a2_idx + len(all_actions))
@@ -0,0 +1,71 @@
+import numpy as np
+import pytest
+
+from fw_coll_env_c import EncounterGenerator
+
+V = 15
+HORIZON = 60
+VEH1_LIMS = np.array([[-500, -500, -np.pi, 0], [500, 500, np.pi, 0]])
+VEH2_LIMS = np.array([[-1500, -1500, -np.pi, 0], [1500, 1500, np.pi, 0]])
+
+
+def make_generator(conflict_frac: float, seed: int) -> EncounterGenerator:
+    return EncounterGenerator(
+        VEH1_LIMS, VEH2_LIMS, v1=V, v2=V, horizon=HORIZON, max_miss=50,
+        conflict_frac=conflict_frac, seed=seed)
+
+
+def closest_approach(x: np.ndarray) -> np.ndarray:
+    rel_p = x[:, 4:6] - x[:, 0:2]
+    rel_v = V * np.stack(
+        (np.cos(x[:, 6]) - np.cos(x[:, 2]),
+         np.sin(x[:, 6]) - np.sin(x[:, 2])), axis=1)
+    tau = -np.sum(rel_p * rel_v, axis=1) / \
+        np.maximum(np.sum(rel_v ** 2, axis=1), 1e-12)
+    tau = np.clip(tau, 0, HORIZON)
+    return np.linalg.norm(rel_p + rel_v * tau[:, np.newaxis], axis=1)
+
+
+def test_nominal_weights() -> None:
+    x, w = make_generator(0, 0).sample(1000)
+    assert x.shape == (1000, 8)
+    assert np.all(w == 1)
+    lims = np.hstack((VEH1_LIMS, VEH2_LIMS))
+    assert np.all(x >= lims[0]) and np.all(x <= lims[1])
+
+
+def test_importance_weights() -> None:
+    num = 200000
+    x_nom, _ = make_generator(0, 1).sample(num)
+    x, w = make_generator(0.8, 2).sample(num)
+
+    # the weights integrate the nominal density
+    assert abs(w.mean() - 1) < 0.02
+    assert np.array_equal(make_generator(0.8, 3).weights(x), w)
+    assert np.all(w <= 1 / 0.2 + 1e-9)
+
+    near_nom = closest_approach(x_nom) < 20
+    near = closest_approach(x) < 20
+    assert near.mean() > 20 * near_nom.mean()
+
+    est = np.mean(w * near)
+    est_nom = near_nom.mean()
+    std_nom = np.sqrt(est_nom * (1 - est_nom) / num)
+    assert abs(est - est_nom) < 5 * std_nom
+    assert np.std(w * near) < np.std(near_nom)
+
+
+def test_seed() -> None:
+    gen = make_generator(0.5, 4)
+    x1, w1 = gen.sample(10)
+    gen.seed(4)
+    x2, w2 = gen.sample(10)
+    assert np.array_equal(x1, x2) and np.array_equal(w1, w2)
+
+
+def test_invalid_args() -> None:
+    with pytest.raises(RuntimeError):
+        make_generator(1, 0)
+    with pytest.raises(RuntimeError):
+        EncounterGenerator(VEH1_LIMS, VEH2_LIMS[:, :3], v1=V, v2=V,
+                           horizon=HORIZON, max_miss=50)
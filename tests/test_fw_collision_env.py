@@ -1,10 +1,14 @@
+import copy
 import pickle
+import time
 from typing import Tuple
 
 import numpy as np
+import pytest
 
 from fw_coll_env_c import FwCollisionEnv, Point, FwSingleState, \
-    FwAvailActions, Uhat
+    FwAvailActions, Uhat, FwSingleAction, FwAction, FwActionIndex, \
+    BarrierGammaTurn
 
 DT = 0.1
 DONE_DIST = 75
@@ -107,3 +111,172 @@ def test_collision() -> None:
     env.step(a1, a2)
     assert env.stats.done_collision
     assert env.stats.dist_to_veh == 2
+
+
+def test_continuous_collision() -> None:
+    # head on at 200 m/s closing speed with dt=0.1: the vehicles jump from
+    # 10 m apart to 10 m apart on the other side within one step
+    for continuous in [False, True]:
+        env = make_base_env(safety_dist=5)
+        env.continuous_collision = continuous
+        x1 = FwSingleState(Point(-5, 0, 0), 0)
+        x2 = FwSingleState(Point(5, 0, 0), np.pi)
+        env.reset(x1, x2, 0.0)
+
+        ac = FwSingleAction(100, 0, 0)
+        env.step(ac, ac)
+        assert np.isclose(env.stats.dist_to_veh, 10, atol=1e-9)
+        assert np.isclose(env.stats.dist_closest_approach, 0, atol=1e-9)
+        assert np.isclose(env.stats.t_closest_approach, DT / 2, atol=1e-9)
+        assert env.stats.done_collision == continuous
+
+    env2 = pickle.loads(pickle.dumps(env))
+    assert env2.continuous_collision
+
+
+def test_time_warp() -> None:
+    # steps after the first are paced at dt / time_warp
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=MAX_SIM_TIME, done_dist=DONE_DIST,
+        safety_dist=0, goal1=GOAL1, goal2=GOAL2, time_warp=5)
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(0, 100, 0), 0), 0.0)
+    ac = FwSingleAction(15, 0, 0)
+    start = time.perf_counter()
+    for _ in range(11):
+        env.step(ac, ac)
+    elapsed = time.perf_counter() - start
+    assert 0.19 < elapsed < 0.5
+
+    # nor is the first step after a reset to a later time
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=MAX_SIM_TIME, done_dist=DONE_DIST,
+        safety_dist=0, goal1=GOAL1, goal2=GOAL2, time_warp=1)
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(0, 100, 0), 0), 5.0)
+    start = time.perf_counter()
+    env.step(ac, ac)
+    assert time.perf_counter() - start < 0.05
+
+
+def check_step_n(env: FwCollisionEnv, a1: FwSingleAction,
+                 a2: FwSingleAction, k: int) -> int:
+    env_loop = pickle.loads(pickle.dumps(env))
+    done, steps, min_dist = env.step_n(a1, a2, k)
+
+    loop_done = False
+    loop_steps = 0
+    loop_min_dist = np.inf
+    while not loop_done and loop_steps < k:
+        env_loop.step(a1, a2)
+        loop_steps += 1
+        stats = env_loop.stats
+        loop_min_dist = min(
+            loop_min_dist, stats.dist_closest_approach
+            if env.continuous_collision else stats.dist_to_veh)
+        loop_done = env_loop.done or env_loop.collided
+
+    # the straight closed form matches the loop exactly
+    assert done == loop_done
+    assert steps == loop_steps
+    assert env.t == env_loop.t
+    assert min_dist == loop_min_dist
+    assert np.array_equal(np.asarray(env.x1), np.asarray(env_loop.x1))
+    assert np.array_equal(np.asarray(env.x2), np.asarray(env_loop.x2))
+    assert env.stats.dist_closest_approach == stats.dist_closest_approach
+    return steps
+
+
+@pytest.mark.parametrize("continuous_collision", [False, True])
+def test_step_n(continuous_collision: bool) -> None:
+    np.random.seed(0)
+    turn = FwSingleAction(20, np.deg2rad(13), 0)
+    straight1 = FwSingleAction(20, 0, 0)
+    straight2 = FwSingleAction(15, 0, 0)
+
+    for a1, a2 in [(straight1, straight2), (turn, straight1)]:
+        for _ in range(20):
+            env = FwCollisionEnv(
+                dt=DT, max_sim_time=MAX_SIM_TIME, done_dist=DONE_DIST,
+                safety_dist=20, goal1=GOAL1, goal2=GOAL2, time_warp=-1,
+                continuous_collision=continuous_collision)
+            low = (-200, -200, -np.pi)
+            high = (200, 200, np.pi)
+            x1 = np.random.uniform(low, high)
+            x2 = np.random.uniform(low, high)
+            env.reset(FwSingleState(Point(x1[0], x1[1], 0), x1[2]),
+                      FwSingleState(Point(x2[0], x2[1], 0), x2[2]), 0.0)
+            check_step_n(env, a1, a2, 120)
+
+
+@pytest.mark.parametrize("continuous_collision", [False, True])
+def test_step_n_no_relative_motion(continuous_collision: bool) -> None:
+    straight = FwSingleAction(20, 0, 0)
+    still = FwSingleAction(0, 0, 0)
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=MAX_SIM_TIME, done_dist=DONE_DIST,
+        safety_dist=20, goal1=GOAL1, goal2=GOAL2, time_warp=-1,
+        continuous_collision=continuous_collision)
+
+    # equal velocities inside safety_dist
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(0, 10, 0), 0), 0.0)
+    assert check_step_n(env, straight, straight, 50) == 1
+    assert env.collided
+
+    # vehicle 1 standing at its goal
+    env.reset(FwSingleState(GOAL1, 0),
+              FwSingleState(Point(0, 150, 0), 0), 0.0)
+    assert check_step_n(env, still, straight, 50) == 1
+    assert env.done
+
+
+def test_step_shielded() -> None:
+    env = make_base_env(safety_dist=5)
+    x1 = FwSingleState(Point(16, -1, 0), np.pi)
+    x2 = FwSingleState(Point(-16, 1, 0), 0)
+    env.reset(x1, x2, 0.0)
+
+    # the barrier needs a whole number of steps per evasive revolution
+    avail = FwAvailActions(v=[15, 20], w=[-12, 0, 12], dz=[0])
+    uhat1 = Uhat(goal=GOAL1, dt=DT, avail_actions=avail)
+    uhat2 = Uhat(goal=GOAL2, dt=DT, avail_actions=avail)
+    action_index = FwActionIndex(avail)
+    bf = BarrierGammaTurn(
+        dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+        avail_actions=avail)
+    env.set_shield(bf)
+    assert env.has_shield
+
+    # copies and pickles carry their own shield
+    idx = action_index.action_to_idx(
+        FwAction(uhat1.calc(env.x1), uhat2.calc(env.x2)))
+    expected_step = copy.copy(env).step(idx)
+    for env_copy in [copy.deepcopy(env), pickle.loads(pickle.dumps(env))]:
+        assert env_copy.has_shield
+        assert env_copy.step(idx) == expected_step
+
+    with pytest.raises(RuntimeError, match="dt"):
+        env.set_shield(BarrierGammaTurn(
+            dt=2 * DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+            avail_actions=avail))
+
+    overridden_any = False
+    for _ in range(100):
+        ac = FwAction(uhat1.calc(env.x1), uhat2.calc(env.x2))
+        idx = action_index.action_to_idx(ac)
+        x = np.hstack((np.asarray(env.x1), np.asarray(env.x2)))
+        expected = bf.choose_u(x[np.newaxis, :], np.array([idx]))[0]
+
+        done, requested, executed, overridden = env.step(idx)
+        assert requested == idx
+        assert executed == expected
+        assert overridden == (executed != idx)
+        overridden_any |= overridden
+        assert not env.collided
+        if done:
+            break
+    assert overridden_any
+
+    env.clear_shield()
+    assert not env.has_shield
@@ -0,0 +1,220 @@
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwCollisionEnv, FwCollisionEnvBatch, Point, \
+    FwSingleState, FwAvailActions, Uhat, BarrierGammaTurn
+
+DT = 0.1
+GOAL1 = Point(200, 0, 0)
+GOAL2 = Point(-200, 0, 0)
+
+
+def make_env() -> FwCollisionEnv:
+    return FwCollisionEnv(
+        dt=DT, max_sim_time=10, done_dist=10, safety_dist=5,
+        goal1=GOAL1, goal2=GOAL2, time_warp=-1)
+
+
+def make_avail() -> FwAvailActions:
+    return FwAvailActions(v=[15, 20, 25], w=[-12, 0, 12], dz=[0])
+
+
+def random_states(num: int) -> np.ndarray:
+    low = np.array([-200, -200, -np.pi, 0] * 2)
+    high = np.array([200, 200, np.pi, 0] * 2)
+    return np.random.uniform(low, high, size=(num, 8))
+
+
+def test_batch_matches_single_env() -> None:
+    np.random.seed(0)
+    num_envs = 20
+    avail = make_avail()
+    x = random_states(num_envs)
+
+    batch = FwCollisionEnvBatch(
+        make_env(), num_envs, avail, num_threads=2, shard_size=3)
+    batch.reset(x)
+
+    uhat2 = Uhat(goal=GOAL2, dt=DT, avail_actions=avail)
+    envs = []
+    for row in x:
+        env = make_env()
+        env.reset(FwSingleState.from_numpy(row[:4]),
+                  FwSingleState.from_numpy(row[4:]), 0.0)
+        envs.append(env)
+
+    num_actions = len(avail.get_all_actions())
+    for _ in range(50):
+        a1_idx = np.random.randint(num_actions, size=num_envs)
+        done = batch.step(a1_idx)
+        for i, env in enumerate(envs):
+            a1 = avail.idx_to_action(int(a1_idx[i]))
+            env.step(a1, uhat2.calc(env.x2))
+            assert (env.done or env.collided) == done[i]
+
+    states = batch.states
+    for i, env in enumerate(envs):
+        assert np.array_equal(
+            states[i], np.hstack((np.asarray(env.x1), np.asarray(env.x2))))
+        assert batch.dist_to_veh[i] == env.stats.dist_to_veh
+
+
+def test_batch_thread_count_independent() -> None:
+    np.random.seed(1)
+    num_envs = 500
+    avail = make_avail()
+    x = random_states(num_envs)
+    reset_x = random_states(num_envs)
+    actions = np.random.randint(
+        len(avail.get_all_actions()), size=(150, num_envs))
+
+    results = []
+    for num_threads in [0, 1, 3]:
+        batch = FwCollisionEnvBatch(
+            make_env(), num_envs, avail, num_threads=num_threads,
+            shard_size=17)
+        batch.reset(x)
+        dones = [batch.step(a1_idx, reset_x) for a1_idx in actions]
+        results.append((batch.states, np.array(dones)))
+
+    # with max_sim_time=10 every env reaches done at least once
+    assert results[0][1].any(axis=0).all()
+    for states, dones in results[1:]:
+        assert np.array_equal(states, results[0][0])
+        assert np.array_equal(dones, results[0][1])
+
+
+def test_batch_reset_on_collision() -> None:
+    # env 0 starts inside safety_dist, env 1 far apart
+    x = np.array([[0, 0, 0, 0, 3, 0, np.pi, 0],
+                  [0, 0, 0, 0, 0, 150, 0, 0]], dtype=float)
+    reset_x = x.copy()
+    reset_x[0, 4] = 100
+
+    avail = make_avail()
+    batch = FwCollisionEnvBatch(make_env(), 2, avail)
+    batch.reset(x)
+    a1_idx = np.zeros(2, dtype=np.int32)
+    done = batch.step(a1_idx, reset_x)
+
+    # a collision ends the episode like done does
+    assert list(done) == [True, False]
+    assert np.array_equal(batch.states[0], reset_x[0])
+    assert batch.t[0] == 0
+    assert not batch.collided[0]
+
+
+def test_batch_invalid_shapes() -> None:
+    batch = FwCollisionEnvBatch(make_env(), 4, make_avail())
+    with pytest.raises(RuntimeError):
+        batch.reset(np.zeros((3, 8)))
+    batch.reset(np.zeros((4, 8)))
+    with pytest.raises(RuntimeError):
+        batch.step(np.zeros(5, dtype=np.int32))
+
+
+def test_batch_step_n() -> None:
+    np.random.seed(2)
+    num_envs = 30
+    avail = make_avail()
+    x = random_states(num_envs)
+    a1_idx = np.random.randint(len(avail.get_all_actions()), size=num_envs)
+
+    batch = FwCollisionEnvBatch(make_env(), num_envs, avail, num_threads=2)
+    batch.reset(x)
+    done, steps, min_dist = batch.step_n(a1_idx, 40)
+
+    uhat2 = Uhat(goal=GOAL2, dt=DT, avail_actions=avail)
+    for i in range(num_envs):
+        env = make_env()
+        env.reset(FwSingleState.from_numpy(x[i, :4]),
+                  FwSingleState.from_numpy(x[i, 4:]), 0.0)
+        a1 = avail.idx_to_action(int(a1_idx[i]))
+        env_min_dist = np.inf
+        for num_steps in range(1, 41):
+            env.step(a1, uhat2.calc(env.x2))
+            env_min_dist = min(env_min_dist, env.stats.dist_to_veh)
+            if env.done or env.collided:
+                break
+        assert steps[i] == num_steps
+        assert done[i] == (env.done or env.collided)
+        assert min_dist[i] == env_min_dist
+        assert np.array_equal(
+            batch.states[i],
+            np.hstack((np.asarray(env.x1), np.asarray(env.x2))))
+
+
+def test_batch_step_shielded() -> None:
+    np.random.seed(3)
+    num_envs = 25
+    avail = make_avail()
+    x = random_states(num_envs)
+    x[:, [0, 1, 4, 5]] /= 5
+    bf = BarrierGammaTurn(
+        dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+        avail_actions=avail)
+
+    env = make_env()
+    env.set_shield(bf)
+    batch = FwCollisionEnvBatch(
+        env, num_envs, avail, num_threads=2, shard_size=4)
+    assert batch.has_shield
+    batch.reset(x)
+
+    envs = []
+    for row in x:
+        env = make_env()
+        env.set_shield(bf)
+        env.reset(FwSingleState.from_numpy(row[:4]),
+                  FwSingleState.from_numpy(row[4:]), 0.0)
+        envs.append(env)
+
+    uhat2 = Uhat(goal=GOAL2, dt=DT, avail_actions=avail)
+    num_actions = len(avail.get_all_actions())
+    for _ in range(30):
+        a1_idx = np.random.randint(num_actions, size=num_envs)
+        done, requested, executed, overridden = batch.step_shielded(a1_idx)
+        for i, env in enumerate(envs):
+            a2_idx = avail.action_to_idx(uhat2.calc(env.x2))
+            idx = int(a1_idx[i]) * num_actions + a2_idx
+            assert env.step(idx)[1:] == (
+                requested[i], executed[i], overridden[i])
+            assert (env.done or env.collided) == done[i]
+    assert np.array_equal(
+        batch.states,
+        [np.hstack((np.asarray(e.x1), np.asarray(e.x2))) for e in envs])
+
+    batch.clear_shield()
+    with pytest.raises(RuntimeError):
+        batch.step_shielded(np.zeros(num_envs, dtype=np.int32))
+
+
+def test_batch_step_shielded_single_precision() -> None:
+    np.random.seed(4)
+    num_envs = 25
+    avail = make_avail()
+    x = random_states(num_envs)
+    x[:, [0, 1, 4, 5]] /= 5
+    bf = BarrierGammaTurn(
+        dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+        avail_actions=avail)
+
+    batch = FwCollisionEnvBatch(
+        make_env(), num_envs, avail, num_threads=2, shard_size=4)
+    batch.set_shield(bf, single_precision=True)
+    assert batch.has_shield and batch.has_single_precision_shield
+    batch.reset(x)
+
+    num_actions = len(avail.get_all_actions())
+    num_overridden = 0
+    for _ in range(30):
+        states = batch.states
+        a1_idx = np.random.randint(num_actions, size=num_envs)
+        _, requested, executed, overridden = batch.step_shielded(a1_idx)
+        expected = bf.choose_u_f32(states.astype(np.float32), requested)
+        assert np.array_equal(executed, expected)
+        num_overridden += overridden.sum()
+    assert num_overridden > 0
+
+    batch.clear_shield()
+    assert not batch.has_single_precision_shield
@@ -0,0 +1,81 @@
+import numpy as np
+
+from fw_coll_env_c import FwAvailActions, FwMultiCollisionEnv
+
+SAFETY_DIST = 5
+
+
+def make_env() -> FwMultiCollisionEnv:
+    avail = FwAvailActions(v=[15], w=[-12, 0, 12], dz=[0])
+    return FwMultiCollisionEnv(
+        dt=0.1, max_sim_time=20, done_dist=10, safety_dist=SAFETY_DIST,
+        avail_actions=avail)
+
+
+def brute_nearest(states: np.ndarray,
+                  active: np.ndarray) -> np.ndarray:
+    p = states[:, [0, 1, 3]]
+    dist = np.linalg.norm(p[:, np.newaxis] - p[np.newaxis], axis=2)
+    dist[:, ~active] = np.inf
+    np.fill_diagonal(dist, np.inf)
+    return dist.min(axis=1)
+
+
+def test_multi_env_matches_brute_force() -> None:
+    np.random.seed(0)
+    num = 300
+    side = 60 * np.sqrt(num)
+    x = np.zeros((num, 4))
+    x[:, :2] = np.random.uniform(-side, side, size=(num, 2))
+    x[:, 2] = np.random.uniform(-np.pi, np.pi, size=num)
+    x[:, 3] = np.random.uniform(-10, 10, size=num)
+    goals = np.zeros((num, 3))
+    goals[:, :2] = np.random.uniform(-side, side, size=(num, 2))
+
+    env = make_env()
+    env.reset(x, goals)
+    assert len(env) == num
+    for _ in range(50):
+        active = ~(env.collided | env.goal_reached)
+        env.step(np.random.randint(3, size=num))
+        expected = brute_nearest(env.states, active)
+        assert np.allclose(env.dist_nearest[active], expected[active])
+        assert np.array_equal(
+            env.collided[active], expected[active] <= SAFETY_DIST)
+
+        pairs = env.pairs_within(4 * SAFETY_DIST)
+        still_active = ~(env.collided | env.goal_reached)
+        num_expected = np.sum(
+            brute_nearest(env.states, still_active)[still_active]
+            <= 4 * SAFETY_DIST)
+        assert np.all(still_active[pairs])
+        assert len(np.unique(pairs)) == num_expected
+
+    assert np.all(env.min_sep <= env.dist_nearest)
+    assert env.num_collided == np.sum(env.collided)
+
+
+def test_multi_env_outlier() -> None:
+    # a far away aircraft must not coarsen the grid of the crowd
+    np.random.seed(1)
+    num = 200
+    side = 60 * np.sqrt(num)
+    x = np.zeros((num, 4))
+    x[:, :2] = np.random.uniform(-side, side, size=(num, 2))
+    x[0, :2] = [1e6, -1e6]
+    goals = np.full((num, 3), 2e6)
+
+    env = make_env()
+    env.reset(x, goals)
+    active = ~(env.collided | env.goal_reached)
+    expected = brute_nearest(env.states, active)
+    assert np.allclose(env.dist_nearest[active], expected[active])
+
+    for radius in [SAFETY_DIST, 50, 500]:
+        p = env.states[:, [0, 1, 3]]
+        dist = np.linalg.norm(p[:, np.newaxis] - p[np.newaxis], axis=2)
+        i, j = np.triu_indices(num, 1)
+        within = (dist[i, j] <= radius) & active[i] & active[j]
+        pairs = env.pairs_within(radius)
+        assert len(pairs) == np.count_nonzero(within)
+        assert set(map(tuple, pairs)) == set(zip(i[within], j[within]))
@@ -0,0 +1,148 @@
+import threading
+from typing import List, Tuple
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwCollisionEnv, Point, FwSingleState, \
+    FwAvailActions, Uhat, BarrierGammaTurn, MpcConfig, MpcPlanner
+
+DT = 0.1
+
+
+def make_env() -> FwCollisionEnv:
+    # head on, Uhat alone collides
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=60, done_dist=10, safety_dist=5,
+        goal1=Point(1000, 0, 0), goal2=Point(-400, 0, 0), time_warp=-1)
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(600, 0, 0), np.pi), 0)
+    return env
+
+
+def make_avail() -> FwAvailActions:
+    return FwAvailActions(v=[15, 20, 25], w=[-12, 0, 12], dz=[0])
+
+
+def make_config(method: str, continuous: bool) -> MpcConfig:
+    config = MpcConfig()
+    config.method = method
+    config.continuous = continuous
+    config.num_samples = 64
+    config.horizon = 30
+    return config
+
+
+def fly(env: FwCollisionEnv, planner: MpcPlanner,
+        num_steps: int) -> List[Tuple[float, float, float]]:
+    uhat2 = Uhat(goal=env.goal2, dt=DT, avail_actions=make_avail())
+    actions = []
+    for _ in range(num_steps):
+        if env.collided:
+            break
+        a1 = planner.plan(env.x1, env.x2)
+        actions.append((a1.v, a1.w, a1.dz))
+        env.step(a1, uhat2.calc(env.x2))
+    return actions
+
+
+def test_uhat_collides() -> None:
+    env = make_env()
+    avail = make_avail()
+    uhat1 = Uhat(goal=env.goal1, dt=DT, avail_actions=avail)
+    uhat2 = Uhat(goal=env.goal2, dt=DT, avail_actions=avail)
+    while not env.collided and not env.stats.done_goal:
+        env.step(uhat1.calc(env.x1), uhat2.calc(env.x2))
+    assert env.collided
+
+
+@pytest.mark.parametrize("method", ["mppi", "cem"])
+@pytest.mark.parametrize("continuous", [False, True])
+def test_mpc_avoids_collision(method: str, continuous: bool) -> None:
+    env = make_env()
+    planner = MpcPlanner(env, make_avail(), make_config(method, continuous),
+                         num_threads=2, seed=3)
+    # well past the encounter, which is after about 15 s
+    actions = fly(env, planner, 250)
+    assert not env.collided
+    assert env.stats.dist_to_goal1 < 500
+
+    # continuous actions stay within the avail action bounds
+    arr = np.array(actions)
+    assert np.all((15 <= arr[:, 0]) & (arr[:, 0] <= 25))
+    assert np.all(np.abs(arr[:, 1]) <= np.deg2rad(12) + 1e-12)
+
+
+@pytest.mark.parametrize("continuous", [False, True])
+def test_mpc_deterministic(continuous: bool) -> None:
+    config = make_config("mppi", continuous)
+    runs = []
+    for num_threads in [0, 1, 3]:
+        env = make_env()
+        planner = MpcPlanner(env, make_avail(), config,
+                             num_threads=num_threads, seed=5)
+        planner.set_barrier(BarrierGammaTurn(
+            dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+            avail_actions=make_avail()))
+        runs.append(fly(env, planner, 50))
+    assert runs[0] == runs[1] == runs[2]
+
+
+def test_mpc_plan_outputs() -> None:
+    env = make_env()
+    avail = make_avail()
+    config = make_config("cem", False)
+    planner = MpcPlanner(env, avail, config, seed=1)
+    assert not planner.has_barrier
+
+    idx = planner.plan_idx(env.x1, env.x2)
+    assert 0 <= idx < len(avail.get_all_actions())
+    plan = planner.plan_actions
+    assert plan.shape == (config.horizon, 3)
+    probs = planner.probs
+    assert probs.shape == (config.horizon, len(avail.get_all_actions()))
+    assert np.allclose(probs.sum(axis=1), 1)
+    assert planner.costs.shape == (config.num_samples,)
+
+    # the planned action is the most likely one
+    ac = avail.get_all_actions()[int(np.argmax(probs[0]))]
+    assert np.allclose(plan[0], [ac.v, ac.w, ac.dz])
+
+    planner.reset()
+    config.continuous = True
+    with pytest.raises(RuntimeError):
+        _ = MpcPlanner(env, avail, config).probs
+
+    config.method = "random"
+    with pytest.raises(RuntimeError):
+        MpcPlanner(env, avail, config)
+
+
+def test_mpc_shared_between_threads() -> None:
+    env = make_env()
+    config = make_config("cem", False)
+    planner = MpcPlanner(env, make_avail(), config, num_threads=2, seed=2)
+    barrier = BarrierGammaTurn(
+        dt=DT, max_val=300, v=15, w_deg_per_sec=12, safety_dist=5,
+        avail_actions=make_avail())
+    done = threading.Event()
+    probs = []
+    planner.plan(env.x1, env.x2)
+
+    def reader() -> None:
+        while not done.is_set():
+            planner.set_barrier(barrier)
+            probs.append(planner.probs)
+            planner.clear_barrier()
+            planner.reset()
+
+    thread = threading.Thread(target=reader)
+    thread.start()
+    for _ in range(20):
+        planner.plan(env.x1, env.x2)
+    done.set()
+    thread.join()
+
+    # no read saw a distribution in the middle of a refit
+    assert probs
+    assert all(np.allclose(p.sum(axis=1), 1) for p in probs)
@@ -0,0 +1,115 @@
+import json
+from typing import Any, Iterator
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwCollisionEnv, Point, FwSingleState, \
+    FwSingleAction, FwAvailActions, BarrierGammaTurn, FwCollisionEnvBatch, \
+    profiler
+
+DT = 0.1
+
+
+@pytest.fixture(autouse=True)
+def profiling() -> Iterator[None]:
+    profiler.reset()
+    profiler.set_enabled(True)
+    yield
+    profiler.set_enabled(False)
+    profiler.set_tracing(False)
+    profiler.reset()
+
+
+def make_avail() -> FwAvailActions:
+    return FwAvailActions(v=[15, 20], w=[-12, 0, 12], dz=[0])
+
+
+def make_env() -> FwCollisionEnv:
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=100, done_dist=10, safety_dist=5,
+        goal1=Point(2000, 0, 0), goal2=Point(-2000, 0, 0), time_warp=-1)
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(1000, 0, 0), np.pi), 0)
+    return env
+
+
+def check_hist(timer: Any) -> None:
+    assert timer["hist"].sum() == timer["count"]
+    assert timer["max_s"] <= timer["total_s"]
+
+
+def test_choose_u_counters() -> None:
+    avail = make_avail()
+    bf = BarrierGammaTurn(
+        dt=DT, max_val=500, v=15, w_deg_per_sec=12, safety_dist=50,
+        avail_actions=avail)
+
+    # head on encounters, the closer ones need an evasive action
+    num_rows = 20
+    x = np.zeros((num_rows, 8))
+    x[:, 4] = 90 + 5 * np.arange(num_rows)
+    x[:, 6] = np.pi
+    uhat = np.full(num_rows, 28, dtype=np.int32)
+    out = bf.choose_u(x, uhat)
+
+    snap = profiler.snapshot()
+    counters = snap["counters"]
+    assert counters["choose_u_rows"] == num_rows
+    assert counters["choose_u_overrides"] == np.sum(out != uhat) > 0
+    assert counters["choose_u_searches"] >= counters["choose_u_overrides"]
+    assert counters["choose_u_candidates"] > 0
+    assert counters["rollouts"] > 0
+    assert counters["rollout_steps"] > 0
+
+    timers = snap["timers"]
+    assert timers["choose_u"]["count"] == 1
+    assert timers["choose_u_search"]["count"] == \
+        counters["choose_u_searches"]
+    for timer in timers.values():
+        check_hist(timer)
+    assert len(snap["hist_edges_s"]) == len(timers["choose_u"]["hist"]) + 1
+
+
+def test_disabled_and_reset() -> None:
+    profiler.set_enabled(False)
+    env = make_env()
+    env.step(FwSingleAction(15, 0, 0), FwSingleAction(15, 0, 0))
+    assert profiler.snapshot()["counters"]["env_steps"] == 0
+
+    profiler.set_enabled(True)
+    env.step(FwSingleAction(15, 0, 0), FwSingleAction(15, 0, 0))
+    assert profiler.snapshot()["counters"]["env_steps"] == 1
+    profiler.reset()
+    assert profiler.snapshot()["counters"]["env_steps"] == 0
+
+
+def test_batch_threads(tmp_path: Any) -> None:
+    profiler.set_tracing(True, max_events=100)
+    num_envs = 64
+    batch = FwCollisionEnvBatch(
+        make_env(), num_envs, make_avail(), num_threads=4, shard_size=8)
+    a1_idx = np.ones(num_envs, dtype=np.int32)
+    for _ in range(10):
+        batch.step(a1_idx)
+
+    # pool threads are summed with the calling thread
+    snap = profiler.snapshot()
+    assert snap["counters"]["env_steps"] == 10 * num_envs
+    assert snap["counters"]["uhat_calls"] == 10 * num_envs
+    assert snap["timers"]["env_batch_step"]["count"] == 10
+    check_hist(snap["timers"]["env_step"])
+
+    # each thread keeps at most max_events
+    num_events = 10 + 10 * num_envs
+    assert snap["trace_events"] + snap["trace_dropped"] == num_events
+    assert snap["trace_dropped"] > 0
+
+    path = str(tmp_path / "trace.json")
+    profiler.write_trace(path)
+    with open(path) as f:
+        trace = json.load(f)
+    events = trace["traceEvents"]
+    assert len(events) == snap["trace_events"]
+    assert {ev["name"] for ev in events} == {"env_step", "env_batch_step"}
+    assert all(ev["ph"] == "X" and ev["dur"] >= 0 for ev in events)
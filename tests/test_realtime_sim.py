@@ -0,0 +1,116 @@
+import threading
+import time
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwCollisionEnv, Point, FwSingleState, \
+    FwAvailActions, RealtimeSim
+
+DT = 0.1
+
+
+def make_env(max_sim_time: float) -> FwCollisionEnv:
+    env = FwCollisionEnv(
+        dt=DT, max_sim_time=max_sim_time, done_dist=10, safety_dist=5,
+        goal1=Point(2000, 0, 0), goal2=Point(-2000, 0, 0), time_warp=-1)
+    env.reset(FwSingleState(Point(0, 0, 0), 0),
+              FwSingleState(Point(1000, 500, 0), np.pi), 0)
+    return env
+
+
+def make_avail() -> FwAvailActions:
+    return FwAvailActions(v=[15, 20], w=[-12, 0, 12], dz=[0])
+
+
+def test_realtime_pacing() -> None:
+    # 20 steps at 10x real time
+    sim = RealtimeSim(make_env(1.95), make_avail(), time_warp=10)
+    assert sim.snapshot().step == 0
+
+    start = time.perf_counter()
+    sim.start()
+    assert sim.running
+    assert sim.wait(timeout=5)
+    elapsed = time.perf_counter() - start
+    assert not sim.running
+    assert 0.19 < elapsed < 1
+
+    snap = sim.snapshot()
+    stats = sim.stats()
+    assert snap.step == stats.num_steps == 20
+    assert snap.done
+    assert snap.t == pytest.approx(20 * DT)
+    assert np.array_equal(snap.x[:4], np.asarray(sim.env.x1))
+    assert stats.num_stale == 20
+    assert 0 <= stats.mean_lateness <= stats.max_lateness
+
+
+def test_realtime_actions() -> None:
+    avail = make_avail()
+    sim = RealtimeSim(make_env(100), avail, time_warp=20)
+    steps = []
+
+    def viewer() -> None:
+        while sim.running:
+            steps.append(sim.snapshot().step)
+
+    sim.start()
+    thread = threading.Thread(target=viewer)
+    thread.start()
+    sim.post_action(3)
+    time.sleep(0.2)
+    sim.stop()
+    thread.join()
+
+    # the action is held until stopped
+    snap = sim.snapshot()
+    ac = avail.get_all_actions()[3]
+    assert snap.step > 0
+    assert np.allclose(snap.action[:3], [ac.v, ac.w, ac.dz])
+    assert steps == sorted(steps)
+    assert sim.stats().num_stale == snap.step - 1
+
+    with pytest.raises(RuntimeError):
+        sim.post_action(len(avail.get_all_actions()))
+
+
+def test_realtime_back_to_uhat() -> None:
+    avail = make_avail()
+    sim = RealtimeSim(make_env(100), avail, time_warp=20)
+
+    def post_and_wait(a1_idx: int, a2_idx: int) -> None:
+        step = sim.snapshot().step
+        sim.post_action(a1_idx, a2_idx)
+        while sim.snapshot().step <= step + 1:
+            time.sleep(0.001)
+
+    # a hard right turn, then both vehicles back to Uhat
+    idx = [i for i, ac in enumerate(avail.get_all_actions())
+           if ac.w < 0][0]
+    sim.start()
+    post_and_wait(idx, idx)
+    post_and_wait(-1, -1)
+    sim.stop()
+
+    # both posts were taken, and Uhat turns back towards the goals
+    snap = sim.snapshot()
+    turn = avail.get_all_actions()[idx]
+    assert sim.stats().num_stale == snap.step - 2
+    assert snap.action[1] != turn.w
+    assert snap.action[4] != turn.w
+
+
+def test_realtime_invalid() -> None:
+    with pytest.raises(RuntimeError):
+        RealtimeSim(make_env(10), make_avail(), time_warp=0)
+
+    sim = RealtimeSim(make_env(100), make_avail(), time_warp=1)
+    sim.start()
+    with pytest.raises(RuntimeError):
+        sim.start()
+    with pytest.raises(RuntimeError):
+        sim.reset(FwSingleState(Point(0, 0, 0), 0),
+                  FwSingleState(Point(100, 0, 0), np.pi))
+    sim.stop()
+    assert not sim.running
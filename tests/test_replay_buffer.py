@@ -0,0 +1,96 @@
+from typing import Tuple
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwAvailActions, ReplayBuffer
+
+OBS_DIM = 11
+STATE_LIMS = np.array([[-500, -500, -np.pi, -100] * 2,
+                       [500, 500, np.pi, 100] * 2])
+OBS_LIMS = np.array([[-1] * OBS_DIM, [1] * OBS_DIM])
+
+
+def make_buffer(capacity: int) -> ReplayBuffer:
+    avail = FwAvailActions(v=[15, 20, 25], w=[-12, 0, 12], dz=[0])
+    return ReplayBuffer(capacity, avail, STATE_LIMS, OBS_LIMS, seed=0)
+
+
+def make_batch(num: int) -> Tuple[np.ndarray, ...]:
+    x = np.random.uniform(STATE_LIMS[0], STATE_LIMS[1], size=(num, 8))
+    obs = np.random.uniform(-1, 1, size=(num, OBS_DIM))
+    action_idx = np.random.randint(81, size=num).astype(np.int32)
+    overridden = np.random.rand(num) < 0.5
+    return x, obs, action_idx, overridden
+
+
+def make_outputs(num: int) -> Tuple[np.ndarray, ...]:
+    return (np.empty((num, 8)), np.empty((num, OBS_DIM)),
+            np.empty(num, dtype=np.int32), np.empty(num, dtype=bool),
+            np.empty(num, dtype=np.int64))
+
+
+def test_roundtrip() -> None:
+    np.random.seed(0)
+    buf = make_buffer(100)
+    x, obs, action_idx, overridden = make_batch(150)
+    buf.add(x, obs, action_idx, overridden)
+    assert len(buf) == 100
+    assert buf.num_inserted == 150
+    assert buf.nbytes < x[:100].nbytes
+
+    out = make_outputs(500)
+    buf.sample(*out)
+    x_out, obs_out, action_out, overridden_out, idx_out = out
+    assert np.all(idx_out >= 0) and np.all(idx_out < 100)
+
+    # slot i holds the last transition inserted at i modulo capacity
+    src = np.where(idx_out < 50, idx_out + 100, idx_out)
+    step = (STATE_LIMS[1] - STATE_LIMS[0]) / 65535
+    assert np.all(np.abs(x_out - x[src]) <= step)
+    assert np.all(np.abs(obs_out - obs[src]) <= 2 / 65535)
+    assert np.array_equal(action_out, action_idx[src])
+    assert np.array_equal(overridden_out, overridden[src])
+
+
+def test_prioritized() -> None:
+    np.random.seed(1)
+    buf = make_buffer(64)
+    batch = make_batch(64)
+    priorities = np.ones(64)
+    priorities[:8] = 7
+    buf.add(*batch, priorities=priorities)
+    assert buf.total_priority == pytest.approx(priorities.sum())
+
+    out = make_outputs(4000)
+    prob_out = np.empty(4000)
+    buf.sample_prioritized(*out, prob_out)
+    idx_out = out[4]
+    assert np.mean(idx_out < 8) == pytest.approx(0.5, abs=0.01)
+    assert np.allclose(prob_out, priorities[idx_out] / priorities.sum())
+
+    buf.update_priorities(np.arange(8), np.zeros(8))
+    buf.sample_prioritized(*out, prob_out)
+    assert np.all(out[4] >= 8)
+
+
+def test_invalid() -> None:
+    buf = make_buffer(10)
+    with pytest.raises(RuntimeError):
+        buf.sample(*make_outputs(1))
+
+    # outputs are filled in place, so converted copies are rejected
+    buf.add(*make_batch(4))
+    out = make_outputs(4)
+    with pytest.raises(TypeError):
+        buf.sample(out[0].astype(np.float32), *out[1:])
+    with pytest.raises(TypeError):
+        buf.sample(np.empty((8, 4)).T, *out[1:])
+    out[0].flags.writeable = False
+    with pytest.raises(ValueError):
+        buf.sample(*out)
+    x, obs, action_idx, overridden = make_batch(2)
+    with pytest.raises(RuntimeError):
+        buf.add(x, obs[:, :5], action_idx, overridden)
+    with pytest.raises(RuntimeError):
+        buf.add(x, obs, np.array([0, 81], dtype=np.int32), overridden)
@@ -0,0 +1,117 @@
+from typing import Any, List
+
+import numpy as np
+import pytest
+
+from fw_coll_env_c import FwCollisionEnv, FwCollisionEnvBatch, Point, \
+    FwSingleState, FwSingleAction, FwAvailActions, TrajectoryRecorder, \
+    TrajectoryReader
+
+DT = 0.1
+# done_time after 50 steps
+MAX_SIM_TIME = 4.95
+
+
+def make_env() -> FwCollisionEnv:
+    return FwCollisionEnv(
+        dt=DT, max_sim_time=MAX_SIM_TIME, done_dist=10, safety_dist=5,
+        goal1=Point(200, 0, 0), goal2=Point(-200, 0, 0), time_warp=-1)
+
+
+@pytest.mark.parametrize('compression_level', [0, 6])
+def test_record_single_env(tmp_path: Any, compression_level: int) -> None:
+    path = str(tmp_path / 'traj.bin')
+    rng = np.random.default_rng(0)
+    a1 = FwSingleAction(15, np.deg2rad(12), 0)
+    a2 = FwSingleAction(20, 0, 0)
+
+    states: List[np.ndarray] = []
+    with TrajectoryRecorder(path, chunk_rows=50,
+                            compression_level=compression_level) as rec:
+        env = make_env()
+        env.set_recorder(rec)
+        for _ in range(10):
+            env.reset(FwSingleState(Point(0, 0, 0), 0),
+                      FwSingleState(Point(100, rng.uniform(-50, 50), 0),
+                                    np.pi), 0)
+            rows = [np.concatenate([env.x1, env.x2])]
+            for _ in range(rng.integers(1, 40)):
+                env.step(a1, a2)
+                rows.append(np.concatenate([env.x1, env.x2]))
+            states.append(np.array(rows))
+    assert rec.closed
+
+    reader = TrajectoryReader(path)
+    assert len(reader) == 10
+    assert reader.num_rows == sum(len(x) for x in states)
+    assert reader.num_chunks > 1
+    assert reader.compressed == (compression_level > 0)
+    for i, x in enumerate(states):
+        ep = reader.episode(i)
+        assert np.array_equal(ep['x'], x)
+        assert np.allclose(ep['t'], DT * np.arange(len(x)))
+        assert np.isnan(ep['action'][0]).all()
+        assert np.allclose(
+            ep['action'][1:], [15, np.deg2rad(12), 0, 20, 0, 0])
+        assert not ep['overridden'].any()
+        assert not ep['x'].flags.writeable
+        assert np.array_equal(reader.column('x', episode=i), x)
+
+    assert np.array_equal(reader.column('x'), np.concatenate(states))
+
+
+def test_record_batch(tmp_path: Any) -> None:
+    path = str(tmp_path / 'traj.bin')
+    num_envs = 16
+    x = np.zeros((num_envs, 8))
+    x[:, 4] = 100
+    # passing outside safety_dist, so only the time limit ends episodes
+    x[:, 5] = np.linspace(10, 50, num_envs)
+    x[:, 6] = np.pi
+
+    rec = TrajectoryRecorder(path, chunk_rows=1000, compression_level=1)
+    env = make_env()
+    env.set_recorder(rec)
+    batch = FwCollisionEnvBatch(
+        env, num_envs, FwAvailActions(v=[15], w=[0], dz=[0]),
+        num_threads=4, shard_size=2)
+    batch.reset(x)
+    steps = 70
+    for _ in range(steps):
+        batch.step(np.zeros(num_envs, dtype=np.int32), reset_x=x)
+    rec.close()
+
+    # every env has its own stream and episodes end at the time limit
+    reader = TrajectoryReader(path)
+    assert reader.num_rows == num_envs * (steps + 1 + steps // 50)
+    assert len(set(reader.episode_streams)) == num_envs
+    for i in range(len(reader)):
+        ep = reader.episode(i)
+        assert np.array_equal(
+            ep['done_time'], np.arange(len(ep['t'])) == 50)
+
+
+def test_recorder_invalid(tmp_path: Any) -> None:
+    path = str(tmp_path / 'traj.bin')
+    with pytest.raises(RuntimeError):
+        TrajectoryRecorder(path, chunk_rows=0)
+    with pytest.raises(RuntimeError):
+        TrajectoryRecorder(path, compression_level=10)
+
+    rec = TrajectoryRecorder(path)
+    env = make_env()
+    env.set_recorder(rec)
+    rec.close()
+    # every use after close throws, but detaching still works
+    with pytest.raises(RuntimeError, match="closed"):
+        env.reset(FwSingleState(Point(0, 0, 0), 0),
+                  FwSingleState(Point(100, 0, 0), np.pi), 0)
+    with pytest.raises(RuntimeError, match="closed"):
+        rec.flush()
+    env.clear_recorder()
+    assert not env.has_recorder
+    rec.close()
+
+    (tmp_path / 'bad.bin').write_bytes(b'0' * 256)
+    with pytest.raises(RuntimeError):
+        TrajectoryReader(str(tmp_path / 'bad.bin'))